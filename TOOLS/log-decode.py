@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+
+"""
+Convert a log file written with --log-file-format=binary to the text format
+used by --log-file.
+
+Usage:
+
+    log-decode.py [--threads] [--module REGEX] [--level LEVEL] mpv.blog
+
+--threads adds the (mpv-internal) number of the logging thread to each line.
+--module and --level filter the output.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+MAGIC = b"MPVBLOG\n"
+VERSION = 1
+
+# Must match mp_log_levels in common/msg.c.
+LEVELS = ["fatal", "error", "warn", "info", "status", "v", "debug", "trace",
+          "stats"]
+
+class DecodeError(Exception):
+    pass
+
+def read_exact(f, size):
+    data = f.read(size)
+    if len(data) != size:
+        raise DecodeError("truncated file")
+    return data
+
+def records(f):
+    if read_exact(f, len(MAGIC)) != MAGIC:
+        raise DecodeError("not a binary mpv log file")
+    version, = struct.unpack("<I", read_exact(f, 4))
+    if version != VERSION:
+        raise DecodeError("unsupported version %d" % version)
+
+    modules = {}
+    while True:
+        rtype = f.read(1)
+        if not rtype:
+            return
+        if rtype == b"M":
+            mod_id, size = struct.unpack("<II", read_exact(f, 8))
+            modules[mod_id] = read_exact(f, size).decode("utf-8", "replace")
+        elif rtype == b"L":
+            mod_id, level, time, thread, size = \
+                struct.unpack("<IBqII", read_exact(f, 21))
+            text = read_exact(f, size)
+            yield time, thread, level, modules.get(mod_id, "?"), text
+        elif rtype == b"D":
+            time, dropped = struct.unpack("<qQ", read_exact(f, 16))
+            yield (time, 0, 0, "overflow", b"log message buffer overflow: "
+                   b"%d messages skipped\n" % dropped)
+        else:
+            raise DecodeError("unknown record type %r" % rtype)
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode binary mpv logs.")
+    parser.add_argument("file", help="log file, or - for stdin")
+    parser.add_argument("--threads", action="store_true",
+                        help="show the thread number of each message")
+    parser.add_argument("--module", help="only show modules matching REGEX")
+    parser.add_argument("--level", choices=LEVELS,
+                        help="only show messages up to this level")
+    args = parser.parse_args()
+
+    module_re = re.compile(args.module) if args.module else None
+    max_level = LEVELS.index(args.level) if args.level else len(LEVELS)
+
+    f = sys.stdin.buffer if args.file == "-" else open(args.file, "rb")
+    out = sys.stdout
+    try:
+        for time, thread, level, module, text in records(f):
+            if level > max_level:
+                continue
+            if module_re and not module_re.search(module):
+                continue
+            lev = LEVELS[level][0] if level < len(LEVELS) else "?"
+            prefix = "[%8.3f][%s]" % (time / 1e9, lev)
+            if args.threads:
+                prefix += "[%3d]" % thread
+            for line in text.splitlines(keepends=True):
+                # TERM_MSG_0, the terminal clipping marker
+                if line.startswith(b"\xfc"):
+                    line = line[1:]
+                line = line.decode("utf-8", "replace")
+                out.write("%s[%s] %s" % (prefix, module, line))
+    except DecodeError as e:
+        sys.exit("%s: %s" % (args.file, e))
+    except BrokenPipeError:
+        pass
+
+if __name__ == "__main__":
+    main()
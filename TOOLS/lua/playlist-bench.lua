@@ -0,0 +1,66 @@
+-- Measure the cost of reading the playlist property from Lua, comparing
+-- mp.get_property_native() with mp.get_property_lazy().
+--
+-- Usage: mpv --idle --script=TOOLS/lua/playlist-bench.lua
+--
+-- The script fills the playlist with dummy entries, prints the timings, and
+-- quits. The number of entries and iterations can be changed with
+-- --script-opts=playlist-bench-entries=10000,playlist-bench-iterations=50
+
+local options = {
+    entries = 10000,
+    iterations = 50,
+}
+require("mp.options").read_options(options, "playlist-bench")
+
+local utils = require("mp.utils")
+
+local function bench(name, fn)
+    collectgarbage()
+    local start = mp.get_time()
+    for _ = 1, options.iterations do
+        fn()
+    end
+    local ms = (mp.get_time() - start) * 1000 / options.iterations
+    mp.msg.info(string.format("%-36s %8.3f ms", name, ms))
+end
+
+local lines = {}
+for i = 1, options.entries do
+    lines[i] = "dummy-" .. i .. ".mkv"
+end
+mp.commandv("loadlist", "memory://" .. table.concat(lines, "\n"), "append")
+
+local count = mp.get_property_number("playlist-count")
+mp.msg.info(string.format("%d entries, %d iterations", count, options.iterations))
+
+bench("native: read one entry", function()
+    return mp.get_property_native("playlist")[count].filename
+end)
+
+bench("lazy: read one entry", function()
+    return mp.get_property_lazy("playlist")[count].filename
+end)
+
+bench("native: read all filenames", function()
+    local n = 0
+    for _, entry in ipairs(mp.get_property_native("playlist")) do
+        n = n + #entry.filename
+    end
+    return n
+end)
+
+bench("lazy: read all filenames", function()
+    local playlist = mp.get_property_lazy("playlist")
+    local n = 0
+    for i = 1, #playlist do
+        n = n + #playlist[i].filename
+    end
+    return n
+end)
+
+bench("lazy: to_table", function()
+    return utils.to_table(mp.get_property_lazy("playlist"))
+end)
+
+mp.command("quit")
@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+
+"""
+Extract thumbnails or sprite sheets from a video file with mpv.
+
+Thumbnails are taken either at a fixed interval or at a list of timestamps.
+Seeks snap to keyframes (--hr-seek=no) and non-keyframes are not decoded at
+all (--vd-lavc-skipframe=nonkey), so only one frame per thumbnail is decoded.
+Frames are written at their decoded resolution. The file is split into
+segments that are processed by several mpv instances in parallel.
+
+If --sprite is given, the extracted images are tiled into sprite sheets by
+feeding them back into mpv with --vo=image and --vo-image-sprite-*.
+
+Examples:
+
+    thumbnails.py --interval 10 --sprite 5x5 --width 160 video.mkv
+    thumbnails.py --times 12.5,60,95 --outdir thumbs video.mkv
+    thumbnails.py --benchmark
+
+Use the MPV environment variable to select the mpv binary.
+"""
+
+import argparse
+import concurrent.futures
+import math
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+import time
+
+MPV = shlex.split(os.getenv("MPV") or "mpv")
+
+COMMON_OPTS = [
+    "--no-config", "--no-terminal", "--no-audio", "--no-sub",
+    "--untimed", "--hr-seek=no", "--vd-lavc-skipframe=nonkey",
+    "--vd-lavc-skiploopfilter=all", "--vd-lavc-threads=1", "--vo=image",
+]
+
+def run_mpv(args):
+    subprocess.run(MPV + args, check=True, stdout=subprocess.DEVNULL,
+                   stderr=subprocess.DEVNULL)
+
+def get_duration(filename):
+    # --term-playing-msg is logged with the "term-msg" module at info level,
+    # so silence everything but that (--really-quiet would silence it too).
+    res = subprocess.run(MPV + ["--no-config", "--vo=null", "--ao=null",
+                                "--frames=1", "--msg-level=all=no,term-msg=info",
+                                "--term-playing-msg=DURATION=${=duration}",
+                                "--", filename],
+                         check=True, capture_output=True, text=True)
+    for line in (res.stdout + res.stderr).splitlines():
+        if line.startswith("DURATION="):
+            return float(line.split("=", 1)[1])
+    sys.exit("could not determine duration of " + filename)
+
+def image_opts(args, outdir):
+    return ["--vo-image-format=" + args.format, "--vo-image-outdir=" + outdir]
+
+def list_images(outdir):
+    return sorted(os.path.join(outdir, f) for f in os.listdir(outdir))
+
+def extract_interval(args, workdir):
+    duration = get_duration(args.file)
+    count = max(1, math.ceil(duration / args.interval))
+    jobs = max(1, min(args.jobs, count))
+    per_job = math.ceil(count / jobs)
+
+    def segment(n):
+        outdir = os.path.join(workdir, "seg%04d" % n)
+        first = n * per_job
+        last = min(count, first + per_job)
+        if first >= last:
+            return []
+        start = first * args.interval
+        end = last * args.interval
+        run_mpv(COMMON_OPTS + image_opts(args, outdir) +
+                ["--start=%f" % start, "--end=%f" % end,
+                 "--sstep=%f" % args.interval, "--", args.file])
+        return list_images(outdir)
+
+    with concurrent.futures.ThreadPoolExecutor(jobs) as pool:
+        results = pool.map(segment, range(jobs))
+    return [f for seg in results for f in seg]
+
+def extract_times(args, workdir):
+    times = [float(t) for t in args.times.split(",") if t]
+
+    def single(n):
+        outdir = os.path.join(workdir, "time%06d" % n)
+        run_mpv(COMMON_OPTS + image_opts(args, outdir) +
+                ["--start=%f" % times[n], "--frames=1", "--", args.file])
+        return list_images(outdir)
+
+    with concurrent.futures.ThreadPoolExecutor(args.jobs) as pool:
+        results = pool.map(single, range(len(times)))
+    return [f for res in results for f in res]
+
+def make_sprites(args, images, outdir):
+    cols, rows = (int(x) for x in args.sprite.lower().split("x"))
+    listfile = os.path.join(outdir, "sprite-input.txt")
+    with open(listfile, "w") as f:
+        f.write("\n".join(images) + "\n")
+    run_mpv(["--no-config", "--no-terminal", "--untimed", "--vo=image",
+             "--mf-fps=1", "--vo-image-sprite-cols=%d" % cols,
+             "--vo-image-sprite-rows=%d" % rows,
+             "--vo-image-sprite-tile-width=%d" % args.width] +
+            image_opts(args, outdir) + ["--", "mf://@" + listfile])
+    os.remove(listfile)
+
+def thumbnails(args):
+    os.makedirs(args.outdir, exist_ok=True)
+    with tempfile.TemporaryDirectory() as workdir:
+        if args.times:
+            images = extract_times(args, workdir)
+        else:
+            images = extract_interval(args, workdir)
+        if args.sprite:
+            make_sprites(args, images, args.outdir)
+        else:
+            for n, src in enumerate(images):
+                ext = os.path.splitext(src)[1]
+                os.replace(src, os.path.join(args.outdir, "%08d%s" % (n + 1, ext)))
+    return len(images)
+
+def benchmark(args):
+    with tempfile.TemporaryDirectory() as workdir:
+        test_file = os.path.join(workdir, "test.mkv")
+        print("Generating test file...")
+        run_mpv(["--no-config", "--no-terminal", "--of=matroska",
+                 "--ovc=mpeg4", "--ovcopts=g=60,qscale=4",
+                 "--o=" + test_file, "--",
+                 "av://lavfi:testsrc2=size=1280x720:rate=30:duration=300"])
+
+        def timed(name, func):
+            t = time.monotonic()
+            n = func()
+            print("%-28s %8.2f s  (%d images)" % (name, time.monotonic() - t, n))
+
+        def naive():
+            outdir = os.path.join(workdir, "naive")
+            run_mpv(["--no-config", "--no-terminal", "--no-audio", "--untimed",
+                     "--hr-seek=yes", "--vo=image", "--sstep=%f" % args.interval]
+                    + image_opts(args, outdir) + ["--", test_file])
+            return len(list_images(outdir))
+
+        def mode(jobs):
+            def run():
+                opts = argparse.Namespace(**vars(args))
+                opts.file = test_file
+                opts.jobs = jobs
+                opts.outdir = os.path.join(workdir, "jobs%d" % jobs)
+                return thumbnails(opts)
+            return run
+
+        timed("precise seeking", naive)
+        timed("keyframes, 1 job", mode(1))
+        timed("keyframes, %d jobs" % args.jobs, mode(args.jobs))
+
+def main():
+    parser = argparse.ArgumentParser(description="Extract thumbnails with mpv.")
+    parser.add_argument("file", nargs="?", help="input file")
+    parser.add_argument("--interval", type=float, default=10,
+                        help="seconds between thumbnails (default: 10)")
+    parser.add_argument("--times", help="comma separated list of timestamps")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count() or 1,
+                        help="number of parallel mpv instances")
+    parser.add_argument("--outdir", default=".", help="output directory")
+    parser.add_argument("--format", default="jpg",
+                        help="image format, see --vo-image-format")
+    parser.add_argument("--sprite", metavar="COLSxROWS",
+                        help="tile images into sprite sheets")
+    parser.add_argument("--width", type=int, default=0,
+                        help="sprite tile width (default: decoded size)")
+    parser.add_argument("--benchmark", action="store_true",
+                        help="compare against precise seeking on a generated file")
+    args = parser.parse_args()
+
+    if args.benchmark:
+        benchmark(args)
+    elif args.file:
+        thumbnails(args)
+    else:
+        parser.error("no input file")
+
+if __name__ == "__main__":
+    main()
@@ -28,6 +28,7 @@
 
 #include "common/msg.h"
 #include "common/common.h"
+#include "common/stats.h"
 
 #include "filters/f_async_queue.h"
 #include "filters/filter_internal.h"
@@ -49,6 +50,7 @@ struct buffer_state {
 
     // Immutable.
     struct mp_async_queue *queue;
+    struct stats_ctx *stats;
 
     // --- protected by lock
 
@@ -139,6 +141,8 @@ static int read_buffer(struct ao *ao, void **data, int samples, bool *eof,
                 continue;
             }
             p->pending = frame.data;
+            stats_trace_event(p->stats, "audio", "ao-read",
+                              mp_aframe_get_pts(p->pending));
         }
 
         if (!data)
@@ -548,6 +552,8 @@ void ao_uninit(struct ao *ao)
 void init_buffer_pre(struct ao *ao)
 {
     ao->buffer_state = talloc_zero(ao, struct buffer_state);
+    ao->buffer_state->stats = stats_ctx_create(ao->buffer_state, ao->global,
+                                               "ao");
 }
 
 bool init_buffer_post(struct ao *ao)
@@ -576,6 +582,7 @@ bool init_buffer_post(struct ao *ao)
         .sample_unit = AQUEUE_UNIT_SAMPLES,
         .max_samples = ao->buffer,
         .max_bytes = INT64_MAX,
+        .lockless = true,
     };
     mp_async_queue_set_config(p->queue, cfg);
 
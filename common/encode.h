@@ -38,6 +38,8 @@ struct encode_opts {
     char **vopts;
     char *acodec;
     char **aopts;
+    int vsegments;
+    int vsegment_length;
     bool rawts;
     bool copy_metadata;
     char **set_metadata;
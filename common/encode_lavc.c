@@ -20,6 +20,8 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdatomic.h>
+
 #include <libavutil/avutil.h>
 #include <libavutil/timestamp.h>
 
@@ -36,6 +38,12 @@
 #include "mpv_talloc.h"
 #include "stream/stream.h"
 
+// Maximum number of frames queued for each encoder thread, and of encoded
+// packets queued for the mux thread. The frame limit blocks the VO/AO if the
+// encoder can't keep up.
+#define MAX_QUEUED_FRAMES 8
+#define MAX_QUEUED_PACKETS 64
+
 struct encode_priv {
     struct mp_log *log;
 
@@ -60,6 +68,61 @@ struct encode_priv {
 
     unsigned int frames;
     double audioseconds;
+    int64_t file_size;
+
+    // Mux thread; started once the header was written.
+    mp_thread mux_thread;
+    bool mux_thread_running;
+    bool mux_terminate;
+    mp_cond mux_wakeup;         // new packets, free queue space, terminate
+    AVPacket **packets;         // FIFO of packets for the mux thread
+    int num_packets;
+
+    atomic_int queued_frames;   // frames waiting in all encoder queues
+};
+
+// Per-stream encoder thread, which takes the frames from encoder_encode().
+struct encoder_worker {
+    mp_thread thread;
+    mp_mutex lock;
+    mp_cond wakeup;
+
+    // --- protected by lock
+    AVFrame **frames;           // FIFO of frames to encode
+    int num_frames;
+    bool flush;                 // encoder_encode(NULL) was called
+    bool flushed;               // the encoder was flushed
+    bool failed;
+    bool terminate;
+
+    // --- segment-parallel encoding (--ovsegments), immutable
+    int max_segments;           // 0 if disabled
+    int segment_length;
+    AVCodecContext *segment_template; // unopened, never used for encoding
+    atomic_bool cancel;         // abort running segment encoders
+    mp_thread *seg_threads;     // segment encoder threads
+    int num_seg_threads;
+    // --- protected by lock
+    struct encoder_segment *cur;        // segment being filled
+    struct encoder_segment **segments;  // started segments, in output order
+    int num_segments;
+    bool seg_terminate;         // segment encoder threads should exit
+};
+
+// A run of frames encoded by its own encoder instance on a segment encoder
+// thread. The encoder is flushed at the end of the segment, so segments are
+// independent closed GOPs, which can be concatenated in the muxer.
+struct encoder_segment {
+    struct encoder_context *p;
+    AVFrame **frames;
+    int num_frames;
+    AVPacket *pkt;
+    AVPacket **packets;         // encoded packets, in output order
+    int num_packets;
+    // --- protected by encoder_worker.lock
+    bool claimed;               // a segment encoder thread took it
+    bool done;
+    bool ok;
 };
 
 struct mux_stream {
@@ -83,6 +146,8 @@ const struct m_sub_options encode_config = {
         {"ovcopts", OPT_KEYVALUELIST(vopts), .flags = M_OPT_HAVE_HELP},
         {"oac", OPT_STRING(acodec)},
         {"oacopts", OPT_KEYVALUELIST(aopts), .flags = M_OPT_HAVE_HELP},
+        {"ovsegments", OPT_INT(vsegments), M_RANGE(0, 256)},
+        {"ovsegment-length", OPT_INT(vsegment_length), M_RANGE(1, 100000)},
         {"orawts", OPT_BOOL(rawts)},
         {"ocopy-metadata", OPT_BOOL(copy_metadata)},
         {"oset-metadata", OPT_KEYVALUELIST(set_metadata)},
@@ -91,6 +156,7 @@ const struct m_sub_options encode_config = {
     },
     .size = sizeof(struct encode_opts),
     .defaults = &(const struct encode_opts){
+        .vsegment_length = 250,
         .copy_metadata = true,
     },
 };
@@ -108,6 +174,7 @@ struct encode_lavc_context *encode_lavc_init(struct mpv_global *global)
 
     struct encode_priv *p = ctx->priv;
     p->log = ctx->log;
+    mp_cond_init(&p->mux_wakeup);
 
     const char *filename = ctx->options->file;
 
@@ -189,6 +256,15 @@ bool encode_lavc_free(struct encode_lavc_context *ctx)
 
     struct encode_priv *p = ctx->priv;
 
+    // Let the mux thread write the remaining packets.
+    if (p->mux_thread_running) {
+        mp_mutex_lock(&ctx->lock);
+        p->mux_terminate = true;
+        mp_cond_broadcast(&p->mux_wakeup);
+        mp_mutex_unlock(&ctx->lock);
+        mp_thread_join(p->mux_thread);
+    }
+
     if (!p->failed && !p->header_written) {
         MP_FATAL(p, "no data written to target file\n");
         p->failed = true;
@@ -214,12 +290,69 @@ bool encode_lavc_free(struct encode_lavc_context *ctx)
 
     res = !p->failed;
 
+    mp_cond_destroy(&p->mux_wakeup);
     mp_mutex_destroy(&ctx->lock);
     talloc_free(ctx);
 
     return res;
 }
 
+// Write the queued packets. This runs without the lock held while muxing, so
+// that the VO and AO are not blocked by file I/O. lavf interleaves the packets
+// by dts.
+static MP_THREAD_VOID mux_thread(void *ptr)
+{
+    struct encode_lavc_context *ctx = ptr;
+    struct encode_priv *p = ctx->priv;
+
+    mp_thread_set_name("encode/mux");
+
+    mp_mutex_lock(&ctx->lock);
+    while (1) {
+        if (!p->num_packets) {
+            if (p->mux_terminate)
+                break;
+            mp_cond_wait(&p->mux_wakeup, &ctx->lock);
+            continue;
+        }
+
+        AVPacket *pkt = p->packets[0];
+        MP_TARRAY_REMOVE_AT(p->packets, p->num_packets, 0);
+        mp_cond_broadcast(&p->mux_wakeup);
+        bool failed = p->failed;
+        mp_mutex_unlock(&ctx->lock);
+
+        // Only this thread accesses the muxer after header_written was set.
+        AVStream *st = p->muxer->streams[pkt->stream_index];
+        enum AVMediaType type = st->codecpar->codec_type;
+        int size = pkt->size;
+        double duration = pkt->duration * av_q2d(st->time_base);
+        int ret = failed ? 0 : av_interleaved_write_frame(p->muxer, pkt);
+        av_packet_free(&pkt);
+        int64_t file_size = p->muxer->pb ? avio_size(p->muxer->pb) : 0;
+
+        mp_mutex_lock(&ctx->lock);
+        if (ret < 0) {
+            MP_ERR(p, "Writing packet failed.\n");
+            p->failed = true;
+        }
+        switch (type) {
+        case AVMEDIA_TYPE_VIDEO:
+            p->vbytes += size;
+            p->frames += 1;
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            p->abytes += size;
+            p->audioseconds += duration;
+            break;
+        }
+        p->file_size = file_size;
+    }
+    mp_mutex_unlock(&ctx->lock);
+
+    MP_THREAD_RETURN();
+}
+
 // called locked
 static void maybe_init_muxer(struct encode_lavc_context *ctx)
 {
@@ -257,6 +390,14 @@ static void maybe_init_muxer(struct encode_lavc_context *ctx)
         }
     }
 
+    // With --ovsegments, video packets arrive only once a whole segment was
+    // encoded, up to vsegments * vsegment_length frames after the audio
+    // packets of the same time. Let lavf hold back the other streams for as
+    // long as needed, instead of giving up on interleaving after the default
+    // 10 seconds. This can still be overridden with --ofopts.
+    if (ctx->options->vsegments > 0)
+        p->muxer->max_interleave_delta = 0;
+
     AVDictionary *opts = NULL;
     mp_set_avdict(&opts, ctx->options->fopts);
 
@@ -274,6 +415,12 @@ static void maybe_init_muxer(struct encode_lavc_context *ctx)
 
     p->header_written = true;
 
+    if (mp_thread_create(&p->mux_thread, mux_thread, ctx)) {
+        MP_FATAL(p, "Failed to create mux thread.\n");
+        goto failed;
+    }
+    p->mux_thread_running = true;
+
     for (int n = 0; n < p->num_streams; n++) {
         struct mux_stream *s = p->streams[n];
 
@@ -384,7 +531,8 @@ done:
     mp_mutex_unlock(&ctx->lock);
 }
 
-// Write a packet. This will take over ownership of `pkt`
+// Queue a packet for the mux thread. This will take over ownership of the
+// contents of `pkt`. Blocks while the queue is full.
 static void encode_lavc_add_packet(struct mux_stream *dst, AVPacket *pkt)
 {
     struct encode_lavc_context *ctx = dst->ctx;
@@ -408,30 +556,18 @@ static void encode_lavc_add_packet(struct mux_stream *dst, AVPacket *pkt)
 
     av_packet_rescale_ts(pkt, dst->encoder_timebase, dst->st->time_base);
 
-    switch (dst->st->codecpar->codec_type) {
-    case AVMEDIA_TYPE_VIDEO:
-        p->vbytes += pkt->size;
-        p->frames += 1;
-        break;
-    case AVMEDIA_TYPE_AUDIO:
-        p->abytes += pkt->size;
-        p->audioseconds += pkt->duration
-            * (double)dst->st->time_base.num
-            / (double)dst->st->time_base.den;
-        break;
-    }
-
-    if (av_interleaved_write_frame(p->muxer, pkt) < 0) {
-        MP_ERR(p, "Writing packet failed.\n");
-        p->failed = true;
-    }
+    while (p->num_packets >= MAX_QUEUED_PACKETS && !p->failed)
+        mp_cond_wait(&p->mux_wakeup, &ctx->lock);
 
-    pkt = NULL;
+    AVPacket *new = av_packet_alloc();
+    MP_HANDLE_OOM(new);
+    av_packet_move_ref(new, pkt);
+    MP_TARRAY_APPEND(p, p->packets, p->num_packets, new);
+    mp_cond_broadcast(&p->mux_wakeup);
 
 done:
     mp_mutex_unlock(&ctx->lock);
-    if (pkt)
-        av_packet_unref(pkt);
+    av_packet_unref(pkt);
 }
 
 AVRational encoder_get_mux_timebase_unlocked(struct encoder_context *p)
@@ -675,15 +811,18 @@ int encode_lavc_getstatus(struct encode_lavc_context *ctx,
     }
 
     minutes = (now - p->t0) / 60.0 * (1 - f) / f;
-    megabytes = p->muxer->pb ? (avio_size(p->muxer->pb) / 1048576.0 / f) : 0;
+    megabytes = p->file_size / 1048576.0 / f;
     fps = p->frames / (now - p->t0);
     x = p->audioseconds / (now - p->t0);
+    // Frames waiting for the encoders, packets waiting for the muxer.
+    int queued_frames = atomic_load(&p->queued_frames);
+    int queued_packets = p->num_packets;
     if (p->frames) {
-        snprintf(buf, bufsize, "{%.1fmin %.1ffps %.1fMB}",
-                 minutes, fps, megabytes);
+        snprintf(buf, bufsize, "{%.1fmin %.1ffps %.1fMB q:%d/%d}",
+                 minutes, fps, megabytes, queued_frames, queued_packets);
     } else if (p->audioseconds) {
-        snprintf(buf, bufsize, "{%.1fmin %.2fx %.1fMB}",
-                 minutes, x, megabytes);
+        snprintf(buf, bufsize, "{%.1fmin %.2fx %.1fMB q:%d/%d}",
+                 minutes, x, megabytes, queued_frames, queued_packets);
     } else {
         snprintf(buf, bufsize, "{%.1fmin %.1fMB}",
                  minutes, megabytes);
@@ -708,6 +847,22 @@ bool encode_lavc_didfail(struct encode_lavc_context *ctx)
 static void encoder_destroy(void *ptr)
 {
     struct encoder_context *p = ptr;
+    struct encoder_worker *w = p->worker;
+
+    if (w) {
+        mp_mutex_lock(&w->lock);
+        w->terminate = true;
+        mp_cond_broadcast(&w->wakeup);
+        mp_mutex_unlock(&w->lock);
+        mp_thread_join(w->thread);
+
+        atomic_fetch_add(&p->encode_lavc_ctx->priv->queued_frames, -w->num_frames);
+        for (int n = 0; n < w->num_frames; n++)
+            av_frame_free(&w->frames[n]);
+        mp_mutex_destroy(&w->lock);
+        mp_cond_destroy(&w->wakeup);
+        avcodec_free_context(&w->segment_template);
+    }
 
     av_packet_free(&p->pkt);
     avcodec_parameters_free(&p->info.codecpar);
@@ -836,11 +991,367 @@ static void encoder_2pass_prepare(struct encoder_context *p)
     talloc_free(filename);
 }
 
+// Send the frame to the encoder, and pass the resulting packets to the muxer, or
+// collect them in seg if it's not NULL.
+static bool encode_frame(struct encoder_context *p, AVCodecContext *encoder,
+                         AVFrame *frame, struct encoder_segment *seg)
+{
+    int status = avcodec_send_frame(encoder, frame);
+    if (status < 0) {
+        if (frame && status == AVERROR_EOF)
+            MP_ERR(p, "new data after sending EOF to encoder\n");
+        goto fail;
+    }
+
+    AVPacket *packet = seg ? seg->pkt : p->pkt;
+    for (;;) {
+        status = avcodec_receive_packet(encoder, packet);
+        if (status == AVERROR(EAGAIN))
+            break;
+        if (status < 0 && status != AVERROR_EOF)
+            goto fail;
+
+        if (p->twopass_bytebuffer && encoder->stats_out) {
+            stream_write_buffer(p->twopass_bytebuffer, encoder->stats_out,
+                                strlen(encoder->stats_out));
+        }
+
+        if (status == AVERROR_EOF)
+            break;
+
+        if (seg) {
+            AVPacket *new = av_packet_alloc();
+            MP_HANDLE_OOM(new);
+            av_packet_move_ref(new, packet);
+            MP_TARRAY_APPEND(seg, seg->packets, seg->num_packets, new);
+        } else {
+            encode_lavc_add_packet(p->mux_stream, packet);
+        }
+    }
+
+    return true;
+
+fail:
+    MP_ERR(p, "error encoding at %s\n",
+           frame ? av_ts2timestr(frame->pts, &encoder->time_base) : "EOF");
+    return false;
+}
+
+static MP_THREAD_VOID encoder_thread(void *ptr)
+{
+    struct encoder_context *p = ptr;
+    struct encoder_worker *w = p->worker;
+    struct encode_priv *priv = p->encode_lavc_ctx->priv;
+
+    mp_thread_set_name(p->type == STREAM_VIDEO ? "encode/video" : "encode/audio");
+
+    mp_mutex_lock(&w->lock);
+    while (!w->terminate) {
+        if (!w->num_frames && (!w->flush || w->flushed)) {
+            mp_cond_wait(&w->wakeup, &w->lock);
+            continue;
+        }
+
+        // frame==NULL flushes the encoder once the queue is empty.
+        AVFrame *frame = NULL;
+        if (w->num_frames) {
+            frame = w->frames[0];
+            MP_TARRAY_REMOVE_AT(w->frames, w->num_frames, 0);
+            atomic_fetch_add(&priv->queued_frames, -1);
+        }
+        bool failed = w->failed;
+        mp_cond_broadcast(&w->wakeup);
+        mp_mutex_unlock(&w->lock);
+
+        // After an error, drop the remaining frames.
+        bool ok = !failed && encode_frame(p, p->encoder, frame, NULL);
+
+        mp_mutex_lock(&w->lock);
+        if (!ok)
+            w->failed = true;
+        if (!frame)
+            w->flushed = true;
+        mp_cond_broadcast(&w->wakeup);
+        av_frame_free(&frame);
+    }
+    mp_mutex_unlock(&w->lock);
+
+    MP_THREAD_RETURN();
+}
+
+// Create an unopened encoder with the same settings as src (also unopened).
+static AVCodecContext *clone_encoder(AVCodecContext *src)
+{
+    AVCodecContext *dst = avcodec_alloc_context3(src->codec);
+    MP_HANDLE_OOM(dst);
+    if (av_opt_copy(dst, src) < 0 ||
+        (src->codec->priv_class && av_opt_copy(dst->priv_data, src->priv_data) < 0))
+    {
+        avcodec_free_context(&dst);
+        return NULL;
+    }
+    // Fields set by vo_lavc.c, which are not necessarily AVOptions.
+    dst->width = src->width;
+    dst->height = src->height;
+    dst->pix_fmt = src->pix_fmt;
+    dst->sample_aspect_ratio = src->sample_aspect_ratio;
+    dst->colorspace = src->colorspace;
+    dst->color_range = src->color_range;
+    dst->time_base = src->time_base;
+    dst->framerate = src->framerate;
+    dst->flags = src->flags;
+    return dst;
+}
+
+static void free_segment(struct encoder_segment *seg)
+{
+    if (!seg)
+        return;
+    atomic_fetch_add(&seg->p->encode_lavc_ctx->priv->queued_frames,
+                     -seg->num_frames);
+    for (int n = 0; n < seg->num_frames; n++)
+        av_frame_free(&seg->frames[n]);
+    for (int n = 0; n < seg->num_packets; n++)
+        av_packet_free(&seg->packets[n]);
+    av_packet_free(&seg->pkt);
+    talloc_free(seg);
+}
+
+// Encode a whole segment with a new encoder instance.
+static void encode_segment(struct encoder_segment *seg)
+{
+    struct encoder_context *p = seg->p;
+    struct encoder_worker *w = p->worker;
+
+    bool ok = false;
+    AVCodecContext *encoder = clone_encoder(w->segment_template);
+    if (!encoder || avcodec_open2(encoder, encoder->codec, NULL) < 0) {
+        MP_ERR(p, "Could not initialize segment encoder.\n");
+        goto done;
+    }
+
+    // All segments share the stream headers of the first encoder.
+    AVCodecParameters *par = p->info.codecpar;
+    if (encoder->extradata_size != par->extradata_size ||
+        (par->extradata_size &&
+         memcmp(encoder->extradata, par->extradata, par->extradata_size)))
+    {
+        MP_ERR(p, "Encoder produces different headers for each segment; it "
+                  "can't be used with --ovsegments.\n");
+        goto done;
+    }
+
+    ok = true;
+    for (int n = 0; n < seg->num_frames && ok; n++) {
+        if (atomic_load(&w->cancel)) {
+            ok = false;
+            break;
+        }
+        AVFrame *frame = seg->frames[n];
+        // A new encoder starts with a keyframe anyway; but be explicit.
+        if (n == 0)
+            frame->pict_type = AV_PICTURE_TYPE_I;
+        ok = encode_frame(p, encoder, frame, seg);
+    }
+    ok = ok && encode_frame(p, encoder, NULL, seg);
+
+done:
+    avcodec_free_context(&encoder);
+    atomic_fetch_add(&p->encode_lavc_ctx->priv->queued_frames, -seg->num_frames);
+    for (int n = 0; n < seg->num_frames; n++)
+        av_frame_free(&seg->frames[n]);
+    seg->num_frames = 0;
+
+    mp_mutex_lock(&w->lock);
+    seg->ok = ok;
+    seg->done = true;
+    mp_cond_broadcast(&w->wakeup);
+    mp_mutex_unlock(&w->lock);
+}
+
+// Called with w->lock held.
+static void start_segment(struct encoder_context *p)
+{
+    struct encoder_worker *w = p->worker;
+    MP_TARRAY_APPEND(w, w->segments, w->num_segments, w->cur);
+    w->cur = NULL;
+    mp_cond_broadcast(&w->wakeup);
+}
+
+// Segment encoder thread: encodes started segments. There are max_segments of
+// these, so a started segment is picked up immediately. The encoders block
+// for a long time, so they don't run on the shared task pool.
+static MP_THREAD_VOID segment_encoder_thread(void *ptr)
+{
+    struct encoder_context *p = ptr;
+    struct encoder_worker *w = p->worker;
+
+    mp_thread_set_name("encode/segment");
+
+    mp_mutex_lock(&w->lock);
+    while (1) {
+        struct encoder_segment *seg = NULL;
+        for (int n = 0; n < w->num_segments; n++) {
+            if (!w->segments[n]->claimed) {
+                seg = w->segments[n];
+                break;
+            }
+        }
+        if (seg) {
+            seg->claimed = true;
+            mp_mutex_unlock(&w->lock);
+            encode_segment(seg);
+            mp_mutex_lock(&w->lock);
+            continue;
+        }
+        if (w->seg_terminate)
+            break;
+        mp_cond_wait(&w->wakeup, &w->lock);
+    }
+    mp_mutex_unlock(&w->lock);
+
+    MP_THREAD_RETURN();
+}
+
+// Encoder thread for --ovsegments: cuts the frames into segments, which are
+// encoded in parallel, and passes the packets of finished segments to the
+// muxer in order.
+static MP_THREAD_VOID segment_thread(void *ptr)
+{
+    struct encoder_context *p = ptr;
+    struct encoder_worker *w = p->worker;
+
+    mp_thread_set_name("encode/video");
+
+    w->seg_threads = talloc_array(w, mp_thread, w->max_segments);
+    for (int n = 0; n < w->max_segments; n++) {
+        if (mp_thread_create(&w->seg_threads[n], segment_encoder_thread, p))
+            break;
+        w->num_seg_threads++;
+    }
+
+    mp_mutex_lock(&w->lock);
+    if (!w->num_seg_threads) {
+        MP_ERR(p, "Could not create segment encoder threads.\n");
+        w->failed = true;
+    }
+    while (!w->terminate) {
+        if (w->num_segments && w->segments[0]->done) {
+            struct encoder_segment *seg = w->segments[0];
+            MP_TARRAY_REMOVE_AT(w->segments, w->num_segments, 0);
+            if (!seg->ok)
+                w->failed = true;
+            bool failed = w->failed;
+            mp_cond_broadcast(&w->wakeup);
+            mp_mutex_unlock(&w->lock);
+
+            for (int n = 0; n < seg->num_packets && !failed; n++)
+                encode_lavc_add_packet(p->mux_stream, seg->packets[n]);
+            free_segment(seg);
+
+            mp_mutex_lock(&w->lock);
+            continue;
+        }
+
+        // After an error, drop the remaining frames.
+        if (w->failed && w->cur) {
+            free_segment(w->cur);
+            w->cur = NULL;
+        }
+
+        bool can_start = w->num_segments < w->max_segments;
+
+        if (w->num_frames && can_start) {
+            AVFrame *frame = w->frames[0];
+            MP_TARRAY_REMOVE_AT(w->frames, w->num_frames, 0);
+            mp_cond_broadcast(&w->wakeup);
+            if (w->failed) {
+                atomic_fetch_add(&p->encode_lavc_ctx->priv->queued_frames, -1);
+                av_frame_free(&frame);
+                continue;
+            }
+            if (!w->cur) {
+                w->cur = talloc_zero(NULL, struct encoder_segment);
+                w->cur->p = p;
+                w->cur->pkt = av_packet_alloc();
+                MP_HANDLE_OOM(w->cur->pkt);
+            }
+            MP_TARRAY_APPEND(w->cur, w->cur->frames, w->cur->num_frames, frame);
+            if (w->cur->num_frames >= w->segment_length)
+                start_segment(p);
+            continue;
+        }
+
+        if (w->flush && !w->flushed && !w->num_frames) {
+            if (w->cur && can_start) {
+                start_segment(p);
+                continue;
+            }
+            if (!w->cur && !w->num_segments) {
+                w->flushed = true;
+                mp_cond_broadcast(&w->wakeup);
+                continue;
+            }
+        }
+
+        mp_cond_wait(&w->wakeup, &w->lock);
+    }
+
+    // Drop segments nobody started on, and let the running ones abort.
+    atomic_store(&w->cancel, true);
+    w->seg_terminate = true;
+    mp_cond_broadcast(&w->wakeup);
+    while (w->num_segments) {
+        struct encoder_segment *seg = w->segments[0];
+        if (seg->done || !seg->claimed) {
+            seg->claimed = true;
+            free_segment(seg);
+            MP_TARRAY_REMOVE_AT(w->segments, w->num_segments, 0);
+        } else {
+            mp_cond_wait(&w->wakeup, &w->lock);
+        }
+    }
+    free_segment(w->cur);
+    w->cur = NULL;
+    mp_mutex_unlock(&w->lock);
+
+    for (int n = 0; n < w->num_seg_threads; n++)
+        mp_thread_join(w->seg_threads[n]);
+
+    MP_THREAD_RETURN();
+}
+
+// segment_template is the unopened encoder for --ovsegments, or NULL.
+static bool encoder_start_thread(struct encoder_context *p,
+                                 AVCodecContext *segment_template)
+{
+    struct encoder_worker *w = talloc_zero(p, struct encoder_worker);
+    mp_mutex_init(&w->lock);
+    mp_cond_init(&w->wakeup);
+    if (segment_template) {
+        w->max_segments = p->options->vsegments;
+        w->segment_length = p->options->vsegment_length;
+        w->segment_template = segment_template;
+    }
+    p->worker = w;
+    if (mp_thread_create(&w->thread,
+                         segment_template ? segment_thread : encoder_thread, p))
+    {
+        mp_mutex_destroy(&w->lock);
+        mp_cond_destroy(&w->wakeup);
+        p->worker = NULL;
+        return false;
+    }
+    return true;
+}
+
 bool encoder_init_codec_and_muxer(struct encoder_context *p,
                                   void (*on_ready)(void *ctx), void *ctx)
 {
     assert(!avcodec_is_open(p->encoder));
 
+    AVCodecContext *segment_template = NULL;
+
     char **copts = p->type == STREAM_VIDEO
         ? p->options->vopts
         : p->options->aopts;
@@ -879,6 +1390,23 @@ bool encoder_init_codec_and_muxer(struct encoder_context *p,
                 p->encoder->codec->name);
     }
 
+    // Each segment gets its own encoder with the same settings. The main
+    // encoder provides the stream parameters, but encodes nothing.
+    if (p->type == STREAM_VIDEO && p->options->vsegments > 0) {
+        if (p->encoder->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2)) {
+            MP_WARN(p, "--ovsegments does not work with 2-pass encoding; "
+                       "disabling it.\n");
+        } else {
+            segment_template = clone_encoder(p->encoder);
+            if (!segment_template) {
+                MP_FATAL(p, "Could not copy encoder settings.\n");
+                goto fail;
+            }
+            MP_INFO(p, "Encoding %d segments of %d frames in parallel.\n",
+                    p->options->vsegments, p->options->vsegment_length);
+        }
+    }
+
     if (avcodec_open2(p->encoder, p->encoder->codec, NULL) < 0) {
         MP_FATAL(p, "Could not initialize encoder.\n");
         goto fail;
@@ -897,47 +1425,61 @@ bool encoder_init_codec_and_muxer(struct encoder_context *p,
     if (!p->mux_stream)
         goto fail;
 
+    if (!encoder_start_thread(p, segment_template)) {
+        MP_FATAL(p, "Could not create encoder thread.\n");
+        goto fail;
+    }
+
     return true;
 
 fail:
+    avcodec_free_context(&segment_template);
     avcodec_free_context(&p->encoder);
     return false;
 }
 
 bool encoder_encode(struct encoder_context *p, AVFrame *frame)
 {
-    int status = avcodec_send_frame(p->encoder, frame);
-    if (status < 0) {
-        if (frame && status == AVERROR_EOF)
-            MP_ERR(p, "new data after sending EOF to encoder\n");
-        goto fail;
+    struct encoder_worker *w = p->worker;
+    if (!w)
+        return false;
+
+    AVFrame *ref = NULL;
+    if (frame) {
+        ref = av_frame_clone(frame);
+        MP_HANDLE_OOM(ref);
     }
 
-    AVPacket *packet = p->pkt;
-    for (;;) {
-        status = avcodec_receive_packet(p->encoder, packet);
-        if (status == AVERROR(EAGAIN))
-            break;
-        if (status < 0 && status != AVERROR_EOF)
-            goto fail;
+    mp_mutex_lock(&w->lock);
 
-        if (p->twopass_bytebuffer && p->encoder->stats_out) {
-            stream_write_buffer(p->twopass_bytebuffer, p->encoder->stats_out,
-                                strlen(p->encoder->stats_out));
-        }
+    while (w->num_frames >= MAX_QUEUED_FRAMES && !w->failed)
+        mp_cond_wait(&w->wakeup, &w->lock);
 
-        if (status == AVERROR_EOF)
-            break;
+    bool ok = !w->failed;
+    if (ok && w->flush) {
+        if (frame)
+            MP_ERR(p, "new data after sending EOF to encoder\n");
+        ok = false;
+    }
 
-        encode_lavc_add_packet(p->mux_stream, packet);
+    if (ok && ref) {
+        MP_TARRAY_APPEND(w, w->frames, w->num_frames, ref);
+        atomic_fetch_add(&p->encode_lavc_ctx->priv->queued_frames, 1);
+        ref = NULL;
+    } else if (ok) {
+        // Wait until everything was encoded, like a synchronous flush.
+        w->flush = true;
+        mp_cond_broadcast(&w->wakeup);
+        while (!w->flushed && !w->failed)
+            mp_cond_wait(&w->wakeup, &w->lock);
+        ok = !w->failed;
     }
+    mp_cond_broadcast(&w->wakeup);
 
-    return true;
+    mp_mutex_unlock(&w->lock);
 
-fail:
-    MP_ERR(p, "error encoding at %s\n",
-           frame ? av_ts2timestr(frame->pts, &p->encoder->time_base) : "EOF");
-    return false;
+    av_frame_free(&ref);
+    return ok;
 }
 
 void encoder_update_log(struct mpv_global *global)
@@ -86,6 +86,7 @@ struct encoder_context {
     // (essentially private)
     struct stream *twopass_bytebuffer;
     AVPacket *pkt;
+    struct encoder_worker *worker;
 };
 
 // Free with talloc_free(). (Keep in mind actual deinitialization requires
@@ -98,13 +99,18 @@ struct encoder_context *encoder_context_alloc(struct encode_lavc_context *ctx,
 // After setting your codec parameters on p->encoder, you call this to "open"
 // the encoder. This also initializes p->mux_stream. Returns false on failure.
 // on_ready is called as soon as the muxer has been initialized. Then you are
-// allowed to write packets with encoder_encode().
+// allowed to write packets with encoder_encode(). This also starts the encoder
+// thread; from then on, only that thread may use p->encoder with libavcodec
+// API calls (reading the immutable parameters is fine).
 // Warning: the on_ready callback is called asynchronously, so you need to
 // make sure to properly synchronize everything.
 bool encoder_init_codec_and_muxer(struct encoder_context *p,
                                   void (*on_ready)(void *ctx), void *ctx);
 
-// Encode the frame and write the packet. frame is ref'ed as need.
+// Queue the frame for encoding on the encoder thread. The packets are written by
+// the mux thread. frame is ref'ed as needed. This blocks only if too many frames
+// are queued. frame==NULL flushes the encoder, and waits until all frames were
+// encoded. Returns false if encoding failed (possibly for an earlier frame).
 bool encoder_encode(struct encoder_context *p, AVFrame *frame);
 
 // Return muxer timebase (only available after on_ready() has been called).
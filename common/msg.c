@@ -27,6 +27,7 @@
 
 #include "common/common.h"
 #include "common/global.h"
+#include "common/stats.h"
 #include "misc/codepoint_width.h"
 #include "options/options.h"
 #include "options/path.h"
@@ -40,8 +41,38 @@
 #include "msg.h"
 #include "msg_control.h"
 
-// log buffer size (lines) logfile level
-#define FILE_BUF 100
+// Number of log file rings. Threads are distributed over them round-robin, so
+// that with typical thread counts each thread effectively owns its own ring.
+#define LOG_RINGS 8
+
+// Messages per log file ring (must be a power of 2). If the log file thread
+// falls behind, further messages are dropped instead of blocking the caller.
+#define LOG_RING_SIZE 1024
+
+// --log-file-format=binary. All integers are little endian. The file starts
+// with BINLOG_MAGIC and a u32 version, followed by records which start with a
+// u8 record type:
+//  BINLOG_MODULE:  u32 module id, u32 length, module name
+//                  (written before the first message of a module)
+//  BINLOG_MSG:     u32 module id, u8 level, i64 time (ns), u32 thread,
+//                  u32 length, message text (may contain multiple lines)
+//  BINLOG_DROPPED: i64 time (ns), u64 number of skipped messages
+// TOOLS/log-decode.py converts this back to the text format.
+#define BINLOG_MAGIC "MPVBLOG\n"
+#define BINLOG_VERSION 1
+enum {
+    BINLOG_MODULE = 'M',
+    BINLOG_MSG = 'L',
+    BINLOG_DROPPED = 'D',
+};
+
+// Module names for the binary log file are interned, so that messages only
+// need to reference them.
+struct log_module {
+    char *name;
+    uint32_t id;
+    bool written;   // defined in the current binary log file
+};
 
 // lines to accumulate before any client requests the terminal loglevel
 #define EARLY_TERM_BUF 100
@@ -52,6 +83,29 @@
 // overwritten, then the first (virtual) log line indicates how many were lost.
 #define EARLY_FILE_BUF 5000
 
+struct log_file_msg {
+    int64_t time;
+    uint64_t seq;
+    uint32_t thread;
+    int level;
+    char *prefix;               // text log file only
+    struct log_module *module;  // binary log file only
+    char *text;
+};
+
+struct log_ring_slot {
+    atomic_size_t seq;
+    struct log_file_msg *msg;
+};
+
+// Bounded lock-free queue with any number of producers, and the log file
+// thread as the only consumer.
+struct log_ring {
+    atomic_size_t tail;         // next write position
+    size_t head;                // next read position, consumer only
+    struct log_ring_slot slots[LOG_RING_SIZE];
+};
+
 struct mp_log_root {
     struct mpv_global *global;
     mp_mutex lock;
@@ -85,13 +139,31 @@ struct mp_log_root {
      * (This is perhaps better than maintaining a globally accessible and
      * synchronized mp_log tree.) */
     atomic_ulong reload_counter;
+    struct log_ring *log_rings;         // LOG_RINGS entries
+    // --- protected by modules_lock
+    mp_mutex modules_lock;
+    void *modules_ctx;
+    struct log_module **modules;        // indexed by id
+    int num_modules;
+    struct log_module **modules_hash;   // open addressing, size power of 2
+    int modules_hash_size;
+    atomic_bool log_file_async;         // log_file_thread accepts messages
+    atomic_int log_file_pushing;        // threads in push_log_file_msg()
+    atomic_bool log_file_idle;          // log_file_thread is going to sleep
+    atomic_uint_least64_t log_file_seq;
+    atomic_uint_least64_t log_file_dropped;
     // --- owner thread only (caller of mp_msg_init() etc.)
     char *log_path;
     char *stats_path;
     mp_thread log_file_thread;
     // --- owner thread only, but frozen while log_file_thread is running
     FILE *log_file;
-    struct mp_log_buffer *log_file_buffer;
+    bool log_file_binary;
+    struct log_file_msg **log_file_msgs; // LOG_RINGS * LOG_RING_SIZE entries
+    // --- log_file_thread, or owner thread while it's not running
+    uint64_t log_file_dropped_total;
+    // --- immutable
+    struct stats_ctx *stats;            // NULL if global has no stats
     // --- protected by log_file_lock
     bool log_file_thread_active; // also termination signal for the thread
     int module_indent;
@@ -101,10 +173,14 @@ struct mp_log {
     struct mp_log_root *root;
     const char *prefix;
     const char *verbose_prefix;
+    // interned verbose_prefix, set on first use with a binary log file
+    _Atomic(struct log_module *) module;
     int max_level;              // minimum log level for this instance
     int level;                  // minimum log level for any outputs
     int terminal_level;         // minimum log level for terminal output
+    int sync_level;             // minimum log level for outputs under root->lock
     atomic_ulong reload_counter;
+    atomic_bool has_partial;    // any partial[] is non-empty
     bstr partial[MSGL_MAX + 1];
 };
 
@@ -155,10 +231,11 @@ static void update_loglevel(struct mp_log *log)
         if (buffer_level != MP_LOG_BUFFER_MSGL_TERM)
             log->level = MPMAX(log->level, buffer_level);
     }
-    if (log->root->log_file)
-        log->level = MPMAX(log->level, MSGL_DEBUG);
     if (log->root->stats_file)
         log->level = MPMAX(log->level, MSGL_STATS);
+    log->sync_level = MPMIN(log->level, log->max_level);
+    if (atomic_load(&log->root->log_file_async))
+        log->level = MPMAX(log->level, MSGL_DEBUG);
     log->level = MPMIN(log->level, log->max_level);
     atomic_store(&log->reload_counter, atomic_load(&log->root->reload_counter));
     mp_mutex_unlock(&root->lock);
@@ -452,25 +529,6 @@ static void write_msg_to_buffers(struct mp_log *log, int lev, bstr text)
         if (buffer_level == MP_LOG_BUFFER_MSGL_LOGFILE)
             buffer_level = MPMAX(log->terminal_level, MSGL_DEBUG);
         if (lev <= buffer_level && lev != MSGL_STATUS) {
-            if (buffer->level == MP_LOG_BUFFER_MSGL_LOGFILE) {
-                // If the buffer is full, block until we can write again,
-                // unless there's no write thread (died, or early filebuffer)
-                bool dead = false;
-                while (buffer->num_entries == buffer->capacity && !dead) {
-                    // Temporary unlock is OK; buffer->level is immutable, and
-                    // buffer can't go away because the global log lock is held.
-                    mp_mutex_unlock(&buffer->lock);
-                    mp_mutex_lock(&root->log_file_lock);
-                    if (root->log_file_thread_active) {
-                        mp_cond_wait(&root->log_file_wakeup,
-                                          &root->log_file_lock);
-                    } else {
-                        dead = true;
-                    }
-                    mp_mutex_unlock(&root->log_file_lock);
-                    mp_mutex_lock(&buffer->lock);
-                }
-            }
             if (buffer->num_entries == buffer->capacity) {
                 struct mp_log_buffer_entry *skip = log_buffer_read(buffer);
                 talloc_free(skip);
@@ -494,6 +552,215 @@ static void write_msg_to_buffers(struct mp_log *log, int lev, bstr text)
     }
 }
 
+static bool log_ring_push(struct log_ring *ring, struct log_file_msg *msg)
+{
+    size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (1) {
+        struct log_ring_slot *slot = &ring->slots[pos % LOG_RING_SIZE];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)(seq - pos);
+        if (diff < 0)
+            return false; // full
+        if (diff > 0) {
+            // Another producer claimed this slot first.
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        } else if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos,
+                        pos + 1, memory_order_relaxed, memory_order_relaxed))
+        {
+            slot->msg = msg;
+            atomic_store(&slot->seq, pos + 1);
+            return true;
+        }
+    }
+}
+
+static struct log_file_msg *log_ring_pop(struct log_ring *ring)
+{
+    struct log_ring_slot *slot = &ring->slots[ring->head % LOG_RING_SIZE];
+    if (atomic_load(&slot->seq) != ring->head + 1)
+        return NULL;
+    struct log_file_msg *msg = slot->msg;
+    atomic_store_explicit(&slot->seq, ring->head + LOG_RING_SIZE,
+                          memory_order_release);
+    ring->head += 1;
+    return msg;
+}
+
+static bool log_rings_empty(struct mp_log_root *root)
+{
+    for (int n = 0; n < LOG_RINGS; n++) {
+        struct log_ring *ring = &root->log_rings[n];
+        struct log_ring_slot *slot = &ring->slots[ring->head % LOG_RING_SIZE];
+        if (atomic_load(&slot->seq) == ring->head + 1)
+            return false;
+    }
+    return true;
+}
+
+static uint32_t hash_module_name(const char *name)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+    for (; *name; name++)
+        h = (h ^ (unsigned char)*name) * 16777619u;
+    return h;
+}
+
+// Return the slot in modules_hash for the given name. Called locked.
+static struct log_module **find_module_slot(struct mp_log_root *root,
+                                            const char *name)
+{
+    uint32_t mask = root->modules_hash_size - 1;
+    for (uint32_t n = hash_module_name(name) & mask; ; n = (n + 1) & mask) {
+        struct log_module **slot = &root->modules_hash[n];
+        if (!*slot || !strcmp((*slot)->name, name))
+            return slot;
+    }
+}
+
+static struct log_module *intern_log_module(struct mp_log_root *root,
+                                            const char *name)
+{
+    mp_mutex_lock(&root->modules_lock);
+    if (root->num_modules * 2 >= root->modules_hash_size) {
+        talloc_free(root->modules_hash);
+        root->modules_hash_size = MPMAX(root->modules_hash_size * 2, 64);
+        root->modules_hash = talloc_zero_array(root->modules_ctx,
+                                               struct log_module *,
+                                               root->modules_hash_size);
+        for (int n = 0; n < root->num_modules; n++)
+            *find_module_slot(root, root->modules[n]->name) = root->modules[n];
+    }
+    struct log_module **slot = find_module_slot(root, name);
+    if (!*slot) {
+        struct log_module *module = talloc_ptrtype(root->modules_ctx, module);
+        *module = (struct log_module) {
+            .name = talloc_strdup(module, name),
+            .id = root->num_modules,
+        };
+        MP_TARRAY_APPEND(root->modules_ctx, root->modules, root->num_modules,
+                         module);
+        *slot = module;
+    }
+    struct log_module *module = *slot;
+    mp_mutex_unlock(&root->modules_lock);
+    return module;
+}
+
+// Only used with a binary log file, so that modules are interned only while
+// one is open.
+static struct log_module *get_log_module(struct mp_log *log)
+{
+    struct log_module *module = atomic_load(&log->module);
+    if (!module) {
+        module = intern_log_module(log->root, log->verbose_prefix
+                                   ? log->verbose_prefix : "global");
+        atomic_store(&log->module, module);
+    }
+    return module;
+}
+
+static void wakeup_log_file(void *p)
+{
+    struct mp_log_root *root = p;
+
+    mp_mutex_lock(&root->log_file_lock);
+    mp_cond_broadcast(&root->log_file_wakeup);
+    mp_mutex_unlock(&root->log_file_lock);
+}
+
+// Leave push_log_file_msg(). If the log file thread is being terminated, the
+// last thread to leave wakes up terminate_log_file_thread().
+static void end_log_file_push(struct mp_log_root *root)
+{
+    if (atomic_fetch_sub(&root->log_file_pushing, 1) == 1 &&
+        !atomic_load(&root->log_file_async))
+        wakeup_log_file(root);
+}
+
+// Queue a message for the log file thread. Takes ownership of text. This never
+// blocks; if the ring is full, the message is dropped and counted. Returns
+// false (and does not take ownership) if the log file thread is being
+// terminated, in which case the caller must use the synchronous path.
+static bool push_log_file_msg(struct mp_log *log, int lev, char *text)
+{
+    struct mp_log_root *root = log->root;
+
+    // Pairs with terminate_log_file_thread(): either we see log_file_async
+    // cleared, or it waits until we're done queuing, so that every queued
+    // message is written by the final flush.
+    atomic_fetch_add(&root->log_file_pushing, 1);
+    if (!atomic_load(&root->log_file_async)) {
+        end_log_file_push(root);
+        return false;
+    }
+
+    // Small per-thread number, also used to pick the ring.
+    static atomic_uint next_thread;
+    static _Thread_local unsigned int thread; // number + 1, 0 if unassigned
+    if (!thread)
+        thread = atomic_fetch_add(&next_thread, 1) + 1;
+
+    struct log_file_msg *msg = talloc_ptrtype(NULL, msg);
+    *msg = (struct log_file_msg) {
+        .time = mp_time_ns(),
+        .seq = atomic_fetch_add(&root->log_file_seq, 1),
+        .thread = thread,
+        .level = lev,
+        .text = talloc_steal(msg, text),
+    };
+    // log_file_binary can't change while log_file_async is set.
+    if (root->log_file_binary) {
+        msg->module = get_log_module(log);
+    } else {
+        msg->prefix = talloc_strdup(msg, log->verbose_prefix
+                                    ? log->verbose_prefix : "global");
+    }
+
+    if (!log_ring_push(&root->log_rings[(thread - 1) % LOG_RINGS], msg)) {
+        atomic_fetch_add(&root->log_file_dropped, 1);
+        talloc_free(msg);
+    } else if (atomic_load(&root->log_file_idle)) {
+        wakeup_log_file(root);
+    }
+
+    end_log_file_push(root);
+    return true;
+}
+
+static void write_msg_to_log_file(struct mp_log *log, int lev, bstr text)
+{
+    if (lev <= MPMAX(log->terminal_level, MSGL_DEBUG) && lev != MSGL_STATUS &&
+        atomic_load_explicit(&log->root->log_file_async, memory_order_relaxed))
+    {
+        char *copy = bstrdup0(NULL, text);
+        if (!push_log_file_msg(log, lev, copy))
+            talloc_free(copy);
+    }
+}
+
+// Messages which only go to the log file are formatted and queued without
+// taking root->lock. Returns false if the message has to take the normal path,
+// because it is not a complete line, or continues a partial line.
+static bool write_msg_async(struct mp_log *log, int lev, const char *format,
+                            va_list va)
+{
+    if (atomic_load_explicit(&log->has_partial, memory_order_relaxed))
+        return false;
+
+    char *text = talloc_vasprintf(NULL, format, va);
+    size_t len = text ? strlen(text) : 0;
+    if (!len || text[len - 1] != '\n') {
+        talloc_free(text);
+        return false;
+    }
+
+    if (!push_log_file_msg(log, lev, text)) {
+        talloc_free(text);
+        return false;
+    }
+    return true;
+}
+
 static void dump_stats(struct mp_log *log, int lev, bstr text)
 {
     struct mp_log_root *root = log->root;
@@ -535,6 +802,7 @@ static void write_term_msg(struct mp_log *log, int lev, bstr text, bstr *out)
                                 ? 1 : (line_w + term_w - 1) / term_w;
         }
         write_msg_to_buffers(log, lev, line);
+        write_msg_to_log_file(log, lev, line);
     }
 
     if (lev == MSGL_STATUS) {
@@ -564,6 +832,15 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
     if (!mp_msg_test(log, lev))
         return; // do not display
 
+    if (lev > log->sync_level && lev != MSGL_STATUS && lev != MSGL_STATS) {
+        va_list copy;
+        va_copy(copy, va);
+        bool done = write_msg_async(log, lev, format, copy);
+        va_end(copy);
+        if (done)
+            return;
+    }
+
     struct mp_log_root *root = log->root;
 
     mp_mutex_lock(&root->lock);
@@ -612,6 +889,11 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
         }
     }
 
+    bool has_partial = false;
+    for (int n = 0; n <= MSGL_MAX; n++)
+        has_partial |= log->partial[n].len > 0;
+    atomic_store_explicit(&log->has_partial, has_partial, memory_order_relaxed);
+
     mp_mutex_unlock(&root->lock);
 }
 
@@ -681,6 +963,18 @@ void mp_msg_init(struct mpv_global *global)
     mp_mutex_init(&root->lock);
     mp_mutex_init(&root->log_file_lock);
     mp_cond_init(&root->log_file_wakeup);
+    mp_mutex_init(&root->modules_lock);
+    root->modules_ctx = talloc_new(NULL);
+
+    root->log_rings = talloc_zero_array(root, struct log_ring, LOG_RINGS);
+    for (int n = 0; n < LOG_RINGS; n++) {
+        for (size_t i = 0; i < LOG_RING_SIZE; i++)
+            atomic_init(&root->log_rings[n].slots[i].seq, i);
+    }
+    root->log_file_msgs = talloc_array(root, struct log_file_msg *,
+                                       LOG_RINGS * LOG_RING_SIZE);
+    if (global->stats)
+        root->stats = stats_ctx_create(root, global, "log");
 
     struct mp_log dummy = { .root = root };
     struct mp_log *log = mp_log_new(root, &dummy, "");
@@ -688,44 +982,145 @@ void mp_msg_init(struct mpv_global *global)
     global->log = log;
 }
 
-static MP_THREAD_VOID log_file_thread(void *p)
+static int cmp_log_file_msg(const void *a, const void *b)
 {
-    struct mp_log_root *root = p;
+    const struct log_file_msg *ma = *(struct log_file_msg **)a;
+    const struct log_file_msg *mb = *(struct log_file_msg **)b;
+    return ma->seq < mb->seq ? -1 : (ma->seq > mb->seq);
+}
 
-    mp_thread_set_name("log");
+static void put_le(uint8_t **p, uint64_t v, int bytes)
+{
+    for (int n = 0; n < bytes; n++)
+        *(*p)++ = v >> (n * 8);
+}
 
-    mp_mutex_lock(&root->log_file_lock);
+static void write_binlog_header(FILE *f)
+{
+    uint8_t buf[16], *p = buf;
+    memcpy(p, BINLOG_MAGIC, 8);
+    p += 8;
+    put_le(&p, BINLOG_VERSION, 4);
+    fwrite(buf, p - buf, 1, f);
+}
 
-    while (root->log_file_thread_active) {
-        struct mp_log_buffer_entry *e =
-            mp_msg_log_buffer_read(root->log_file_buffer);
-        if (e) {
-            mp_mutex_unlock(&root->log_file_lock);
-            fprintf(root->log_file, "[%8.3f][%c][%s] %s",
-                    mp_time_sec(),
-                    mp_log_levels[e->level][0], e->prefix, e->text);
-            fflush(root->log_file);
-            mp_mutex_lock(&root->log_file_lock);
-            talloc_free(e);
-            // Multiple threads might be blocked if the log buffer was full.
-            mp_cond_broadcast(&root->log_file_wakeup);
-        } else {
-            mp_cond_wait(&root->log_file_wakeup, &root->log_file_lock);
+static void write_log_file_msg(struct mp_log_root *root, struct log_file_msg *msg)
+{
+    FILE *f = root->log_file;
+    if (!root->log_file_binary) {
+        bstr text = bstr0(msg->text);
+        while (text.len) {
+            bstr line = bstr_getline(text, &text);
+            bstr_eatstart0(&line, TERM_MSG_0);
+            fprintf(f, "[%8.3f][%c][%s] %.*s", MP_TIME_NS_TO_S(msg->time),
+                    mp_log_levels[msg->level][0], msg->prefix, BSTR_P(line));
         }
+        return;
     }
 
-    mp_mutex_unlock(&root->log_file_lock);
+    struct log_module *module = msg->module;
+    uint8_t buf[32], *p;
+    if (!module->written) {
+        size_t len = strlen(module->name);
+        p = buf;
+        put_le(&p, BINLOG_MODULE, 1);
+        put_le(&p, module->id, 4);
+        put_le(&p, len, 4);
+        fwrite(buf, p - buf, 1, f);
+        fwrite(module->name, len, 1, f);
+        module->written = true;
+    }
 
-    MP_THREAD_RETURN();
+    size_t len = strlen(msg->text);
+    p = buf;
+    put_le(&p, BINLOG_MSG, 1);
+    put_le(&p, module->id, 4);
+    put_le(&p, msg->level, 1);
+    put_le(&p, msg->time, 8);
+    put_le(&p, msg->thread, 4);
+    put_le(&p, len, 4);
+    fwrite(buf, p - buf, 1, f);
+    fwrite(msg->text, len, 1, f);
 }
 
-static void wakeup_log_file(void *p)
+static void write_log_file_dropped(struct mp_log_root *root, uint64_t dropped)
+{
+    if (!root->log_file_binary) {
+        fprintf(root->log_file, "[%8.3f][f][overflow] log message buffer "
+                "overflow: %"PRIu64" messages skipped\n", mp_time_sec(),
+                dropped);
+        return;
+    }
+
+    uint8_t buf[32], *p = buf;
+    put_le(&p, BINLOG_DROPPED, 1);
+    put_le(&p, mp_time_ns(), 8);
+    put_le(&p, dropped, 8);
+    fwrite(buf, p - buf, 1, root->log_file);
+}
+
+// Write all queued messages to the log file (or discard them if there is none),
+// in the order in which they were logged. Returns the number of messages.
+// Only to be called by log_file_thread, or if it's not running.
+static int flush_log_rings(struct mp_log_root *root)
+{
+    struct log_file_msg **msgs = root->log_file_msgs;
+    int num_msgs = 0;
+    for (int n = 0; n < LOG_RINGS; n++) {
+        struct log_file_msg *msg;
+        while (num_msgs < LOG_RINGS * LOG_RING_SIZE &&
+               (msg = log_ring_pop(&root->log_rings[n])))
+            msgs[num_msgs++] = msg;
+    }
+
+    // Every ring is in order by itself, but threads share rings only if there
+    // are many of them, so merging by sorting is good enough.
+    qsort(msgs, num_msgs, sizeof(msgs[0]), cmp_log_file_msg);
+
+    uint64_t dropped = atomic_exchange(&root->log_file_dropped, 0);
+    root->log_file_dropped_total += dropped;
+    if (root->stats)
+        stats_value(root->stats, "file-dropped", root->log_file_dropped_total);
+    if (root->log_file) {
+        for (int n = 0; n < num_msgs; n++)
+            write_log_file_msg(root, msgs[n]);
+        if (dropped)
+            write_log_file_dropped(root, dropped);
+        if (num_msgs || dropped)
+            fflush(root->log_file);
+    }
+
+    for (int n = 0; n < num_msgs; n++)
+        talloc_free(msgs[n]);
+    return num_msgs;
+}
+
+static MP_THREAD_VOID log_file_thread(void *p)
 {
     struct mp_log_root *root = p;
 
-    mp_mutex_lock(&root->log_file_lock);
-    mp_cond_broadcast(&root->log_file_wakeup);
-    mp_mutex_unlock(&root->log_file_lock);
+    mp_thread_set_name("log");
+
+    while (1) {
+        int num_msgs = flush_log_rings(root);
+
+        mp_mutex_lock(&root->log_file_lock);
+        bool active = root->log_file_thread_active;
+        if (active && !num_msgs) {
+            // Producers check log_file_idle after queuing, so either they see
+            // it set and wake us up, or we see their message here.
+            atomic_store(&root->log_file_idle, true);
+            if (log_rings_empty(root))
+                mp_cond_wait(&root->log_file_wakeup, &root->log_file_lock);
+            atomic_store(&root->log_file_idle, false);
+        }
+        mp_mutex_unlock(&root->log_file_lock);
+
+        if (!active)
+            break;
+    }
+
+    MP_THREAD_RETURN();
 }
 
 // Only to be called from the main thread.
@@ -734,18 +1129,27 @@ static void terminate_log_file_thread(struct mp_log_root *root)
     bool wait_terminate = false;
 
     mp_mutex_lock(&root->log_file_lock);
+    atomic_store(&root->log_file_async, false);
     if (root->log_file_thread_active) {
         root->log_file_thread_active = false;
         mp_cond_broadcast(&root->log_file_wakeup);
         wait_terminate = true;
     }
     mp_mutex_unlock(&root->log_file_lock);
+    atomic_fetch_add(&root->reload_counter, 1);
 
     if (wait_terminate)
         mp_thread_join(root->log_file_thread);
 
-    mp_msg_log_buffer_destroy(root->log_file_buffer);
-    root->log_file_buffer = NULL;
+    // Threads which saw log_file_async still set may be queuing right now.
+    // The last of them wakes us up. New messages take the synchronous path.
+    mp_mutex_lock(&root->log_file_lock);
+    while (atomic_load(&root->log_file_pushing))
+        mp_cond_wait(&root->log_file_wakeup, &root->log_file_lock);
+    mp_mutex_unlock(&root->log_file_lock);
+
+    // Messages queued while the thread was exiting.
+    flush_log_rings(root);
 
     if (root->log_file)
         fclose(root->log_file);
@@ -804,11 +1208,19 @@ void mp_msg_update_msglevels(struct mpv_global *global, struct MPOpts *opts)
     atomic_fetch_add(&root->reload_counter, 1);
     mp_mutex_unlock(&root->lock);
 
-    if (check_new_path(global, opts->log_file, &root->log_path)) {
+    bool new_log_path = check_new_path(global, opts->log_file, &root->log_path);
+    if (new_log_path || root->log_file_binary != opts->log_file_format) {
         terminate_log_file_thread(root);
+        root->log_file_binary = opts->log_file_format;
         if (root->log_path) {
             root->log_file = fopen(root->log_path, "wb");
             if (root->log_file) {
+                mp_mutex_lock(&root->modules_lock);
+                for (int n = 0; n < root->num_modules; n++)
+                    root->modules[n]->written = false;
+                mp_mutex_unlock(&root->modules_lock);
+                if (root->log_file_binary)
+                    write_binlog_header(root->log_file);
 
                 // if a logfile is created and the early filebuf still exists,
                 // flush and destroy the early buffer
@@ -819,31 +1231,34 @@ void mp_msg_update_msglevels(struct mpv_global *global, struct MPOpts *opts)
                 mp_mutex_unlock(&root->lock);
 
                 if (earlybuf) {
-                    // flush, destroy before creating the normal logfile buf,
-                    // as once the new one is created (specifically, its write
-                    // thread), then MSGL_LOGFILE messages become blocking, but
-                    // the early logfile buf is without dequeue - can deadlock.
+                    // flush, destroy before starting the write thread, so that
+                    // the early messages are written before any newer ones.
                     // note: timestamp is unknown, we use 0.000 as indication.
                     // note: new messages while iterating are still flushed.
                     struct mp_log_buffer_entry *e;
                     while ((e = mp_msg_log_buffer_read(earlybuf))) {
-                        fprintf(root->log_file, "[%8.3f][%c][%s] %s", 0.0,
-                                mp_log_levels[e->level][0], e->prefix, e->text);
+                        struct log_file_msg msg = {
+                            .level = e->level,
+                            .prefix = e->prefix,
+                            .text = e->text,
+                        };
+                        if (root->log_file_binary)
+                            msg.module = intern_log_module(root, e->prefix);
+                        write_log_file_msg(root, &msg);
                         talloc_free(e);
                     }
                     mp_msg_log_buffer_destroy(earlybuf);  // + remove from root
                 }
 
-                root->log_file_buffer =
-                    mp_msg_log_buffer_new(global, FILE_BUF, MP_LOG_BUFFER_MSGL_LOGFILE,
-                                          wakeup_log_file, root);
                 root->log_file_thread_active = true;
+                atomic_store(&root->log_file_async, true);
                 if (mp_thread_create(&root->log_file_thread, log_file_thread,
                                    root))
                 {
                     root->log_file_thread_active = false;
                     terminate_log_file_thread(root);
                 }
+                atomic_fetch_add(&root->reload_counter, 1);
             } else {
                 mp_err(global->log, "Failed to open log file '%s'\n",
                        root->log_path);
@@ -906,6 +1321,8 @@ void mp_msg_uninit(struct mpv_global *global)
     mp_mutex_destroy(&root->lock);
     mp_mutex_destroy(&root->log_file_lock);
     mp_cond_destroy(&root->log_file_wakeup);
+    mp_mutex_destroy(&root->modules_lock);
+    talloc_free(root->modules_ctx);
     talloc_free(root);
     global->log = NULL;
 }
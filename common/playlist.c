@@ -51,13 +51,301 @@ void playlist_entry_add_params(struct playlist_entry *e,
         playlist_entry_add_param(e, params[n].name, params[n].value);
 }
 
-static void playlist_update_indexes(struct playlist *pl, int start, int end)
+static int tree_size(struct playlist_entry *e)
 {
-    start = MPMAX(start, 0);
-    end = end < 0 ? pl->num_entries : MPMIN(end, pl->num_entries);
+    return e ? e->tree_size : 0;
+}
+
+// Recompute e's size, and make e the parent of its children.
+static struct playlist_entry *tree_update(struct playlist_entry *e)
+{
+    e->tree_size = 1;
+    for (int n = 0; n < 2; n++) {
+        struct playlist_entry *c = e->tree_child[n];
+        if (c) {
+            c->tree_parent = e;
+            e->tree_size += c->tree_size;
+        }
+    }
+    return e;
+}
+
+static void tree_set_root(struct playlist *pl, struct playlist_entry *root)
+{
+    pl->tree_root = root;
+    if (root)
+        root->tree_parent = NULL;
+}
+
+// Concatenate the trees a and b.
+static struct playlist_entry *tree_merge(struct playlist_entry *a,
+                                         struct playlist_entry *b)
+{
+    if (!a || !b)
+        return a ? a : b;
+    if (a->tree_prio >= b->tree_prio) {
+        a->tree_child[1] = tree_merge(a->tree_child[1], b);
+        return tree_update(a);
+    }
+    b->tree_child[0] = tree_merge(a, b->tree_child[0]);
+    return tree_update(b);
+}
+
+// Split t into the first index entries (*a) and the rest (*b).
+static void tree_split(struct playlist_entry *t, int index,
+                       struct playlist_entry **a, struct playlist_entry **b)
+{
+    if (!t) {
+        *a = *b = NULL;
+        return;
+    }
+    int left = tree_size(t->tree_child[0]);
+    if (index <= left) {
+        tree_split(t->tree_child[0], index, a, &t->tree_child[0]);
+        *b = tree_update(t);
+    } else {
+        tree_split(t->tree_child[1], index - left - 1, &t->tree_child[1], b);
+        *a = tree_update(t);
+    }
+}
+
+// Insert the tree t (a single entry, or all entries of another playlist) so
+// that its first entry gets the given index.
+static void tree_insert(struct playlist *pl, int index, struct playlist_entry *t)
+{
+    struct playlist_entry *a, *b;
+    tree_split(pl->tree_root, index, &a, &b);
+    tree_set_root(pl, tree_merge(tree_merge(a, t), b));
+}
+
+static void tree_remove(struct playlist *pl, struct playlist_entry *e)
+{
+    struct playlist_entry *parent = e->tree_parent;
+    struct playlist_entry *sub = tree_merge(e->tree_child[0], e->tree_child[1]);
+    if (parent) {
+        parent->tree_child[parent->tree_child[1] == e] = sub;
+        if (sub)
+            sub->tree_parent = parent;
+        for (struct playlist_entry *p = parent; p; p = p->tree_parent)
+            p->tree_size--;
+    } else {
+        tree_set_root(pl, sub);
+    }
+    e->tree_parent = e->tree_child[0] = e->tree_child[1] = NULL;
+    e->tree_size = 0;
+}
 
-    for (int n = start; n < end; n++)
-        pl->entries[n]->pl_index = n;
+// Return the entry before (direction=-1) or after (direction=+1) e. This is
+// amortized O(1) when iterating over the whole list.
+static struct playlist_entry *tree_step(struct playlist_entry *e, int direction)
+{
+    int d = direction > 0;
+    if (e->tree_child[d]) {
+        e = e->tree_child[d];
+        while (e->tree_child[!d])
+            e = e->tree_child[!d];
+        return e;
+    }
+    while (e->tree_parent && e->tree_parent->tree_child[d] == e)
+        e = e->tree_parent;
+    return e->tree_parent;
+}
+
+static struct playlist_entry *tree_end(struct playlist_entry *e, int direction)
+{
+    while (e && e->tree_child[direction > 0])
+        e = e->tree_child[direction > 0];
+    return e;
+}
+
+static int tree_fix_sizes(struct playlist_entry *e)
+{
+    if (!e)
+        return 0;
+    e->tree_size = 1 + tree_fix_sizes(e->tree_child[0]) +
+                   tree_fix_sizes(e->tree_child[1]);
+    return e->tree_size;
+}
+
+// Build a tree from the given list of entries in O(n). This builds the treap
+// directly, by keeping track of the right spine while appending.
+static struct playlist_entry *tree_build(struct playlist_entry **list, int num)
+{
+    struct playlist_entry *root = NULL, *last = NULL;
+    for (int n = 0; n < num; n++) {
+        struct playlist_entry *e = list[n];
+        struct playlist_entry *parent = last, *left = NULL;
+        while (parent && parent->tree_prio < e->tree_prio) {
+            left = parent;
+            parent = parent->tree_parent;
+        }
+        e->tree_child[0] = left;
+        e->tree_child[1] = NULL;
+        if (left)
+            left->tree_parent = e;
+        e->tree_parent = parent;
+        if (parent) {
+            parent->tree_child[1] = e;
+        } else {
+            root = e;
+        }
+        last = e;
+    }
+    tree_fix_sizes(root);
+    return root;
+}
+
+// Replace the tree with the given list of entries.
+static void tree_rebuild(struct playlist *pl, struct playlist_entry **list,
+                         int num)
+{
+    tree_set_root(pl, tree_build(list, num));
+}
+
+// Return all entries in order. Free with talloc_free().
+static struct playlist_entry **tree_to_list(struct playlist *pl)
+{
+    struct playlist_entry **list =
+        talloc_array(NULL, struct playlist_entry *, pl->num_entries);
+    int num = 0;
+    for (struct playlist_entry *e = tree_end(pl->tree_root, -1); e;
+         e = tree_step(e, 1))
+        list[num++] = e;
+    assert(num == pl->num_entries);
+    return list;
+}
+
+// Entries are inserted with sequential IDs, so use a mixing function
+// (splitmix64's finalizer) to get random looking priorities from them.
+static uint32_t tree_prio_from_id(uint64_t id)
+{
+    id = (id ^ (id >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    id = (id ^ (id >> 27)) * 0x94d049bb133111ebULL;
+    return (uint32_t)(id ^ (id >> 31));
+}
+
+// Number of change records kept for playlist_get_changes(). Consecutive inserts
+// and removes are merged into a single record.
+#define MAX_PLAYLIST_CHANGES 64
+
+static void copy_change_entries(struct playlist_change *c,
+                                struct playlist_entry *e, int count)
+{
+    int num = c->count - count;
+    MP_TARRAY_GROW(c, c->entries, c->count);
+    for (int n = 0; n < count; n++, e = tree_step(e, 1)) {
+        c->entries[num + n] = (struct playlist_change_entry){
+            .id = e->id,
+            .filename = talloc_strdup(c, e->filename),
+            .title = talloc_strdup(c, e->title),
+            .playlist_path = talloc_strdup(c, e->playlist_path),
+        };
+    }
+}
+
+// first is the first of the count entries for PLAYLIST_CHANGE_INSERT and
+// PLAYLIST_CHANGE_UPDATE.
+static void add_change(struct playlist *pl, enum playlist_change_op op,
+                       int index, int count, int to,
+                       struct playlist_entry *first)
+{
+    pl->generation++;
+    if (!pl->track_changes)
+        return;
+
+    struct playlist_change *last =
+        pl->num_changes ? pl->changes[pl->num_changes - 1] : NULL;
+    if (last && last->generation == pl->changes_read)
+        last = NULL;
+
+    if (last && last->op == op && op == PLAYLIST_CHANGE_INSERT &&
+        index == last->index + last->count)
+    {
+        last->generation = pl->generation;
+        last->count += count;
+        copy_change_entries(last, first, count);
+        return;
+    }
+
+    // Removing the entries right before or after the removed range (e.g.
+    // playlist_clear()).
+    if (last && last->op == op && op == PLAYLIST_CHANGE_REMOVE &&
+        (index == last->index || index + count == last->index))
+    {
+        last->generation = pl->generation;
+        last->index = MPMIN(last->index, index);
+        last->count += count;
+        return;
+    }
+
+    // Nobody can apply the older changes after a reset, so clients asking for
+    // them will have to read the whole playlist.
+    if (op == PLAYLIST_CHANGE_RESET) {
+        for (int n = 0; n < pl->num_changes; n++)
+            talloc_free(pl->changes[n]);
+        pl->num_changes = 0;
+        return;
+    }
+
+    if (pl->num_changes == MAX_PLAYLIST_CHANGES) {
+        talloc_free(pl->changes[0]);
+        MP_TARRAY_REMOVE_AT(pl->changes, pl->num_changes, 0);
+    }
+
+    struct playlist_change *c = talloc_ptrtype(pl, c);
+    *c = (struct playlist_change){
+        .start_generation = pl->generation - 1,
+        .generation = pl->generation,
+        .op = op,
+        .index = index,
+        .count = count,
+        .to = to,
+    };
+    if (op == PLAYLIST_CHANGE_INSERT || op == PLAYLIST_CHANGE_UPDATE)
+        copy_change_entries(c, first, count);
+    MP_TARRAY_APPEND(pl, pl->changes, pl->num_changes, c);
+}
+
+// Record that the metadata (e.g. title) of the entry changed.
+void playlist_entry_changed(struct playlist *pl, struct playlist_entry *e)
+{
+    assert(e->pl == pl);
+    add_change(pl, PLAYLIST_CHANGE_UPDATE, playlist_entry_to_index(pl, e), 1, 0,
+               e);
+}
+
+// Return the changes made after the playlist had the given generation, oldest
+// first. The returned records are owned by the playlist and are valid until
+// the next change. Return false if they are not available, because the
+// generation is too old, or because changes were not tracked yet. The caller
+// then has to read the whole playlist.
+bool playlist_get_changes(struct playlist *pl, uint64_t since,
+                          struct playlist_change ***changes, int *num_changes)
+{
+    *changes = NULL;
+    *num_changes = 0;
+
+    bool was_tracking = pl->track_changes;
+    pl->track_changes = true;
+    pl->changes_read = pl->generation;
+
+    if (since == pl->generation)
+        return true;
+    if (!was_tracking || since > pl->generation)
+        return false;
+
+    for (int n = 0; n < pl->num_changes; n++) {
+        struct playlist_change *c = pl->changes[n];
+        if (c->start_generation == since) {
+            *changes = &pl->changes[n];
+            *num_changes = pl->num_changes - n;
+            return true;
+        }
+        // In the middle of merged changes, or older than the oldest change.
+        if (c->start_generation > since || c->generation > since)
+            return false;
+    }
+    return false;
 }
 
 // Inserts the entry so that it takes "at"'s place, shifting "at" and all
@@ -68,16 +356,19 @@ void playlist_insert_at(struct playlist *pl, struct playlist_entry *add,
     assert(add->filename);
     assert(!at || at->pl == pl);
 
-    int index = at ? at->pl_index : pl->num_entries;
-    MP_TARRAY_INSERT_AT(pl, pl->entries, pl->num_entries, index, add);
+    int index = at ? playlist_entry_to_index(pl, at) : pl->num_entries;
 
     add->pl = pl;
-    add->pl_index = index;
     add->id = ++pl->id_alloc;
-
-    playlist_update_indexes(pl, index, pl->num_entries);
+    add->tree_prio = tree_prio_from_id(add->id);
+    add->tree_parent = add->tree_child[0] = add->tree_child[1] = NULL;
+    add->tree_size = 1;
+    tree_insert(pl, index, add);
+    pl->num_entries++;
 
     talloc_steal(pl, add);
+
+    add_change(pl, PLAYLIST_CHANGE_INSERT, index, 1, 0, add);
 }
 
 void playlist_entry_unref(struct playlist_entry *e)
@@ -98,11 +389,13 @@ void playlist_remove(struct playlist *pl, struct playlist_entry *entry)
         pl->current_was_replaced = true;
     }
 
-    MP_TARRAY_REMOVE_AT(pl->entries, pl->num_entries, entry->pl_index);
-    playlist_update_indexes(pl, entry->pl_index, -1);
+    add_change(pl, PLAYLIST_CHANGE_REMOVE, playlist_entry_to_index(pl, entry),
+               1, 0, NULL);
+
+    tree_remove(pl, entry);
+    pl->num_entries--;
 
     entry->pl = NULL;
-    entry->pl_index = -1;
     ta_set_parent(entry, NULL);
 
     entry->removed = true;
@@ -111,8 +404,8 @@ void playlist_remove(struct playlist *pl, struct playlist_entry *entry)
 
 void playlist_clear(struct playlist *pl)
 {
-    for (int n = pl->num_entries - 1; n >= 0; n--)
-        playlist_remove(pl, pl->entries[n]);
+    while (pl->num_entries)
+        playlist_remove(pl, playlist_get_last(pl));
     assert(!pl->current);
     pl->current_was_replaced = false;
     pl->playlist_completed = false;
@@ -122,9 +415,12 @@ void playlist_clear(struct playlist *pl)
 
 void playlist_clear_except_current(struct playlist *pl)
 {
-    for (int n = pl->num_entries - 1; n >= 0; n--) {
-        if (pl->entries[n] != pl->current)
-            playlist_remove(pl, pl->entries[n]);
+    struct playlist_entry *e = playlist_get_last(pl);
+    while (e) {
+        struct playlist_entry *prev = playlist_entry_get_rel(e, -1);
+        if (e != pl->current)
+            playlist_remove(pl, e);
+        e = prev;
     }
     pl->playlist_completed = false;
     pl->playlist_started = false;
@@ -140,16 +436,14 @@ void playlist_move(struct playlist *pl, struct playlist_entry *entry,
     assert(entry && entry->pl == pl);
     assert(!at || at->pl == pl);
 
-    int index = at ? at->pl_index : pl->num_entries;
-    MP_TARRAY_INSERT_AT(pl, pl->entries, pl->num_entries, index, entry);
+    int old_index = playlist_entry_to_index(pl, entry);
+    tree_remove(pl, entry);
 
-    int old_index = entry->pl_index;
-    if (old_index >= index)
-        old_index += 1;
-    MP_TARRAY_REMOVE_AT(pl->entries, pl->num_entries, old_index);
+    int index = at ? playlist_entry_to_index(pl, at) : pl->num_entries - 1;
+    entry->tree_size = 1;
+    tree_insert(pl, index, entry);
 
-    playlist_update_indexes(pl, MPMIN(index - 1, old_index - 1),
-                                MPMAX(index + 1, old_index + 1));
+    add_change(pl, PLAYLIST_CHANGE_MOVE, old_index, 1, index, NULL);
 }
 
 void playlist_append_file(struct playlist *pl, const char *filename)
@@ -160,61 +454,77 @@ void playlist_append_file(struct playlist *pl, const char *filename)
 void playlist_populate_playlist_path(struct playlist *pl, const char *path)
 {
     char *playlist_path = talloc_strdup(pl, path);
-    for (int n = 0; n < pl->num_entries; n++) {
-        struct playlist_entry *e = pl->entries[n];
+    for (struct playlist_entry *e = playlist_get_first(pl); e; e = tree_step(e, 1))
         e->playlist_path = playlist_path;
-    }
 }
 
 void playlist_shuffle(struct playlist *pl)
 {
+    struct playlist_entry **list = tree_to_list(pl);
     for (int n = 0; n < pl->num_entries; n++)
-        pl->entries[n]->original_index = n;
+        list[n]->original_index = n;
     for (int n = 0; n < pl->num_entries - 1; n++) {
         size_t j = (size_t)((pl->num_entries - n) * mp_rand_next_double());
-        MPSWAP(struct playlist_entry *, pl->entries[n], pl->entries[n + j]);
+        MPSWAP(struct playlist_entry *, list[n], list[n + j]);
     }
-    playlist_update_indexes(pl, 0, -1);
+    tree_rebuild(pl, list, pl->num_entries);
+    talloc_free(list);
+    add_change(pl, PLAYLIST_CHANGE_RESET, 0, 0, 0, NULL);
 }
 
 #define CMP_INT(a, b) ((a) == (b) ? 0 : ((a) > (b) ? 1 : -1))
 
+struct unshuffle_item {
+    struct playlist_entry *e;
+    int index;
+};
+
 static int cmp_unshuffle(const void *a, const void *b)
 {
-    struct playlist_entry *ea = *(struct playlist_entry **)a;
-    struct playlist_entry *eb = *(struct playlist_entry **)b;
+    const struct unshuffle_item *ia = a;
+    const struct unshuffle_item *ib = b;
 
-    if (ea->original_index >= 0 && ea->original_index != eb->original_index)
-        return CMP_INT(ea->original_index, eb->original_index);
-    return CMP_INT(ea->pl_index, eb->pl_index);
+    if (ia->e->original_index >= 0 &&
+        ia->e->original_index != ib->e->original_index)
+        return CMP_INT(ia->e->original_index, ib->e->original_index);
+    return CMP_INT(ia->index, ib->index);
 }
 
 void playlist_unshuffle(struct playlist *pl)
 {
+    struct playlist_entry **list = tree_to_list(pl);
+    struct unshuffle_item *items =
+        talloc_array(list, struct unshuffle_item, pl->num_entries);
+    for (int n = 0; n < pl->num_entries; n++)
+        items[n] = (struct unshuffle_item){list[n], n};
     if (pl->num_entries)
-        qsort(pl->entries, pl->num_entries, sizeof(pl->entries[0]), cmp_unshuffle);
-    playlist_update_indexes(pl, 0, -1);
+        qsort(items, pl->num_entries, sizeof(items[0]), cmp_unshuffle);
+    for (int n = 0; n < pl->num_entries; n++)
+        list[n] = items[n].e;
+    tree_rebuild(pl, list, pl->num_entries);
+    talloc_free(list);
+    add_change(pl, PLAYLIST_CHANGE_RESET, 0, 0, 0, NULL);
 }
 
 // (Explicitly ignores current_was_replaced.)
 struct playlist_entry *playlist_get_first(struct playlist *pl)
 {
-    return pl->num_entries ? pl->entries[0] : NULL;
+    return tree_end(pl->tree_root, -1);
 }
 
 // (Explicitly ignores current_was_replaced.)
 struct playlist_entry *playlist_get_last(struct playlist *pl)
 {
-    return pl->num_entries ? pl->entries[pl->num_entries - 1] : NULL;
+    return tree_end(pl->tree_root, 1);
 }
 
 struct playlist_entry *playlist_get_next(struct playlist *pl, int direction)
 {
     assert(direction == -1 || direction == +1);
     if (!pl->current && pl->playlist_completed && direction < 0) {
-        return playlist_entry_from_index(pl, pl->num_entries - 1);
+        return playlist_get_last(pl);
     } else if (!pl->current && !pl->playlist_started && direction > 0) {
-        return playlist_entry_from_index(pl, 0);
+        return playlist_get_first(pl);
     } else if (!pl->current) {
         return NULL;
     }
@@ -232,7 +542,7 @@ struct playlist_entry *playlist_entry_get_rel(struct playlist_entry *e,
     assert(direction == -1 || direction == +1);
     if (!e->pl)
         return NULL;
-    return playlist_entry_from_index(e->pl, e->pl_index + direction);
+    return tree_step(e, direction);
 }
 
 struct playlist_entry *playlist_get_first_in_next_playlist(struct playlist *pl,
@@ -307,8 +617,7 @@ void playlist_add_base_path(struct playlist *pl, bstr base_path)
 {
     if (base_path.len == 0 || bstrcmp0(base_path, ".") == 0)
         return;
-    for (int n = 0; n < pl->num_entries; n++) {
-        struct playlist_entry *e = pl->entries[n];
+    for (struct playlist_entry *e = playlist_get_first(pl); e; e = tree_step(e, 1)) {
         if (!mp_is_url(bstr0(e->filename))) {
             char *new_file = mp_path_join_bstr(e, base_path, bstr0(e->filename));
             talloc_free(e->filename);
@@ -319,8 +628,8 @@ void playlist_add_base_path(struct playlist *pl, bstr base_path)
 
 void playlist_set_stream_flags(struct playlist *pl, int flags)
 {
-    for (int n = 0; n < pl->num_entries; n++)
-        pl->entries[n]->stream_flags = flags;
+    for (struct playlist_entry *e = playlist_get_first(pl); e; e = tree_step(e, 1))
+        e->stream_flags = flags;
 }
 
 int64_t playlist_transfer_entries_to(struct playlist *pl, int dst_index,
@@ -330,21 +639,26 @@ int64_t playlist_transfer_entries_to(struct playlist *pl, int dst_index,
     struct playlist_entry *first = playlist_get_first(source_pl);
 
     int count = source_pl->num_entries;
-    MP_TARRAY_INSERT_N_AT(pl, pl->entries, pl->num_entries, dst_index, count);
 
+    // The priorities follow the new IDs, so the entries need a new tree.
+    struct playlist_entry **list = tree_to_list(source_pl);
     for (int n = 0; n < count; n++) {
-        struct playlist_entry *e = source_pl->entries[n];
+        struct playlist_entry *e = list[n];
         e->pl = pl;
-        e->pl_index = dst_index + n;
         e->id = ++pl->id_alloc;
-        pl->entries[e->pl_index] = e;
+        e->tree_prio = tree_prio_from_id(e->id);
         talloc_steal(pl, e);
         talloc_steal(pl, e->playlist_path);
     }
-
-    playlist_update_indexes(pl, dst_index + count, -1);
+    tree_insert(pl, dst_index, tree_build(list, count));
+    talloc_free(list);
+    pl->num_entries += count;
+    source_pl->tree_root = NULL;
     source_pl->num_entries = 0;
 
+    if (count)
+        add_change(pl, PLAYLIST_CHANGE_INSERT, dst_index, count, 0, first);
+
     pl->playlist_completed = source_pl->playlist_completed;
     pl->playlist_started = source_pl->playlist_started;
 
@@ -361,7 +675,7 @@ int64_t playlist_transfer_entries(struct playlist *pl, struct playlist *source_p
 
     int add_at = pl->num_entries;
     if (pl->current) {
-        add_at = pl->current->pl_index + 1;
+        add_at = playlist_entry_to_index(pl, pl->current) + 1;
         if (pl->current_was_replaced)
             add_at += 1;
     }
@@ -382,7 +696,12 @@ int playlist_entry_to_index(struct playlist *pl, struct playlist_entry *e)
 {
     if (!e || e->pl != pl)
         return -1;
-    return e->pl_index;
+    int index = tree_size(e->tree_child[0]);
+    for (; e->tree_parent; e = e->tree_parent) {
+        if (e->tree_parent->tree_child[1] == e)
+            index += tree_size(e->tree_parent->tree_child[0]) + 1;
+    }
+    return index;
 }
 
 int playlist_entry_count(struct playlist *pl)
@@ -394,7 +713,21 @@ int playlist_entry_count(struct playlist *pl)
 // Return NULL if not found.
 struct playlist_entry *playlist_entry_from_index(struct playlist *pl, int index)
 {
-    return index >= 0 && index < pl->num_entries ? pl->entries[index] : NULL;
+    if (index < 0 || index >= pl->num_entries)
+        return NULL;
+    struct playlist_entry *e = pl->tree_root;
+    while (e) {
+        int left = tree_size(e->tree_child[0]);
+        if (index == left)
+            break;
+        if (index < left) {
+            e = e->tree_child[0];
+        } else {
+            index -= left + 1;
+            e = e->tree_child[1];
+        }
+    }
+    return e;
 }
 
 struct playlist *playlist_parse_file(const char *file, struct mp_cancel *cancel,
@@ -443,17 +776,17 @@ void playlist_set_current(struct playlist *pl)
     if (!pl->playlist_dir)
         return;
 
-    for (int i = 0; i < pl->num_entries; ++i) {
-        if (!pl->entries[i]->playlist_path)
+    for (struct playlist_entry *e = playlist_get_first(pl); e; e = tree_step(e, 1)) {
+        if (!e->playlist_path)
             continue;
-        char *path = pl->entries[i]->playlist_path;
+        char *path = e->playlist_path;
         if (path[0] != '.')
-            path = mp_path_join(NULL, pl->playlist_dir, mp_basename(pl->entries[i]->playlist_path));
-        bool same = !strcmp(pl->entries[i]->filename, path);
-        if (path != pl->entries[i]->playlist_path)
+            path = mp_path_join(NULL, pl->playlist_dir, mp_basename(e->playlist_path));
+        bool same = !strcmp(e->filename, path);
+        if (path != e->playlist_path)
             talloc_free(path);
         if (same) {
-            pl->current = pl->entries[i];
+            pl->current = e;
             break;
         }
     }
@@ -26,9 +26,14 @@ struct playlist_param {
 };
 
 struct playlist_entry {
-    // Invariant: (pl && pl->entries[pl_index] == this) || (!pl && pl_index < 0)
     struct playlist *pl;
-    int pl_index;
+
+    // Node in pl's order statistic tree (a treap keyed by list position).
+    // Only valid if pl is set. Use playlist_entry_to_index() to get the index.
+    struct playlist_entry *tree_parent;
+    struct playlist_entry *tree_child[2];   // left, right
+    int tree_size;                          // number of entries in this subtree
+    uint32_t tree_prio;
 
     uint64_t id;
 
@@ -40,7 +45,7 @@ struct playlist_entry {
 
     char *title;
 
-    // Used for unshuffling: the pl_index before it was shuffled. -1 => unknown.
+    // Used for unshuffling: the index before it was shuffled. -1 => unknown.
     int original_index;
 
     // Set to true if this playlist entry was selected while trying to go backwards
@@ -61,10 +66,52 @@ struct playlist_entry {
     int stream_flags;
 };
 
+enum playlist_change_op {
+    PLAYLIST_CHANGE_INSERT, // count entries inserted at index
+    PLAYLIST_CHANGE_REMOVE, // count entries removed at index
+    PLAYLIST_CHANGE_MOVE,   // entry at index moved, it's now at index "to"
+    PLAYLIST_CHANGE_UPDATE, // metadata of count entries at index changed
+    PLAYLIST_CHANGE_RESET,  // anything could have changed (e.g. shuffle); this
+                            // is never returned, older changes are dropped
+};
+
+// Copy of the entry data at the time of the change.
+struct playlist_change_entry {
+    uint64_t id;
+    char *filename;
+    char *title;
+    char *playlist_path;
+};
+
+struct playlist_change {
+    uint64_t start_generation;  // playlist generation before the change
+    uint64_t generation;        // playlist generation after the change
+    enum playlist_change_op op;
+    int index;
+    int count;
+    int to;
+    // For PLAYLIST_CHANGE_INSERT and PLAYLIST_CHANGE_UPDATE: the count entries.
+    struct playlist_change_entry *entries;
+};
+
 struct playlist {
-    struct playlist_entry **entries;
+    // Root of the tree of all entries. Inserting, removing, and looking up
+    // entries by index are O(log n). Use playlist_get_first() and
+    // playlist_entry_get_rel() to iterate the entries in order.
+    struct playlist_entry *tree_root;
     int num_entries;
 
+    // Incremented on every change to the entries.
+    uint64_t generation;
+    // Most recent changes, oldest first. Only recorded after the first call to
+    // playlist_get_changes().
+    bool track_changes;
+    struct playlist_change **changes;
+    int num_changes;
+    // Generation at the last playlist_get_changes() call. The change record
+    // ending there must not be merged with newer changes.
+    uint64_t changes_read;
+
     // This provides some sort of stable iterator. If this entry is removed from
     // the playlist, current is set to the next element (or NULL), and
     // current_was_replaced is set to true.
@@ -127,4 +174,8 @@ void playlist_entry_unref(struct playlist_entry *e);
 
 void playlist_set_current(struct playlist *pl);
 
+void playlist_entry_changed(struct playlist *pl, struct playlist_entry *e);
+bool playlist_get_changes(struct playlist *pl, uint64_t since,
+                          struct playlist_change ***changes, int *num_changes);
+
 #endif
@@ -1,4 +1,6 @@
+#include <math.h>
 #include <stdatomic.h>
+#include <stdio.h>
 #include <time.h>
 
 #include "common.h"
@@ -11,13 +13,59 @@
 #include "osdep/timer.h"
 #include "stats.h"
 
+// Log-linear latency histogram: values below HIST_SUB are counted exactly,
+// larger values with HIST_SUB sub-buckets per power of 2 (12.5% precision).
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+// Number of per-thread accumulation slots for stats_handle.
+#define HANDLE_SHARDS 8
+
+#define TRACE_BUFFER_SIZE 4096
+// Must be a power of 2.
+#define TRACE_RING_SIZE 8192
+
+struct trace_event {
+    int64_t time_ns;
+    double pts;
+    int tid;
+    char cat[8];
+    char name[32];
+    char ctx[24];
+};
+
+// Slot of the lock-free multi-producer ring the events are recorded into.
+// seq == write position + 1 if the slot contains an event, and
+// read position + TRACE_RING_SIZE once it has been consumed.
+struct trace_slot {
+    atomic_uint_least64_t seq;
+    struct trace_event ev;
+};
+
 struct stats_base {
     struct mpv_global *global;
 
     atomic_bool active;
+    atomic_bool trace_active;
 
     mp_mutex lock;
 
+    // Frame tracing. Events are recorded into trace_ring without locking, and
+    // moved out of it by stats_trace_flush(). They go to trace_file if set,
+    // and are kept in trace_events for the trace-events property once it was
+    // queried.
+    struct trace_slot *trace_ring;  // allocated on first use, never freed
+    atomic_uint_least64_t trace_write;
+    atomic_int_least64_t trace_dropped;
+    uint64_t trace_read;            // protected by lock
+    FILE *trace_file;
+    char *trace_path;
+    bool trace_first;
+    bool trace_buffered;
+    struct trace_event *trace_events;
+    int trace_first_event, trace_num_events;
+
     struct {
         struct stats_ctx *head, *tail;
     } list;
@@ -47,6 +95,29 @@ enum val_type {
     VAL_INC,
     VAL_TIME,
     VAL_THREAD_CPU_TIME,
+    VAL_HANDLE,
+};
+
+struct stats_hist {
+    uint64_t buckets[HIST_BUCKETS];
+    uint64_t count;
+    int64_t max;
+};
+
+// Written lock-free by the threads that map to it, read and reset on query.
+struct stats_shard {
+    atomic_int_least64_t count;
+    atomic_int_least64_t val_rt;
+    atomic_int_least64_t val_th;
+    atomic_int_least64_t max;
+    atomic_uint_least32_t hist[HIST_BUCKETS];
+};
+
+struct stats_handle {
+    struct stats_ctx *ctx;
+    struct stat_entry *entry;
+    atomic_bool is_timer;
+    struct stats_shard shards[HANDLE_SHARDS];
 };
 
 struct stat_entry {
@@ -60,6 +131,8 @@ struct stat_entry {
     int64_t time_start_ns;
     int64_t cpu_start_ns;
     mp_thread_id thread_id;
+    struct stats_hist *hist; // VAL_TIME only, allocated on first use
+    struct stats_handle *handle; // VAL_HANDLE only
 };
 
 #define IS_ACTIVE(ctx) \
@@ -72,6 +145,7 @@ static void stats_destroy(void *p)
     // All entries must have been destroyed before this.
     assert(!stats->list.head);
 
+    stats_set_trace_file(stats->global, NULL);
     mp_mutex_destroy(&stats->lock);
 }
 
@@ -98,6 +172,98 @@ static void add_stat(struct mpv_node *list, struct stat_entry *e,
         node_map_add_string(ne, "text", text);
 }
 
+static int hist_bucket(uint64_t v)
+{
+    if (v < HIST_SUB)
+        return v;
+    int e = 63 - __builtin_clzll(v);
+    int m = (v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1);
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + m;
+}
+
+// Midpoint of the value range covered by the bucket.
+static uint64_t hist_bucket_value(int b)
+{
+    if (b < HIST_SUB)
+        return b;
+    int e = b / HIST_SUB - 1 + HIST_SUB_BITS;
+    uint64_t low = (uint64_t)(HIST_SUB + b % HIST_SUB) << (e - HIST_SUB_BITS);
+    return low + ((UINT64_C(1) << (e - HIST_SUB_BITS)) >> 1);
+}
+
+static void hist_add(struct stats_hist *h, int64_t v)
+{
+    v = MPMAX(v, 0);
+    h->buckets[hist_bucket(v)] += 1;
+    h->count += 1;
+    h->max = MPMAX(h->max, v);
+}
+
+static int64_t hist_percentile(struct stats_hist *h, double q)
+{
+    uint64_t target = MPMAX(ceil(h->count * q), 1);
+    uint64_t sum = 0;
+    for (int n = 0; n < HIST_BUCKETS; n++) {
+        sum += h->buckets[n];
+        if (sum >= target)
+            return MPMIN(hist_bucket_value(n), h->max);
+    }
+    return h->max;
+}
+
+static void add_time_stats(struct mpv_node *list, struct stat_entry *e,
+                           int64_t rt, int64_t th, struct stats_hist *h)
+{
+    double t_cpu = MP_TIME_NS_TO_MS(th);
+    add_stat(list, e, "cpu", t_cpu, mp_tprintf(80, "%.2f ms", t_cpu));
+    double t_rt = MP_TIME_NS_TO_MS(rt);
+    add_stat(list, e, "time", t_rt, mp_tprintf(80, "%.2f ms", t_rt));
+    if (h && h->count) {
+        static const struct { const char *name; double q; } pcts[] = {
+            {"p50", 0.50}, {"p99", 0.99},
+        };
+        for (int n = 0; n < MP_ARRAY_SIZE(pcts); n++) {
+            double t = MP_TIME_NS_TO_MS(hist_percentile(h, pcts[n].q));
+            add_stat(list, e, pcts[n].name, t, mp_tprintf(80, "%.3f ms", t));
+        }
+        double t_max = MP_TIME_NS_TO_MS(h->max);
+        add_stat(list, e, "max", t_max, mp_tprintf(80, "%.3f ms", t_max));
+    }
+}
+
+// Merge the per-thread data of a handle into *h (the count into h->count),
+// *rt and *th, and reset it.
+static void drain_handle(struct stats_handle *handle, struct stats_hist *h,
+                         int64_t *rt, int64_t *th)
+{
+    for (int n = 0; n < HANDLE_SHARDS; n++) {
+        struct stats_shard *sh = &handle->shards[n];
+        h->count += atomic_exchange(&sh->count, 0);
+        *rt += atomic_exchange(&sh->val_rt, 0);
+        *th += atomic_exchange(&sh->val_th, 0);
+        int64_t max = atomic_exchange(&sh->max, 0);
+        h->max = MPMAX(h->max, max);
+        for (int b = 0; b < HIST_BUCKETS; b++) {
+            if (atomic_load_explicit(&sh->hist[b], memory_order_relaxed))
+                h->buckets[b] += atomic_exchange(&sh->hist[b], 0);
+        }
+    }
+}
+
+static void add_handle_stats(struct mpv_node *list, struct stat_entry *e)
+{
+    struct stats_handle *handle = e->handle;
+    int64_t rt = 0, th = 0;
+    struct stats_hist h = {0};
+    drain_handle(handle, &h, &rt, &th);
+
+    if (atomic_load(&handle->is_timer)) {
+        add_time_stats(list, e, rt, th, &h);
+    } else {
+        add_stat(list, e, NULL, h.count, NULL);
+    }
+}
+
 static int cmp_entry(const void *p1, const void *p2)
 {
     struct stat_entry **e1 = (void *)p1;
@@ -128,7 +294,7 @@ void stats_global_query(struct mpv_global *global, struct mpv_node *out)
         }
     }
 
-    node_init(out, MPV_FORMAT_NODE_ARRAY, NULL);
+    node_init_arena(out, MPV_FORMAT_NODE_ARRAY);
 
     int64_t now = mp_time_ns();
     if (stats->last_time) {
@@ -145,8 +311,17 @@ void stats_global_query(struct mpv_global *global, struct mpv_node *out)
                 struct stat_entry *e = stats->entries[n];
 
                 e->cpu_start_ns = 0;
+                e->val_d = 0;
                 e->val_rt = e->val_th = 0;
-                if (e->type != VAL_THREAD_CPU_TIME)
+                if (e->hist)
+                    *e->hist = (struct stats_hist){0};
+                if (e->handle) {
+                    // Drop what was accumulated while nobody was querying.
+                    struct stats_hist h = {0};
+                    int64_t rt = 0, th = 0;
+                    drain_handle(e->handle, &h, &rt, &th);
+                }
+                if (e->type != VAL_THREAD_CPU_TIME && e->type != VAL_HANDLE)
                     e->type = 0;
             }
         }
@@ -171,13 +346,15 @@ void stats_global_query(struct mpv_global *global, struct mpv_node *out)
             e->val_d = 0;
             break;
         case VAL_TIME: {
-            double t_cpu = MP_TIME_NS_TO_MS(e->val_th);
-            add_stat(out, e, "cpu", t_cpu, mp_tprintf(80, "%.2f ms", t_cpu));
-            double t_rt = MP_TIME_NS_TO_MS(e->val_rt);
-            add_stat(out, e, "time", t_rt, mp_tprintf(80, "%.2f ms", t_rt));
+            add_time_stats(out, e, e->val_rt, e->val_th, e->hist);
             e->val_rt = e->val_th = 0;
+            if (e->hist)
+                *e->hist = (struct stats_hist){0};
             break;
         }
+        case VAL_HANDLE:
+            add_handle_stats(out, e);
+            break;
         case VAL_THREAD_CPU_TIME: {
             int64_t t = mp_thread_cpu_time_ns(e->thread_id);
             if (!e->cpu_start_ns)
@@ -285,9 +462,13 @@ void stats_time_end(struct stats_ctx *ctx, const char *name)
     struct stat_entry *e = find_entry(ctx, name);
     if (e->time_start_ns) {
         e->type = VAL_TIME;
-        e->val_rt += mp_time_ns() - e->time_start_ns;
+        int64_t dt = mp_time_ns() - e->time_start_ns;
+        e->val_rt += dt;
         e->val_th += mp_thread_cpu_time_ns(mp_thread_current_id()) - e->cpu_start_ns;
         e->time_start_ns = 0;
+        if (!e->hist)
+            e->hist = talloc_zero(e, struct stats_hist);
+        hist_add(e->hist, dt);
     }
     mp_mutex_unlock(&ctx->base->lock);
 }
@@ -313,6 +494,69 @@ static void register_thread(struct stats_ctx *ctx, const char *name,
     mp_mutex_unlock(&ctx->base->lock);
 }
 
+struct stats_handle *stats_handle_create(struct stats_ctx *ctx,
+                                         const char *name)
+{
+    struct stats_handle *h = talloc_zero(ctx, struct stats_handle);
+    h->ctx = ctx;
+
+    mp_mutex_lock(&ctx->base->lock);
+    h->entry = find_entry(ctx, name);
+    h->entry->type = VAL_HANDLE;
+    h->entry->handle = h;
+    mp_mutex_unlock(&ctx->base->lock);
+
+    return h;
+}
+
+// Threads are distributed over the shards round-robin on first use.
+static struct stats_shard *get_shard(struct stats_handle *h)
+{
+    static atomic_uint next_shard;
+    static _Thread_local unsigned int shard; // index + 1, 0 if unassigned
+    if (!shard)
+        shard = atomic_fetch_add(&next_shard, 1) % HANDLE_SHARDS + 1;
+    return &h->shards[shard - 1];
+}
+
+void stats_handle_event(struct stats_handle *h)
+{
+    if (!IS_ACTIVE(h->ctx))
+        return;
+    atomic_fetch_add_explicit(&get_shard(h)->count, 1, memory_order_relaxed);
+}
+
+void stats_handle_time_start(struct stats_handle *h, struct stats_timer *t)
+{
+    *t = (struct stats_timer){0};
+    if (!IS_ACTIVE(h->ctx))
+        return;
+    t->cpu_start_ns = mp_thread_cpu_time_ns(mp_thread_current_id());
+    t->time_start_ns = mp_time_ns();
+}
+
+void stats_handle_time_end(struct stats_handle *h, struct stats_timer *t)
+{
+    if (!t->time_start_ns)
+        return;
+
+    int64_t dt = mp_time_ns() - t->time_start_ns;
+    int64_t dt_cpu = mp_thread_cpu_time_ns(mp_thread_current_id()) -
+                     t->cpu_start_ns;
+
+    struct stats_shard *sh = get_shard(h);
+    atomic_fetch_add_explicit(&sh->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sh->val_rt, dt, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sh->val_th, dt_cpu, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sh->hist[hist_bucket(MPMAX(dt, 0))], 1,
+                              memory_order_relaxed);
+    int_least64_t max = atomic_load_explicit(&sh->max, memory_order_relaxed);
+    while (dt > max && !atomic_compare_exchange_weak(&sh->max, &max, dt)) {}
+
+    if (!atomic_load_explicit(&h->is_timer, memory_order_relaxed))
+        atomic_store(&h->is_timer, true);
+}
+
 void stats_register_thread_cputime(struct stats_ctx *ctx, const char *name)
 {
     register_thread(ctx, name, VAL_THREAD_CPU_TIME);
@@ -322,3 +566,215 @@ void stats_unregister_thread(struct stats_ctx *ctx, const char *name)
 {
     register_thread(ctx, name, 0);
 }
+
+// Called locked.
+static void update_trace_active(struct stats_base *stats)
+{
+    bool active = stats->trace_file || stats->trace_buffered;
+    if (active && !stats->trace_ring) {
+        stats->trace_ring = talloc_array(stats, struct trace_slot, TRACE_RING_SIZE);
+        for (int n = 0; n < TRACE_RING_SIZE; n++)
+            atomic_init(&stats->trace_ring[n].seq, n);
+    }
+    // Publishes trace_ring to stats_trace_event(), which doesn't lock.
+    atomic_store_explicit(&stats->trace_active, active, memory_order_release);
+}
+
+// Called locked.
+static void write_trace_event(struct stats_base *stats, struct trace_event *ev)
+{
+    if (stats->trace_file) {
+        // Chrome trace event format, instant event with thread scope.
+        fprintf(stats->trace_file, "%s{\"name\":\"%s\",\"cat\":\"%s\","
+                "\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,"
+                "\"tid\":%d,\"args\":{\"pts\":%.6f,\"ctx\":\"%s\"}}",
+                stats->trace_first ? "" : ",\n", ev->name, ev->cat,
+                ev->time_ns / 1e3, ev->tid,
+                ev->pts == MP_NOPTS_VALUE ? -1.0 : ev->pts, ev->ctx);
+        stats->trace_first = false;
+    }
+
+    if (stats->trace_buffered) {
+        if (stats->trace_num_events == TRACE_BUFFER_SIZE) {
+            stats->trace_first_event =
+                (stats->trace_first_event + 1) % TRACE_BUFFER_SIZE;
+            stats->trace_num_events--;
+        }
+        int pos = (stats->trace_first_event + stats->trace_num_events++) %
+                  TRACE_BUFFER_SIZE;
+        stats->trace_events[pos] = *ev;
+    }
+}
+
+// Move all recorded events out of the ring. Called locked. Returns the number
+// of events that were dropped because the ring was full.
+static int64_t drain_trace_events(struct stats_base *stats)
+{
+    if (!stats->trace_ring)
+        return 0;
+    while (1) {
+        struct trace_slot *slot =
+            &stats->trace_ring[stats->trace_read % TRACE_RING_SIZE];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != stats->trace_read + 1)
+            break;
+        struct trace_event ev = slot->ev;
+        atomic_store_explicit(&slot->seq, stats->trace_read + TRACE_RING_SIZE,
+                              memory_order_release);
+        stats->trace_read++;
+        write_trace_event(stats, &ev);
+    }
+    return atomic_exchange(&stats->trace_dropped, 0);
+}
+
+static void report_dropped(struct stats_base *stats, int64_t dropped)
+{
+    if (dropped) {
+        mp_warn(stats->global->log, "%"PRId64" trace events were dropped.\n",
+                dropped);
+    }
+}
+
+void stats_trace_flush(struct mpv_global *global)
+{
+    struct stats_base *stats = global->stats;
+    if (!atomic_load_explicit(&stats->trace_active, memory_order_relaxed))
+        return;
+
+    mp_mutex_lock(&stats->lock);
+    int64_t dropped = drain_trace_events(stats);
+    if (stats->trace_file)
+        fflush(stats->trace_file);
+    mp_mutex_unlock(&stats->lock);
+
+    report_dropped(stats, dropped);
+}
+
+void stats_set_trace_file(struct mpv_global *global, const char *path)
+{
+    struct stats_base *stats = global->stats;
+    bool open_error = false;
+
+    mp_mutex_lock(&stats->lock);
+    if (!path || !path[0])
+        path = NULL;
+    if (!path == !stats->trace_path &&
+        (!path || strcmp(path, stats->trace_path) == 0))
+    {
+        mp_mutex_unlock(&stats->lock);
+        return;
+    }
+
+    int64_t dropped = drain_trace_events(stats);
+    if (stats->trace_file) {
+        fprintf(stats->trace_file, "\n]\n");
+        fclose(stats->trace_file);
+        stats->trace_file = NULL;
+    }
+    TA_FREEP(&stats->trace_path);
+    if (path) {
+        stats->trace_path = talloc_strdup(stats, path);
+        stats->trace_file = fopen(path, "wb");
+        open_error = !stats->trace_file;
+        if (stats->trace_file)
+            fprintf(stats->trace_file, "[\n");
+        stats->trace_first = true;
+    }
+    update_trace_active(stats);
+    mp_mutex_unlock(&stats->lock);
+
+    report_dropped(stats, dropped);
+    if (open_error)
+        mp_err(global->log, "Failed to open trace file '%s'\n", path);
+}
+
+// Map threads to small integers.
+static int get_trace_tid(void)
+{
+    static atomic_int num_threads;
+    static _Thread_local int tid;
+    if (!tid)
+        tid = atomic_fetch_add(&num_threads, 1) + 1;
+    return tid;
+}
+
+void stats_trace_event(struct stats_ctx *ctx, const char *cat,
+                       const char *name, double pts)
+{
+    struct stats_base *stats = ctx->base;
+    // Pairs with update_trace_active(): trace_ring is initialized if set.
+    if (!atomic_load_explicit(&stats->trace_active, memory_order_acquire))
+        return;
+
+    struct trace_event ev = {
+        .time_ns = mp_time_ns(),
+        .pts = pts,
+        .tid = get_trace_tid(),
+    };
+    snprintf(ev.cat, sizeof(ev.cat), "%s", cat);
+    snprintf(ev.name, sizeof(ev.name), "%s", name);
+    snprintf(ev.ctx, sizeof(ev.ctx), "%s", ctx->prefix);
+    for (char *c = ev.name; *c; c++) {
+        if (*c == '"' || *c == '\\' || (unsigned char)*c < 32)
+            *c = '_'; // keep the JSON output valid
+    }
+
+    // Reserve a slot. The ring is flushed by the core regularly; if it is
+    // full anyway, drop the event instead of waiting.
+    uint64_t pos = atomic_load_explicit(&stats->trace_write, memory_order_relaxed);
+    struct trace_slot *slot;
+    while (1) {
+        slot = &stats->trace_ring[pos % TRACE_RING_SIZE];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == pos) {
+            if (atomic_compare_exchange_weak_explicit(&stats->trace_write, &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (seq < pos) {
+            atomic_fetch_add_explicit(&stats->trace_dropped, 1,
+                                      memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&stats->trace_write, memory_order_relaxed);
+        }
+    }
+    slot->ev = ev;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+void stats_trace_query(struct mpv_global *global, struct mpv_node *out)
+{
+    struct stats_base *stats = global->stats;
+    assert(stats);
+
+    mp_mutex_lock(&stats->lock);
+
+    if (!stats->trace_buffered) {
+        stats->trace_events =
+            talloc_array(stats, struct trace_event, TRACE_BUFFER_SIZE);
+        stats->trace_buffered = true;
+        update_trace_active(stats);
+    }
+    int64_t dropped = drain_trace_events(stats);
+
+    node_init_arena(out, MPV_FORMAT_NODE_ARRAY);
+
+    for (int n = 0; n < stats->trace_num_events; n++) {
+        struct trace_event *ev =
+            &stats->trace_events[(stats->trace_first_event + n) % TRACE_BUFFER_SIZE];
+        struct mpv_node *ne = node_array_add(out, MPV_FORMAT_NODE_MAP);
+        node_map_add_string(ne, "name", ev->name);
+        node_map_add_string(ne, "cat", ev->cat);
+        node_map_add_double(ne, "time", MP_TIME_NS_TO_S(ev->time_ns));
+        node_map_add_int64(ne, "tid", ev->tid);
+        if (ev->pts != MP_NOPTS_VALUE)
+            node_map_add_double(ne, "pts", ev->pts);
+    }
+    stats->trace_first_event = stats->trace_num_events = 0;
+
+    mp_mutex_unlock(&stats->lock);
+
+    report_dropped(stats, dropped);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 struct mpv_global;
 struct mpv_node;
 struct stats_ctx;
@@ -18,13 +20,33 @@ void stats_value(struct stats_ctx *ctx, const char *name, double val);
 void stats_size_value(struct stats_ctx *ctx, const char *name, double val);
 
 // Report the real time and CPU time in seconds between _start and _end calls
-// as value, and report the average and number of all times.
+// as value, and report the median, 99th percentile and maximum of all times.
 void stats_time_start(struct stats_ctx *ctx, const char *name);
 void stats_time_end(struct stats_ctx *ctx, const char *name);
 
 // Display number of events per poll period.
 void stats_event(struct stats_ctx *ctx, const char *name);
 
+// Pre-registered entry for hot paths. Unlike the functions above, updates
+// through a handle neither take a lock nor look up the name, and can be done
+// from multiple threads concurrently; values are accumulated per thread and
+// merged when querying. The handle is freed with the stats_ctx.
+struct stats_handle *stats_handle_create(struct stats_ctx *ctx,
+                                         const char *name);
+
+// Like stats_event().
+void stats_handle_event(struct stats_handle *h);
+
+struct stats_timer {
+    int64_t time_start_ns;
+    int64_t cpu_start_ns;
+};
+
+// Like stats_time_start()/stats_time_end(), but the start time is kept in the
+// caller-provided *t.
+void stats_handle_time_start(struct stats_handle *h, struct stats_timer *t);
+void stats_handle_time_end(struct stats_handle *h, struct stats_timer *t);
+
 // Report the thread's CPU time. This needs to be called only once per thread.
 // The current thread is assumed to stay valid until the stats_ctx is destroyed
 // or stats_unregister_thread() is called, otherwise UB will occur.
@@ -32,3 +54,25 @@ void stats_register_thread_cputime(struct stats_ctx *ctx, const char *name);
 
 // Remove reference to the current thread.
 void stats_unregister_thread(struct stats_ctx *ctx, const char *name);
+
+// Frame tracing: record that a frame or packet with the given timestamp
+// passed the named pipeline stage. cat is the stream type ("video", "audio").
+// The timestamp is used to correlate events of the same frame across stages.
+// This does nothing unless tracing was enabled with stats_set_trace_file() or
+// stats_trace_query().
+// Events are recorded into a lock-free ring and written out by
+// stats_trace_flush(); this is cheap enough to call from any thread.
+void stats_trace_event(struct stats_ctx *ctx, const char *cat,
+                       const char *name, double pts);
+
+// Write out the events recorded since the last call. Called regularly by the
+// player core. Events are dropped if the ring fills up in between.
+void stats_trace_flush(struct mpv_global *global);
+
+// Write trace events as Chrome trace event JSON to the given file. NULL or ""
+// closes the current file.
+void stats_set_trace_file(struct mpv_global *global, const char *path);
+
+// Return and clear the buffered trace events. The first call enables
+// buffering.
+void stats_trace_query(struct mpv_global *global, struct mpv_node *out);
@@ -121,6 +121,10 @@ const struct m_sub_options demux_conf = {
         {"metadata-codepage", OPT_STRING(meta_cp)},
         {"autocreate-playlist", OPT_CHOICE(autocreate_playlist,
             {"no", 0}, {"filter", 1}, {"same", 2})},
+        {"demuxer-segment-preopen-secs", OPT_DOUBLE(segment_preopen_secs),
+            M_RANGE(0, DBL_MAX)},
+        {"demuxer-segment-max-open", OPT_INT(segment_max_open),
+            M_RANGE(0, 100)},
         {0}
     },
     .size = sizeof(struct demux_opts),
@@ -143,6 +147,8 @@ const struct m_sub_options demux_conf = {
             [STREAM_AUDIO] = 10,
         },
         .meta_cp = "auto",
+        .segment_preopen_secs = 5,
+        .segment_max_open = 2,
     },
     .get_sub_options = get_demux_sub_opts,
 };
@@ -2752,6 +2758,9 @@ static int dequeue_packet(struct demux_stream *ds, double min_pts,
         pkt->end = MP_ADD_PTS(pkt->end, in->ts_offset);
     }
 
+    stats_trace_event(in->stats, stream_type_name(ds->type), "demux-out",
+                      pkt->pts);
+
     prune_old_packets(in);
     *res = pkt;
     return 1;
@@ -87,6 +87,8 @@ struct demux_opts {
     char *meta_cp;
     bool force_retry_eof;
     int autocreate_playlist;
+    double segment_preopen_secs;
+    int segment_max_open;
 };
 
 #define SEEK_FACTOR   (1 << 1)      // argument is in range [0,1]
@@ -30,6 +30,9 @@
 #include "options/m_config.h"
 #include "options/path.h"
 #include "misc/ctype.h"
+#include "misc/thread_pool.h"
+#include "misc/thread_tools.h"
+#include "osdep/threads.h"
 
 #include "stream/stream.h"
 #include "demux.h"
@@ -38,6 +41,18 @@
 
 #define MF_MAX_FILE_SIZE (1024 * 1024 * 256)
 
+// Maximum number of files read ahead (and worker threads).
+#define MF_MAX_PREFETCH 16
+
+// A file being read by a worker thread.
+struct prefetch {
+    struct demuxer *demuxer;
+    int frame;
+    // --- protected by mf.lock
+    struct demux_packet *pkt;
+    bool done;
+};
+
 typedef struct mf {
     struct mp_log *log;
     struct sh_stream *sh;
@@ -46,6 +61,15 @@ typedef struct mf {
     char **names;
     // optional
     struct stream **streams;
+
+    struct mp_thread_pool *pool;
+    struct mp_cancel *cancel;
+    // Files being read, in frame order starting with curr_frame.
+    struct prefetch **prefetch;
+    int num_prefetch;
+    size_t frame_bytes;     // size of the last frame read, 0 if unknown
+    mp_mutex lock;
+    mp_cond wakeup;
 } mf_t;
 
 
@@ -223,6 +247,135 @@ static mf_t *open_mf_single(void *talloc_ctx, struct mp_log *log, char *filename
     return mf;
 }
 
+// Read the whole file into a new packet.
+static struct demux_packet *read_image(struct stream *stream)
+{
+    stream_seek(stream, 0);
+
+    int64_t size = stream_get_size(stream);
+    if (size > 0 && size <= MF_MAX_FILE_SIZE) {
+        // Read directly into the packet buffer.
+        struct demux_packet *dp = new_demux_packet(size);
+        if (!dp)
+            return NULL;
+        int len = stream_read(stream, dp->buffer, size);
+        if (len <= 0) {
+            talloc_free(dp);
+            return NULL;
+        }
+        demux_packet_shorten(dp, len);
+        return dp;
+    }
+
+    // Unknown size.
+    bstr data = stream_read_complete(stream, NULL, MF_MAX_FILE_SIZE);
+    struct demux_packet *dp =
+        data.len ? new_demux_packet_from(data.start, data.len) : NULL;
+    talloc_free(data.start);
+    return dp;
+}
+
+static struct demux_packet *read_frame(struct demuxer *demuxer, int frame,
+                                       struct mp_cancel *cancel)
+{
+    mf_t *mf = demuxer->priv;
+
+    if (mf->streams)
+        return read_image(mf->streams[frame]);
+
+    char *filename = mf->names[frame];
+    if (!filename)
+        return NULL;
+    struct stream *stream = stream_create(filename,
+                                          demuxer->stream_origin | STREAM_READ,
+                                          cancel, demuxer->global);
+    if (!stream)
+        return NULL;
+    struct demux_packet *dp = read_image(stream);
+    free_stream(stream);
+    return dp;
+}
+
+static void prefetch_fn(void *ctx)
+{
+    struct prefetch *p = ctx;
+    mf_t *mf = p->demuxer->priv;
+
+    struct demux_packet *dp = read_frame(p->demuxer, p->frame, mf->cancel);
+
+    mp_mutex_lock(&mf->lock);
+    p->pkt = dp;
+    p->done = true;
+    mp_cond_broadcast(&mf->wakeup);
+    mp_mutex_unlock(&mf->lock);
+}
+
+// Queue reading the files following curr_frame, so that the per-file open and
+// read latency overlaps. The number of files follows --demuxer-readahead-secs,
+// and the files read ahead are limited to --demuxer-max-bytes in total. Until
+// the size of a file is known, only the next file is read ahead.
+static void start_prefetch(struct demuxer *demuxer)
+{
+    mf_t *mf = demuxer->priv;
+
+    double depth = ceil(demuxer->opts->min_secs * mf->sh->codec->fps);
+    int max = MPCLAMP(depth, 1, MF_MAX_PREFETCH);
+    if (!mf->frame_bytes)
+        max = MPMIN(max, 2);
+    // Reading only the current file on a worker thread would be pointless.
+    if (max < 2)
+        return;
+
+    // Files still being read are assumed to be as large as the last one.
+    int64_t bytes = 0;
+    mp_mutex_lock(&mf->lock);
+    for (int n = 0; n < mf->num_prefetch; n++) {
+        struct prefetch *p = mf->prefetch[n];
+        if (!p->done) {
+            bytes += mf->frame_bytes;
+        } else if (p->pkt) {
+            bytes += demux_packet_estimate_total_size(p->pkt);
+        }
+    }
+    mp_mutex_unlock(&mf->lock);
+
+    while (mf->num_prefetch < max) {
+        int frame = mf->curr_frame + mf->num_prefetch;
+        if (frame >= mf->nr_of_files)
+            break;
+        if (mf->num_prefetch && bytes + mf->frame_bytes > demuxer->opts->max_bytes)
+            break;
+        bytes += mf->frame_bytes;
+        struct prefetch *p = talloc_ptrtype(NULL, p);
+        *p = (struct prefetch){.demuxer = demuxer, .frame = frame};
+        if (!mp_thread_pool_queue(mf->pool, prefetch_fn, p)) {
+            talloc_free(p);
+            break;
+        }
+        MP_TARRAY_APPEND(mf, mf->prefetch, mf->num_prefetch, p);
+    }
+}
+
+// Abort and discard all files being read.
+static void stop_prefetch(mf_t *mf)
+{
+    if (!mf->num_prefetch)
+        return;
+
+    mp_cancel_trigger(mf->cancel);
+    mp_mutex_lock(&mf->lock);
+    for (int n = 0; n < mf->num_prefetch; n++) {
+        struct prefetch *p = mf->prefetch[n];
+        while (!p->done)
+            mp_cond_wait(&mf->wakeup, &mf->lock);
+        talloc_free(p->pkt);
+        talloc_free(p);
+    }
+    mp_mutex_unlock(&mf->lock);
+    mf->num_prefetch = 0;
+    mp_cancel_reset(mf->cancel);
+}
+
 static void demux_seek_mf(demuxer_t *demuxer, double seek_pts, int flags)
 {
     mf_t *mf = demuxer->priv;
@@ -234,6 +387,7 @@ static void demux_seek_mf(demuxer_t *demuxer, double seek_pts, int flags)
     } else {
         newpos = MPMIN(floor(newpos), mf->nr_of_files - 1);
     }
+    stop_prefetch(mf);
     mf->curr_frame = MPCLAMP((int)newpos, 0, mf->nr_of_files);
 }
 
@@ -243,45 +397,36 @@ static bool demux_mf_read_packet(struct demuxer *demuxer,
     mf_t *mf = demuxer->priv;
     if (mf->curr_frame >= mf->nr_of_files)
         return false;
-    bool ok = false;
 
-    struct stream *entry_stream = NULL;
-    if (mf->streams)
-        entry_stream = mf->streams[mf->curr_frame];
-    struct stream *stream = entry_stream;
-    if (!stream) {
-        char *filename = mf->names[mf->curr_frame];
-        if (filename) {
-            stream = stream_create(filename, demuxer->stream_origin | STREAM_READ,
-                                   demuxer->cancel, demuxer->global);
-        }
+    struct demux_packet *dp = NULL;
+    if (mf->pool)
+        start_prefetch(demuxer);
+    if (mf->num_prefetch) {
+        struct prefetch *p = mf->prefetch[0];
+        assert(p->frame == mf->curr_frame);
+        mp_mutex_lock(&mf->lock);
+        while (!p->done)
+            mp_cond_wait(&mf->wakeup, &mf->lock);
+        mp_mutex_unlock(&mf->lock);
+        dp = p->pkt;
+        talloc_free(p);
+        MP_TARRAY_REMOVE_AT(mf->prefetch, mf->num_prefetch, 0);
+    } else {
+        dp = read_frame(demuxer, mf->curr_frame, demuxer->cancel);
     }
 
-    if (stream) {
-        stream_seek(stream, 0);
-        bstr data = stream_read_complete(stream, NULL, MF_MAX_FILE_SIZE);
-        if (data.len) {
-            demux_packet_t *dp = new_demux_packet(data.len);
-            if (dp) {
-                memcpy(dp->buffer, data.start, data.len);
-                dp->pts = mf->curr_frame / mf->sh->codec->fps;
-                dp->keyframe = true;
-                dp->stream = mf->sh->index;
-                *pkt = dp;
-                ok = true;
-            }
-        }
-        talloc_free(data.start);
+    if (dp) {
+        mf->frame_bytes = demux_packet_estimate_total_size(dp);
+        dp->pts = mf->curr_frame / mf->sh->codec->fps;
+        dp->keyframe = true;
+        dp->stream = mf->sh->index;
+        *pkt = dp;
+    } else {
+        MP_ERR(demuxer, "error reading image file\n");
     }
 
-    if (stream && stream != entry_stream)
-        free_stream(stream);
-
     mf->curr_frame++;
 
-    if (!ok)
-        MP_ERR(demuxer, "error reading image file\n");
-
     return true;
 }
 
@@ -414,6 +559,14 @@ static int demux_open_mf(demuxer_t *demuxer, enum demux_check check)
     demuxer->seekable = true;
     demuxer->duration = mf->nr_of_files / mf->sh->codec->fps;
 
+    if (!mf->streams && mf->nr_of_files > 1) {
+        mf->pool = mp_thread_pool_create(mf, 0, 0, MF_MAX_PREFETCH);
+        mf->cancel = mp_cancel_new(mf);
+        mp_cancel_set_parent(mf->cancel, demuxer->cancel);
+        mp_mutex_init(&mf->lock);
+        mp_cond_init(&mf->wakeup);
+    }
+
     return 0;
 
 error:
@@ -422,6 +575,14 @@ error:
 
 static void demux_close_mf(demuxer_t *demuxer)
 {
+    mf_t *mf = demuxer->priv;
+
+    if (mf && mf->pool) {
+        stop_prefetch(mf);
+        TA_FREEP(&mf->pool);
+        mp_mutex_destroy(&mf->lock);
+        mp_cond_destroy(&mf->wakeup);
+    }
 }
 
 const demuxer_desc_t demuxer_desc_mf = {
@@ -26,11 +26,13 @@
 #include "common/msg.h"
 #include "common/playlist.h"
 #include "misc/charset_conv.h"
+#include "misc/thread_pool.h"
 #include "misc/thread_tools.h"
 #include "options/path.h"
 #include "player/core.h"
 #include "stream/stream.h"
 #include "osdep/io.h"
+#include "osdep/threads.h"
 #include "misc/natural_sort.h"
 #include "demux.h"
 
@@ -447,23 +449,97 @@ static bool test_path(struct pl_parser *p, char *path, int autocreate)
     return false;
 }
 
-// Return true if this was a readable directory.
-static bool scan_dir(struct pl_parser *p, char *path,
-                     struct stat *dir_stack, int num_dir_stack, int autocreate)
+// Maximum number of threads used to list directories in recursive mode.
+#define MAX_SCAN_THREADS 16
+
+struct pl_scan_ctx {
+    struct pl_parser *p;
+    struct mp_thread_pool *pool;
+    mp_mutex lock;
+    mp_cond wakeup;
+    int pending;            // number of queued or running scan_node() calls
+};
+
+// A directory. Its entries are listed by scan_node(), possibly on a worker
+// thread. Subdirectories are scanned in parallel; the results are merged into
+// the playlist in sorted order once all of them are done.
+struct pl_scan_node {
+    struct pl_scan_ctx *ctx;
+    char *path;
+    struct stat *dir_stack; // parent directories, including this one
+    int num_dir_stack;
+    struct pl_dir_entry *entries;
+    int num_entries;
+    struct pl_scan_node **subdirs; // for entries[n].is_dir, in entry order
+    bool ok;
+};
+
+// Determine whether the entry is a directory. Avoid stat() if readdir already
+// told us the file type, and nobody needs the inode to detect loops.
+static bool entry_is_dir(struct dirent *ep, const char *file, bool need_st,
+                         struct stat *st)
+{
+#ifdef DT_UNKNOWN
+    if (ep->d_type == DT_REG)
+        return false;
+    if (ep->d_type == DT_DIR && !need_st)
+        return true;
+#endif
+    return stat(file, st) == 0 && S_ISDIR(st->st_mode);
+}
+
+static void scan_node(struct pl_scan_node *node);
+
+static void scan_node_fn(void *arg)
+{
+    struct pl_scan_node *node = arg;
+    struct pl_scan_ctx *ctx = node->ctx;
+
+    scan_node(node);
+
+    mp_mutex_lock(&ctx->lock);
+    ctx->pending -= 1;
+    if (!ctx->pending)
+        mp_cond_broadcast(&ctx->wakeup);
+    mp_mutex_unlock(&ctx->lock);
+}
+
+static void queue_node(struct pl_scan_node *node)
+{
+    struct pl_scan_ctx *ctx = node->ctx;
+    if (ctx->pool) {
+        mp_mutex_lock(&ctx->lock);
+        ctx->pending += 1;
+        mp_mutex_unlock(&ctx->lock);
+        if (mp_thread_pool_queue(ctx->pool, scan_node_fn, node))
+            return;
+        mp_mutex_lock(&ctx->lock);
+        ctx->pending -= 1;
+        mp_mutex_unlock(&ctx->lock);
+    }
+    scan_node(node);
+}
+
+// List and sort a single directory, and queue its subdirectories. This only
+// allocates memory under node, so that sibling nodes can run concurrently.
+static void scan_node(struct pl_scan_node *node)
 {
-    if (strlen(path) >= 8192 || num_dir_stack == MAX_DIR_STACK)
-        return false; // things like mount bind loops
+    struct pl_parser *p = node->ctx->p;
+    char *path = node->path;
+
+    if (strlen(path) >= 8192 || node->num_dir_stack == MAX_DIR_STACK)
+        return; // things like mount bind loops
 
     DIR *dp = opendir(path);
     if (!dp) {
         MP_ERR(p, "Could not read directory.\n");
-        return false;
+        return;
     }
+    node->ok = true;
 
-    struct pl_dir_entry *dir_entries = NULL;
-    int num_dir_entries = 0;
     int path_len = strlen(path);
     int dir_mode = p->opts->dir_mode;
+    bool recursive = dir_mode == DIR_RECURSIVE;
 
     struct dirent *ep;
     while ((ep = readdir(dp))) {
@@ -473,46 +549,108 @@ static bool scan_dir(struct pl_parser *p, char *path,
         if (mp_cancel_test(p->s->cancel))
             break;
 
-        char *file = mp_path_join(p, path, ep->d_name);
+        char *file = mp_path_join(node, path, ep->d_name);
 
-        struct stat st;
-        if (stat(file, &st) == 0 && S_ISDIR(st.st_mode)) {
+        struct stat st = {0};
+        if (entry_is_dir(ep, file, recursive, &st)) {
             if (dir_mode != DIR_IGNORE) {
-                for (int n = 0; n < num_dir_stack; n++) {
-                    if (same_st(&dir_stack[n], &st)) {
+                for (int n = 0; n < node->num_dir_stack; n++) {
+                    if (same_st(&node->dir_stack[n], &st)) {
                         MP_VERBOSE(p, "Skip recursive entry: %s\n", file);
                         goto skip;
                     }
                 }
 
                 struct pl_dir_entry d = {file, &file[path_len], st, true};
-                MP_TARRAY_APPEND(p, dir_entries, num_dir_entries, d);
+                MP_TARRAY_APPEND(node, node->entries, node->num_entries, d);
             }
         } else {
             struct pl_dir_entry f = {file, &file[path_len], .is_dir = false};
-            MP_TARRAY_APPEND(p, dir_entries, num_dir_entries, f);
+            MP_TARRAY_APPEND(node, node->entries, node->num_entries, f);
         }
 
         skip: ;
     }
     closedir(dp);
 
-    if (dir_entries)
-        qsort(dir_entries, num_dir_entries, sizeof(dir_entries[0]), cmp_dir_entry);
+    if (node->entries) {
+        qsort(node->entries, node->num_entries, sizeof(node->entries[0]),
+              cmp_dir_entry);
+    }
 
-    for (int n = 0; n < num_dir_entries; n++) {
-        char *file = dir_entries[n].path;
-        if (dir_mode == DIR_RECURSIVE && dir_entries[n].is_dir) {
-            dir_stack[num_dir_stack] = dir_entries[n].st;
-            scan_dir(p, file, dir_stack, num_dir_stack + 1, autocreate);
-        }
-        else {
-            if (dir_entries[n].is_dir || test_path(p, file, autocreate))
-                playlist_append_file(p->pl, dir_entries[n].path);
+    if (!recursive)
+        return;
+
+    // Create all child nodes before queuing any of them, so that the workers
+    // never touch node's talloc tree concurrently with us.
+    node->subdirs = talloc_zero_array(node, struct pl_scan_node *,
+                                      node->num_entries);
+    for (int n = 0; n < node->num_entries; n++) {
+        struct pl_dir_entry *e = &node->entries[n];
+        if (!e->is_dir)
+            continue;
+        struct pl_scan_node *sub = talloc_zero(node, struct pl_scan_node);
+        sub->ctx = node->ctx;
+        sub->path = e->path;
+        sub->num_dir_stack = node->num_dir_stack + 1;
+        sub->dir_stack = talloc_array(sub, struct stat, sub->num_dir_stack);
+        for (int i = 0; i < node->num_dir_stack; i++)
+            sub->dir_stack[i] = node->dir_stack[i];
+        sub->dir_stack[node->num_dir_stack] = e->st;
+        node->subdirs[n] = sub;
+    }
+    for (int n = 0; n < node->num_entries; n++) {
+        if (node->subdirs[n])
+            queue_node(node->subdirs[n]);
+    }
+}
+
+// Add the scanned entries to the playlist, in the same order as a serial
+// depth-first traversal would produce.
+static void add_node_entries(struct pl_parser *p, struct pl_scan_node *node,
+                             int autocreate)
+{
+    for (int n = 0; n < node->num_entries; n++) {
+        struct pl_dir_entry *e = &node->entries[n];
+        if (node->subdirs && node->subdirs[n]) {
+            add_node_entries(p, node->subdirs[n], autocreate);
+        } else if (e->is_dir || test_path(p, e->path, autocreate)) {
+            playlist_append_file(p->pl, e->path);
         }
     }
+}
 
-    return true;
+// Return true if this was a readable directory.
+static bool scan_dir(struct pl_parser *p, char *path, int autocreate)
+{
+    struct pl_scan_ctx ctx = {.p = p};
+    mp_mutex_init(&ctx.lock);
+    mp_cond_init(&ctx.wakeup);
+
+    // Listing a directory is mostly waiting for the filesystem, so threads
+    // help even on a single core, especially on network mounts.
+    if (p->opts->dir_mode == DIR_RECURSIVE)
+        ctx.pool = mp_thread_pool_create(NULL, 1, 1, MAX_SCAN_THREADS);
+
+    struct pl_scan_node *root = talloc_zero(NULL, struct pl_scan_node);
+    root->ctx = &ctx;
+    root->path = path;
+    scan_node(root);
+
+    mp_mutex_lock(&ctx.lock);
+    while (ctx.pending)
+        mp_cond_wait(&ctx.wakeup, &ctx.lock);
+    mp_mutex_unlock(&ctx.lock);
+
+    talloc_free(ctx.pool);
+    mp_mutex_destroy(&ctx.lock);
+    mp_cond_destroy(&ctx.wakeup);
+
+    add_node_entries(p, root, autocreate);
+
+    bool ok = root->ok;
+    talloc_free(root);
+    return ok;
 }
 
 static enum autocreate_mode get_directory_filter(struct pl_parser *p)
@@ -584,15 +722,13 @@ static int parse_dir(struct pl_parser *p)
     if (autocreate == AUTO_NONE)
         goto done;
 
-    struct stat dir_stack[MAX_DIR_STACK];
-
     if (p->opts->dir_mode == DIR_AUTO) {
         struct MPOpts *opts = mp_get_config_group(NULL, p->global, &mp_opt_root);
         p->opts->dir_mode = opts->shuffle ? DIR_RECURSIVE : DIR_LAZY;
         talloc_free(opts);
     }
 
-    scan_dir(p, path, dir_stack, 0, autocreate);
+    scan_dir(p, path, autocreate);
 
     p->add_base = false;
     ret = p->pl->num_entries > 0 ? 0 : -1;
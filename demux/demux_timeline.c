@@ -20,6 +20,9 @@
 
 #include "common/common.h"
 #include "common/msg.h"
+#include "misc/thread_tools.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
 
 #include "demux.h"
 #include "timeline.h"
@@ -33,6 +36,10 @@ struct segment {
     char *url;
     bool lazy;
     struct demuxer *d;
+    struct preopen *preopen;    // lazy segment being opened in the background
+    double open_ms;             // time it took to open d (<0: not by us)
+    bool preopened;             // d was opened in the background
+    int64_t last_used;          // virtual_source.use_count at last use
     // stream_map[sh_stream.index] = virtual_stream, where sh_stream is a stream
     // from the source d, and virtual_stream is a streamexported by the
     // timeline demuxer (virtual_stream.sh). It's used to map the streams of the
@@ -42,6 +49,21 @@ struct segment {
     int num_stream_map;
 };
 
+// Opens a lazy segment on a separate thread, shortly before playback reaches
+// it. The fields are only accessed by the thread until it was joined.
+struct preopen {
+    mp_thread thread;
+    struct mpv_global *global;
+    struct mp_cancel *cancel;
+    char *url;
+    struct demuxer_params params;
+    bool seek;
+    double ts_offset, seek_pts;
+    // Results.
+    struct demuxer *d;
+    double open_ms;
+};
+
 // Information for each stream on the virtual timeline. (Mirrors streams
 // exposed by demux_timeline.)
 struct virtual_stream {
@@ -61,6 +83,7 @@ struct virtual_source {
     struct segment **segments;
     int num_segments;
     struct segment *current;
+    int64_t use_count;          // for closing lazy segments LRU
 
     struct virtual_stream **streams;
     int num_streams;
@@ -88,6 +111,8 @@ struct priv {
 
     struct virtual_source **sources;
     int num_sources;
+
+    bool opened_lazy;           // print_timeline() has open times to report
 };
 
 static void update_slave_stats(struct demuxer *demuxer, struct demuxer *slave)
@@ -190,44 +215,196 @@ static void reselect_streams(struct demuxer *demuxer)
     }
 }
 
+static MP_THREAD_VOID preopen_thread(void *arg)
+{
+    struct preopen *po = arg;
+
+    mp_thread_set_name("preopen");
+
+    int64_t start = mp_time_ns();
+    po->d = demux_open_url(po->url, &po->params, po->cancel, po->global);
+    // Pre-seek, so that the low level seek done by switch_segment() finds the
+    // stream already at the right position.
+    if (po->d && po->seek) {
+        demux_set_ts_offset(po->d, po->ts_offset);
+        demux_seek(po->d, po->seek_pts, SEEK_HR);
+    }
+    po->open_ms = MP_TIME_NS_TO_MS(mp_time_ns() - start);
+
+    MP_THREAD_RETURN();
+}
+
+static struct demuxer_params segment_params(struct demuxer *demuxer,
+                                            struct virtual_source *src)
+{
+    return (struct demuxer_params){
+        .init_fragment = src->tl->init_fragment,
+        .skip_lavf_probing = src->tl->dash,
+        .stream_flags = demuxer->stream_origin,
+    };
+}
+
+static void segment_opened(struct demuxer *demuxer, struct virtual_source *src,
+                           struct segment *seg)
+{
+    struct priv *p = demuxer->priv;
+
+    p->opened_lazy = true;
+    MP_VERBOSE(demuxer, "segment %d opened in %.1f ms%s\n", seg->index,
+               seg->open_ms, seg->preopened ? " (in background)" : "");
+    if (seg->d)
+        update_slave_stats(demuxer, seg->d);
+    associate_streams(demuxer, src, seg);
+}
+
+// Wait until the background open is done, and take the result.
+static void finish_preopen(struct demuxer *demuxer, struct virtual_source *src,
+                           struct segment *seg)
+{
+    struct preopen *po = seg->preopen;
+
+    mp_thread_join(po->thread);
+    seg->preopen = NULL;
+    seg->d = po->d;
+    seg->open_ms = po->open_ms;
+    seg->preopened = true;
+    // po->cancel goes away with po.
+    if (seg->d)
+        mp_cancel_set_parent(seg->d->cancel, demuxer->cancel);
+    talloc_free(po);
+
+    segment_opened(demuxer, src, seg);
+}
+
+static void close_segment(struct demuxer *demuxer, struct virtual_source *src,
+                          struct segment *seg)
+{
+    struct preopen *po = seg->preopen;
+    if (po) {
+        mp_cancel_trigger(po->cancel);
+        mp_thread_join(po->thread);
+        demux_free(po->d);
+        talloc_free(po);
+        seg->preopen = NULL;
+    }
+    if (seg->d) {
+        TA_FREEP(&src->next); // might depend on one of the sub-demuxers
+        demux_free(seg->d);
+        seg->d = NULL;
+    }
+}
+
 static void close_lazy_segments(struct demuxer *demuxer,
                                 struct virtual_source *src)
 {
     // unload previous segment
     for (int n = 0; n < src->num_segments; n++) {
         struct segment *seg = src->segments[n];
-        if (seg != src->current && seg->d && seg->lazy) {
-            TA_FREEP(&src->next); // might depend on one of the sub-demuxers
-            demux_free(seg->d);
-            seg->d = NULL;
+        if (seg != src->current && seg->lazy)
+            close_segment(demuxer, src, seg);
+    }
+}
+
+// Number of lazy segments that are open or being opened, except the current
+// one.
+static int num_open_lazy_segments(struct virtual_source *src)
+{
+    int num = 0;
+    for (int n = 0; n < src->num_segments; n++) {
+        struct segment *seg = src->segments[n];
+        if (seg != src->current && seg->lazy && (seg->d || seg->preopen))
+            num++;
+    }
+    return num;
+}
+
+// Close the least recently used lazy segments, until at most max are left.
+static void limit_lazy_segments(struct demuxer *demuxer,
+                                struct virtual_source *src, int max)
+{
+    while (num_open_lazy_segments(src) > max) {
+        struct segment *lru = NULL;
+        for (int n = 0; n < src->num_segments; n++) {
+            struct segment *seg = src->segments[n];
+            if (seg != src->current && seg->lazy && (seg->d || seg->preopen) &&
+                (!lru || seg->last_used < lru->last_used))
+                lru = seg;
         }
+        close_segment(demuxer, src, lru);
     }
 }
 
 static void reopen_lazy_segments(struct demuxer *demuxer,
                                  struct virtual_source *src)
 {
-    if (src->current->d)
+    struct segment *seg = src->current;
+
+    if (seg->d)
         return;
 
     // Note: in delay_open mode, we must _not_ close segments during demuxing,
     // because demuxed packets have demux_packet.codec set to objects owned
     // by the segments. Closing them would create dangling pointers.
     if (!src->delay_open)
-        close_lazy_segments(demuxer, src);
+        limit_lazy_segments(demuxer, src, demuxer->opts->segment_max_open);
+
+    if (seg->preopen) {
+        finish_preopen(demuxer, src, seg);
+    } else {
+        struct demuxer_params params = segment_params(demuxer, src);
+        int64_t start = mp_time_ns();
+        seg->d = demux_open_url(seg->url, &params, demuxer->cancel,
+                                demuxer->global);
+        seg->open_ms = MP_TIME_NS_TO_MS(mp_time_ns() - start);
+        seg->preopened = false;
+        segment_opened(demuxer, src, seg);
+    }
+    if (!seg->d && !demux_cancel_test(demuxer))
+        MP_ERR(demuxer, "failed to load segment\n");
+}
 
-    struct demuxer_params params = {
-        .init_fragment = src->tl->init_fragment,
-        .skip_lavf_probing = src->tl->dash,
-        .stream_flags = demuxer->stream_origin,
+// Start opening the next segment if playback is close enough to its start.
+static void preopen_next_segment(struct demuxer *demuxer,
+                                 struct virtual_source *src)
+{
+    struct demux_opts *opts = demuxer->opts;
+    struct segment *cur = src->current;
+
+    if (!opts->segment_preopen_secs || !opts->segment_max_open ||
+        src->dts == MP_NOPTS_VALUE || cur->index + 1 >= src->num_segments ||
+        src->dts < cur->end - opts->segment_preopen_secs)
+        return;
+
+    struct segment *next = src->segments[cur->index + 1];
+    if (!next->lazy || next->d || next->preopen)
+        return;
+
+    if (num_open_lazy_segments(src) >= opts->segment_max_open) {
+        if (src->delay_open)
+            return; // see reopen_lazy_segments()
+        limit_lazy_segments(demuxer, src, opts->segment_max_open - 1);
+    }
+
+    struct preopen *po = talloc_ptrtype(NULL, po);
+    *po = (struct preopen){
+        .global = demuxer->global,
+        .cancel = mp_cancel_new(po),
+        .url = next->url,
+        .params = segment_params(demuxer, src),
+        .seek = !src->no_clip,
+        .ts_offset = next->start - next->d_start,
+        .seek_pts = next->start,
     };
-    src->current->d = demux_open_url(src->current->url, &params,
-                                     demuxer->cancel, demuxer->global);
-    if (!src->current->d && !demux_cancel_test(demuxer))
-        MP_ERR(demuxer, "failed to load segment\n");
-    if (src->current->d)
-        update_slave_stats(demuxer, src->current->d);
-    associate_streams(demuxer, src, src->current);
+    mp_cancel_set_parent(po->cancel, demuxer->cancel);
+
+    if (mp_thread_create(&po->thread, preopen_thread, po)) {
+        talloc_free(po);
+        return;
+    }
+
+    MP_VERBOSE(demuxer, "opening segment %d in background\n", next->index);
+    next->preopen = po;
+    next->last_used = ++src->use_count;
 }
 
 static void switch_segment(struct demuxer *demuxer, struct virtual_source *src,
@@ -243,6 +420,7 @@ static void switch_segment(struct demuxer *demuxer, struct virtual_source *src,
         update_slave_stats(demuxer, src->current->d);
 
     src->current = new;
+    new->last_used = ++src->use_count;
     reopen_lazy_segments(demuxer, src);
     if (!new->d)
         return;
@@ -273,6 +451,8 @@ static void do_read_next_packet(struct demuxer *demuxer,
         return;
     }
 
+    preopen_next_segment(demuxer, src);
+
     struct demux_packet *pkt = demux_read_any_packet(seg->d);
     if (!pkt || (!src->no_clip && pkt->pts >= seg->end))
         src->eos_packets += 1;
@@ -497,7 +677,12 @@ static void print_timeline(struct demuxer *demuxer)
                 MP_VERBOSE(demuxer, "%s%d", i ? " " : "",
                            vs ? vs->sh->index : -1);
             }
-            MP_VERBOSE(demuxer, ")\n  source %d:'%s'\n", src_num, seg->url);
+            MP_VERBOSE(demuxer, ")\n  source %d:'%s'", src_num, seg->url);
+            if (seg->open_ms >= 0) {
+                MP_VERBOSE(demuxer, " (opened in %.1f ms%s)", seg->open_ms,
+                           seg->preopened ? " in background" : "");
+            }
+            MP_VERBOSE(demuxer, "\n");
         }
 
         if (src->dash)
@@ -620,6 +805,7 @@ static bool add_tl(struct demuxer *demuxer, struct timeline_par *tl)
             .d_start = part->source_start,
             .start = part->start,
             .end = part->end,
+            .open_ms = -1,
         };
 
         associate_streams(demuxer, src, seg);
@@ -688,6 +874,9 @@ static void d_close(struct demuxer *demuxer)
 {
     struct priv *p = demuxer->priv;
 
+    if (p->opened_lazy)
+        print_timeline(demuxer);
+
     for (int x = 0; x < p->num_sources; x++) {
         struct virtual_source *src = p->sources[x];
 
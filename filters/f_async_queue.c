@@ -15,30 +15,122 @@ struct mp_async_queue {
     struct async_queue *q;
 };
 
+struct slot {
+    struct mp_frame frame;
+    _Atomic double pts; // for is_full() from any thread
+};
+
 struct async_queue {
     _Atomic uint64_t refcount;
 
     mp_mutex lock;
+    mp_cond idle; // signaled when a filter leaves its lock-free section
+
+    // Frame accounting. Written by the filters (possibly without lock), or
+    // with exclusive access.
+    _Atomic int64_t samples_size; // queue size in the cfg.sample_unit
+    _Atomic int64_t byte_size; // queue size in bytes (using approx. frame sizes)
+    _Atomic int eof_count; // number of MP_FRAME_EOF in the queue, for draining
+
+    // Ring buffer of queued frames: [tail, head), indexes modulo alloc. Only
+    // the producer increments head, only the consumer increments tail. slots
+    // and alloc are changed only with exclusive access.
+    struct slot *slots;
+    int alloc; // power of 2
+    _Atomic uint64_t head, tail;
+
+    // Batched wakeups (lock-free mode only): a filter that can't continue sets
+    // its flag, and the other end wakes it up only if it was set.
+    atomic_bool reader_waiting; // consumer found the queue empty
+    atomic_bool writer_waiting; // producer found the queue full
+
+    // Lock-free mode. A filter process function that sets busy[] does not take
+    // the lock; functions that need exclusive access set "exclusive" and wait
+    // until both are unset (see enter_side() and begin_exclusive()).
+    atomic_bool lockless;
+    atomic_bool exclusive;
+    atomic_bool busy[2];
+
+    // -- written with lock held (or exclusive access), read by the filters
+    //    without lock in lock-free mode
+    struct mp_async_queue_config cfg;
+    atomic_bool active; // queue was resumed; consumer may request frames
+    atomic_bool reading; // data flow: reading => consumer has requested frames
 
     // -- protected by lock
-    struct mp_async_queue_config cfg;
-    bool active; // queue was resumed; consumer may request frames
-    bool reading; // data flow: reading => consumer has requested frames
-    int64_t samples_size; // queue size in the cfg.sample_unit
-    size_t byte_size; // queue size in bytes (using approx. frame sizes)
-    int num_frames;
-    struct mp_frame *frames;
-    int eof_count; // number of MP_FRAME_EOF in frames[], for draining
     struct mp_filter *conn[2]; // filters: in (0), out (1)
 };
 
+// Called by the filter on the given side (0: producer, 1: consumer) before
+// touching the queue. Returns true if the lock was taken, false if the caller
+// is in the lock-free section. Either way, call leave_side() when done. The
+// caller must not take the lock until then.
+static bool enter_side(struct async_queue *q, int side)
+{
+    if (atomic_load(&q->lockless)) {
+        // Pairs with begin_exclusive(): either it sees us busy, or we see it.
+        atomic_store(&q->busy[side], true);
+        if (!atomic_load(&q->exclusive))
+            return false;
+        atomic_store(&q->busy[side], false);
+        mp_mutex_lock(&q->lock);
+        mp_cond_broadcast(&q->idle);
+        return true;
+    }
+    mp_mutex_lock(&q->lock);
+    return true;
+}
+
+static void leave_side(struct async_queue *q, int side, bool locked)
+{
+    if (locked) {
+        mp_mutex_unlock(&q->lock);
+        return;
+    }
+    atomic_store(&q->busy[side], false);
+    if (atomic_load(&q->exclusive)) {
+        mp_mutex_lock(&q->lock);
+        mp_cond_broadcast(&q->idle);
+        mp_mutex_unlock(&q->lock);
+    }
+}
+
+// Wait until no filter is in its lock-free section, and keep it that way until
+// end_exclusive(). Must be called with the lock held.
+static void begin_exclusive(struct async_queue *q)
+{
+    atomic_store(&q->exclusive, true);
+    while (atomic_load(&q->busy[0]) || atomic_load(&q->busy[1]))
+        mp_cond_wait(&q->idle, &q->lock);
+}
+
+static void end_exclusive(struct async_queue *q)
+{
+    atomic_store(&q->exclusive, false);
+}
+
+static void wakeup_conn(struct async_queue *q, int side)
+{
+    mp_mutex_lock(&q->lock);
+    if (q->conn[side])
+        mp_filter_wakeup(q->conn[side]);
+    mp_mutex_unlock(&q->lock);
+}
+
+static struct slot *get_slot(struct async_queue *q, uint64_t index)
+{
+    return &q->slots[index & (q->alloc - 1)];
+}
+
 static void reset_queue(struct async_queue *q)
 {
     mp_mutex_lock(&q->lock);
+    begin_exclusive(q);
     q->active = q->reading = false;
-    for (int n = 0; n < q->num_frames; n++)
-        mp_frame_unref(&q->frames[n]);
-    q->num_frames = 0;
+    uint64_t head = atomic_load(&q->head);
+    for (uint64_t n = atomic_load(&q->tail); n < head; n++)
+        mp_frame_unref(&get_slot(q, n)->frame);
+    q->tail = head;
     q->eof_count = 0;
     q->samples_size = 0;
     q->byte_size = 0;
@@ -46,6 +138,7 @@ static void reset_queue(struct async_queue *q)
         if (q->conn[n])
             mp_filter_wakeup(q->conn[n]);
     }
+    end_exclusive(q);
     mp_mutex_unlock(&q->lock);
 }
 
@@ -58,6 +151,7 @@ static void unref_queue(struct async_queue *q)
     if (count == 0) {
         reset_queue(q);
         mp_mutex_destroy(&q->lock);
+        mp_cond_destroy(&q->idle);
         talloc_free(q);
     }
 }
@@ -76,6 +170,7 @@ struct mp_async_queue *mp_async_queue_create(void)
         .refcount = 1,
     };
     mp_mutex_init(&r->q->lock);
+    mp_cond_init(&r->q->idle);
     talloc_set_destructor(r, on_free_queue);
     mp_async_queue_set_config(r, (struct mp_async_queue_config){0});
     return r;
@@ -93,13 +188,19 @@ static int64_t frame_get_samples(struct async_queue *q, struct mp_frame frame)
     return res;
 }
 
+// Called by the producer, or with the lock held.
 static bool is_full(struct async_queue *q)
 {
-    if (q->samples_size >= q->cfg.max_samples || q->byte_size >= q->cfg.max_bytes)
+    if (atomic_load(&q->samples_size) >= q->cfg.max_samples ||
+        atomic_load(&q->byte_size) >= q->cfg.max_bytes)
         return true;
-    if (q->num_frames >= 2 && q->cfg.max_duration > 0) {
-        double pts1 = mp_frame_get_pts(q->frames[q->num_frames - 1]);
-        double pts2 = mp_frame_get_pts(q->frames[0]);
+    uint64_t tail = atomic_load(&q->tail);
+    uint64_t head = atomic_load(&q->head);
+    if (head - tail >= 2 && q->cfg.max_duration > 0) {
+        // The consumer might be removing the oldest frame right now, in which
+        // case this sees its (still valid) timestamp.
+        double pts1 = atomic_load(&get_slot(q, tail)->pts);
+        double pts2 = atomic_load(&get_slot(q, head - 1)->pts);
         if (pts1 != MP_NOPTS_VALUE && pts2 != MP_NOPTS_VALUE &&
             pts2 - pts1 >= q->cfg.max_duration)
             return true;
@@ -107,6 +208,17 @@ static bool is_full(struct async_queue *q)
     return false;
 }
 
+// Like is_full(), but if the queue is full, make sure the consumer wakes up
+// the producer once it removes a frame.
+static bool check_full(struct async_queue *q)
+{
+    if (!is_full(q))
+        return false;
+    atomic_store(&q->writer_waiting, true);
+    // Recheck in case the consumer removed a frame before seeing the flag.
+    return is_full(q);
+}
+
 // Add or remove a frame from the accounted queue size.
 //  dir==1: add, dir==-1: remove
 static void account_frame(struct async_queue *q, struct mp_frame frame,
@@ -114,20 +226,79 @@ static void account_frame(struct async_queue *q, struct mp_frame frame,
 {
     assert(dir == 1 || dir == -1);
 
-    q->samples_size += dir * frame_get_samples(q, frame);
-    q->byte_size += dir * mp_frame_approx_size(frame);
+    atomic_fetch_add(&q->samples_size, dir * frame_get_samples(q, frame));
+    atomic_fetch_add(&q->byte_size, dir * mp_frame_approx_size(frame));
 
     if (frame.type == MP_FRAME_EOF)
-        q->eof_count += dir;
+        atomic_fetch_add(&q->eof_count, dir);
 }
 
+// Must be called with exclusive access.
 static void recompute_sizes(struct async_queue *q)
 {
     q->eof_count = 0;
     q->samples_size = 0;
     q->byte_size = 0;
-    for (int n = 0; n < q->num_frames; n++)
-        account_frame(q, q->frames[n], 1);
+    uint64_t head = atomic_load(&q->head);
+    for (uint64_t n = atomic_load(&q->tail); n < head; n++)
+        account_frame(q, get_slot(q, n)->frame, 1);
+}
+
+// Called by the producer only, outside of enter_side()/leave_side(). Makes
+// sure that there is room for one more frame; since only the producer adds
+// frames, this remains true until it adds one.
+static void reserve_slot(struct async_queue *q)
+{
+    if (atomic_load(&q->head) - atomic_load(&q->tail) < q->alloc)
+        return;
+
+    mp_mutex_lock(&q->lock);
+    begin_exclusive(q);
+    int alloc = MPMAX(16, q->alloc * 2);
+    struct slot *slots = talloc_zero_array(q, struct slot, alloc);
+    uint64_t head = atomic_load(&q->head);
+    for (uint64_t n = atomic_load(&q->tail); n < head; n++) {
+        struct slot *src = get_slot(q, n);
+        struct slot *dst = &slots[n & (alloc - 1)];
+        dst->frame = src->frame;
+        dst->pts = atomic_load(&src->pts);
+    }
+    talloc_free(q->slots);
+    q->slots = slots;
+    q->alloc = alloc;
+    end_exclusive(q);
+    mp_mutex_unlock(&q->lock);
+}
+
+// Called by the producer after reserve_slot().
+static void push_frame(struct async_queue *q, struct mp_frame frame)
+{
+    uint64_t head = atomic_load(&q->head);
+    assert(head - atomic_load(&q->tail) < q->alloc);
+    struct slot *s = get_slot(q, head);
+    s->frame = frame;
+    atomic_store(&s->pts, mp_frame_get_pts(frame));
+    account_frame(q, frame, 1);
+    atomic_store(&q->head, head + 1);
+}
+
+// Called by the consumer. Returns false if the queue is empty; then the
+// producer will wake up the consumer once it adds a frame.
+static bool pop_frame(struct async_queue *q, struct mp_frame *frame)
+{
+    uint64_t tail = atomic_load(&q->tail);
+    if (tail == atomic_load(&q->head)) {
+        atomic_store(&q->reader_waiting, true);
+        // Recheck in case the producer added a frame before seeing the flag.
+        if (tail == atomic_load(&q->head))
+            return false;
+    }
+    struct slot *s = get_slot(q, tail);
+    *frame = s->frame;
+    account_frame(q, *frame, -1);
+    assert(atomic_load(&q->samples_size) >= 0);
+    atomic_store(&q->tail, tail + 1);
+    return true;
 }
 
 void mp_async_queue_set_config(struct mp_async_queue *queue,
@@ -143,10 +314,13 @@ void mp_async_queue_set_config(struct mp_async_queue *queue,
     cfg.max_samples = MPMAX(cfg.max_samples, 1);
 
     mp_mutex_lock(&q->lock);
+    begin_exclusive(q);
     bool recompute = q->cfg.sample_unit != cfg.sample_unit;
     q->cfg = cfg;
+    q->lockless = cfg.lockless;
     if (recompute)
         recompute_sizes(q);
+    end_exclusive(q);
     mp_mutex_unlock(&q->lock);
 }
 
@@ -157,11 +331,7 @@ void mp_async_queue_reset(struct mp_async_queue *queue)
 
 bool mp_async_queue_is_active(struct mp_async_queue *queue)
 {
-    struct async_queue *q = queue->q;
-    mp_mutex_lock(&q->lock);
-    bool res = q->active;
-    mp_mutex_unlock(&q->lock);
-    return res;
+    return atomic_load(&queue->q->active);
 }
 
 bool mp_async_queue_is_full(struct mp_async_queue *queue)
@@ -206,20 +376,14 @@ void mp_async_queue_resume_reading(struct mp_async_queue *queue)
 
 int64_t mp_async_queue_get_samples(struct mp_async_queue *queue)
 {
-    struct async_queue *q = queue->q;
-    mp_mutex_lock(&q->lock);
-    int64_t res = q->samples_size;
-    mp_mutex_unlock(&q->lock);
-    return res;
+    return atomic_load(&queue->q->samples_size);
 }
 
 int mp_async_queue_get_frames(struct mp_async_queue *queue)
 {
     struct async_queue *q = queue->q;
-    mp_mutex_lock(&q->lock);
-    int res = q->num_frames;
-    mp_mutex_unlock(&q->lock);
-    return res;
+    uint64_t tail = atomic_load(&q->tail);
+    return atomic_load(&q->head) - tail;
 }
 
 struct priv {
@@ -248,7 +412,10 @@ static void process_in(struct mp_filter *f)
     struct async_queue *q = p->q;
     assert(q->conn[0] == f);
 
-    mp_mutex_lock(&q->lock);
+    reserve_slot(q);
+
+    bool locked = enter_side(q, 0);
+    bool wakeup_reader = false, full = false;
     if (!q->reading) {
         // mp_async_queue_reset()/reset_queue() is usually called asynchronously,
         // so we might have requested a frame earlier, and now can't use it.
@@ -259,22 +426,23 @@ static void process_in(struct mp_filter *f)
             mp_frame_unref(&frame);
             MP_DBG(f, "discarding frame due to async reset\n");
         }
-    } else if (!is_full(q) && mp_pin_out_request_data(f->ppins[0])) {
+    } else if (!check_full(q) && mp_pin_out_request_data(f->ppins[0])) {
         struct mp_frame frame = mp_pin_out_read(f->ppins[0]);
-        account_frame(q, frame, 1);
-        MP_TARRAY_INSERT_AT(q, q->frames, q->num_frames, 0, frame);
+        push_frame(q, frame);
         // Notify reader that we have new frames.
-        if (q->conn[1])
-            mp_filter_wakeup(q->conn[1]);
-        bool full = is_full(q);
+        wakeup_reader = atomic_exchange(&q->reader_waiting, false) ||
+                        !atomic_load(&q->lockless);
+        full = check_full(q);
         if (!full)
             mp_pin_out_request_data_next(f->ppins[0]);
-        if (p->notify && full)
-            mp_filter_wakeup(p->notify);
     }
-    if (p->notify && !q->num_frames)
+    bool empty = atomic_load(&q->head) == atomic_load(&q->tail);
+    leave_side(q, 0, locked);
+
+    if (wakeup_reader)
+        wakeup_conn(q, 1);
+    if (p->notify && (full || empty))
         mp_filter_wakeup(p->notify);
-    mp_mutex_unlock(&q->lock);
 }
 
 static void process_out(struct mp_filter *f)
@@ -286,22 +454,32 @@ static void process_out(struct mp_filter *f)
     if (!mp_pin_in_needs_data(f->ppins[0]))
         return;
 
-    mp_mutex_lock(&q->lock);
-    if (q->active && !q->reading) {
-        q->reading = true;
-        mp_filter_wakeup(q->conn[0]);
+    bool wakeup_writer = false;
+    if (atomic_load(&q->active) && !atomic_load(&q->reading)) {
+        // Happens once after each reset, so just take the lock.
+        mp_mutex_lock(&q->lock);
+        if (q->active && !q->reading) {
+            q->reading = true;
+            wakeup_writer = true;
+        }
+        mp_mutex_unlock(&q->lock);
     }
-    if (q->active && q->num_frames) {
-        struct mp_frame frame = q->frames[q->num_frames - 1];
-        q->num_frames -= 1;
-        account_frame(q, frame, -1);
-        assert(q->samples_size >= 0);
+
+    bool locked = enter_side(q, 1);
+    struct mp_frame frame;
+    if (q->active && pop_frame(q, &frame)) {
         mp_pin_in_write(f->ppins[0], frame);
-        // Notify writer that we need new frames.
-        if (q->conn[0])
-            mp_filter_wakeup(q->conn[0]);
+        // Notify writer that we need new frames. If the queue became empty,
+        // the writer needs to run for the mp_async_queue_set_notifier() case.
+        if (atomic_exchange(&q->writer_waiting, false) ||
+            atomic_load(&q->head) == atomic_load(&q->tail) ||
+            !atomic_load(&q->lockless))
+            wakeup_writer = true;
     }
-    mp_mutex_unlock(&q->lock);
+    leave_side(q, 1, locked);
+
+    if (wakeup_writer)
+        wakeup_conn(q, 0);
 }
 
 static void reset(struct mp_filter *f)
@@ -121,12 +121,19 @@ struct mp_async_queue_config {
     // at least 2 samples. Behavior is unclear on timestamp resets (even if EOF
     // frames are between them). A value of 0 disables this completely.
     double max_duration;
+
+    // Let the producer and consumer filters pass frames without taking the
+    // queue lock (single-producer/single-consumer ring buffer). This is safe
+    // as long as each filter graph is run by a single thread at a time, which
+    // is required anyway. The other functions still lock, and the ones that
+    // modify the queue contents (reset, config changes) wait until both
+    // filters are done with their current process() call.
+    bool lockless;
 };
 
 // Configure the queue size. By default, the queue size is 1 frame.
-// The wakeup_threshold_* fields can be used to avoid too frequent wakeups by
-// delaying wakeups, and then making the producer to filter multiple frames at
-// once.
+// To avoid too frequent wakeups, the producer is woken up only if it stopped
+// due to a full queue, and the consumer only if it found the queue empty.
 // In all cases, the filters can still read/write if the producer/consumer got
 // woken up by something else.
 // If the current queue contains more frames than the new config allows, the
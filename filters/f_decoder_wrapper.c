@@ -38,6 +38,7 @@
 #include "common/codecs.h"
 #include "common/global.h"
 #include "common/recorder.h"
+#include "common/stats.h"
 #include "misc/dispatch.h"
 
 #include "audio/aframe.h"
@@ -146,6 +147,7 @@ const struct m_sub_options dec_wrapper_conf = {
 
 struct priv {
     struct mp_log *log;
+    struct stats_ctx *stats;
     struct sh_stream *header;
 
     // --- The following fields are to be accessed by dec_dispatch (or if that
@@ -922,6 +924,11 @@ static void feed_packet(struct priv *p)
         packet->pts = packet->dts = MP_NOPTS_VALUE;
     }
 
+    if (packet) {
+        stats_trace_event(p->stats, stream_type_name(p->header->type),
+                          "decode-in", pkt_pts);
+    }
+
     mp_pin_in_write(p->decoder->f->pins[0], p->packet);
     p->packet_fed = true;
     p->packet = MP_NO_FRAME;
@@ -990,6 +997,11 @@ static void read_frame(struct priv *p)
     if (!frame.type)
         return;
 
+    if (frame.type != MP_FRAME_EOF) {
+        stats_trace_event(p->stats, stream_type_name(p->header->type),
+                          "decode-out", mp_frame_get_pts(frame));
+    }
+
     mp_mutex_lock(&p->cache_lock);
     if (p->attached_picture && frame.type == MP_FRAME_VIDEO)
         p->decoded_coverart = frame;
@@ -1069,6 +1081,7 @@ static void update_queue_config(struct priv *p)
         .sample_unit = AQUEUE_UNIT_SAMPLES,
         .max_samples = p->queue_opts->max_samples,
         .max_duration = p->queue_opts->max_duration,
+        .lockless = true,
     };
     mp_async_queue_set_config(p->queue, cfg);
 }
@@ -1170,8 +1183,9 @@ static void onlock_dec_thread(void *ptr)
     mp_filter_graph_interrupt(p->dec_root_filter);
 }
 
-struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
-                                                     struct sh_stream *src)
+static struct mp_decoder_wrapper *create_wrapper(struct mp_filter *parent,
+                                                 struct sh_stream *src,
+                                                 bool decode_ahead)
 {
     struct mp_filter *public_f = mp_filter_create(parent, &decode_wrapper_filter);
     if (!public_f)
@@ -1186,6 +1200,7 @@ struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
     p->header = src;
     p->codec = p->header->codec;
     p->play_dir = 1;
+    p->stats = stats_ctx_create(p, public_f->global, "decoder");
     mp_filter_add_pin(public_f, MP_PIN_OUT, "out");
 
     if (p->header->type == STREAM_VIDEO) {
@@ -1209,7 +1224,7 @@ struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
         goto error;
     }
 
-    if (p->queue_opts && p->queue_opts->use_queue) {
+    if (p->queue_opts && (p->queue_opts->use_queue || decode_ahead)) {
         p->queue = mp_async_queue_create();
         p->dec_dispatch = mp_dispatch_create(p);
         p->dec_root_filter = mp_filter_create_root(public_f->global);
@@ -1262,12 +1277,28 @@ struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
 
     public_f_reset(public_f);
 
+    // Fill the queue without waiting for the first request.
+    if (decode_ahead)
+        mp_async_queue_resume_reading(p->queue);
+
     return &p->public;
 error:
     talloc_free(public_f);
     return NULL;
 }
 
+struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
+                                                     struct sh_stream *src)
+{
+    return create_wrapper(parent, src, false);
+}
+
+struct mp_decoder_wrapper *mp_decoder_wrapper_create_ahead(struct mp_filter *parent,
+                                                           struct sh_stream *src)
+{
+    return create_wrapper(parent, src, true);
+}
+
 void lavc_process(struct mp_filter *f, struct lavc_state *state,
                   int (*send)(struct mp_filter *f, struct demux_packet *pkt),
                   int (*receive)(struct mp_filter *f, struct mp_frame *res))
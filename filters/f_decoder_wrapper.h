@@ -43,6 +43,14 @@ struct mp_decoder_wrapper {
 struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
                                                      struct sh_stream *src);
 
+// Like mp_decoder_wrapper_create(), but always decode on a separate thread (as
+// with --vd-queue/--ad-queue enabled), and start decoding into the queue right
+// after mp_decoder_wrapper_reinit(), before anything requests data. The queue
+// options limit how much is decoded ahead. Resetting the wrapper stops this.
+// This is used to prepare the next playlist entry in the background.
+struct mp_decoder_wrapper *mp_decoder_wrapper_create_ahead(struct mp_filter *parent,
+                                                           struct sh_stream *src);
+
 // Legacy decoder framedrop control.
 void mp_decoder_wrapper_set_frame_drops(struct mp_decoder_wrapper *d, int num);
 int mp_decoder_wrapper_get_frames_dropped(struct mp_decoder_wrapper *d);
@@ -1,6 +1,7 @@
 #include "audio/aframe.h"
 #include "audio/out/ao.h"
 #include "common/global.h"
+#include "common/stats.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
 #include "video/out/vo.h"
@@ -17,6 +18,7 @@
 struct chain {
     struct mp_filter *f;
     struct mp_log *log;
+    struct stats_ctx *stats;
 
     enum mp_output_chain_type type;
 
@@ -201,6 +203,11 @@ static void user_wrapper_process(struct mp_filter *f)
         if (pts != MP_NOPTS_VALUE)
             u->last_out_pts = pts;
 
+        if (frame.type == p->frame_type) {
+            stats_trace_event(p->stats, mp_frame_type_str(frame.type),
+                              u->name, pts);
+        }
+
         mp_pin_in_write(f->ppins[1], frame);
 
         struct mp_filter_command cmd = {.type = MP_FILTER_COMMAND_IS_ACTIVE};
@@ -693,6 +700,7 @@ struct mp_output_chain *mp_output_chain_create(struct mp_filter *parent,
     struct chain *p = f->priv;
     p->f = f;
     p->log = f->log;
+    p->stats = stats_ctx_create(p, f->global, "filters");
     p->type = type;
 
     struct mp_output_chain *c = &p->public;
@@ -1668,7 +1668,7 @@ struct mpv_node mp_input_get_bindings(struct input_ctx *ictx)
 {
     input_lock(ictx);
     struct mpv_node root;
-    node_init(&root, MPV_FORMAT_NODE_ARRAY, NULL);
+    node_init_arena(&root, MPV_FORMAT_NODE_ARRAY);
 
     for (int x = 0; x < ictx->num_sections; x++) {
         struct cmd_bind_section *s = ictx->sections[x];
@@ -15,6 +15,7 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <assert.h>
 
@@ -25,6 +26,9 @@
 #include "dispatch.h"
 
 struct mp_dispatch_queue {
+    // Items pushed without taking the lock, newest first. Moved to head/tail
+    // (with the lock held) before the list is accessed.
+    _Atomic(struct mp_dispatch_item *) incoming;
     struct mp_dispatch_item *head, *tail;
     mp_mutex lock;
     mp_cond cond;
@@ -64,6 +68,7 @@ static void queue_dtor(void *p)
 {
     struct mp_dispatch_queue *queue = p;
     assert(!queue->head);
+    assert(!atomic_load(&queue->incoming));
     assert(!queue->in_process);
     assert(!queue->lock_requests);
     assert(!queue->locked);
@@ -123,19 +128,83 @@ void mp_dispatch_set_onlock_fn(struct mp_dispatch_queue *queue,
     queue->onlock_ctx = onlock_ctx;
 }
 
+// Move the items pushed by push_incoming() to the end of the list. Must be
+// called with queue->lock held.
+static void drain_incoming(struct mp_dispatch_queue *queue)
+{
+    if (!atomic_load_explicit(&queue->incoming, memory_order_relaxed))
+        return;
+    struct mp_dispatch_item *item = atomic_exchange(&queue->incoming, NULL);
+    // Reverse it to get the submission order.
+    struct mp_dispatch_item *first = NULL, *last = item;
+    while (item) {
+        struct mp_dispatch_item *next = item->next;
+        item->next = first;
+        first = item;
+        item = next;
+    }
+    if (queue->tail) {
+        queue->tail->next = first;
+    } else {
+        queue->head = first;
+    }
+    queue->tail = last;
+}
+
+// Wake up the target thread for new items. Must be called with queue->lock
+// held; returns whether the caller must call wakeup_fn after unlocking.
+static bool wakeup_locked(struct mp_dispatch_queue *queue)
+{
+    // Wake up the main thread; note that other threads might wait on this
+    // condition for reasons, so broadcast the condition.
+    mp_cond_broadcast(&queue->cond);
+    // No wakeup callback -> assume mp_dispatch_queue_process() needs to be
+    // interrupted instead.
+    if (!queue->wakeup_fn)
+        queue->interrupted = true;
+    return !!queue->wakeup_fn;
+}
+
+// Add the item without taking the lock if possible. Only the thread that
+// makes the incoming list non-empty wakes up the target thread: items pushed
+// before the target thread got to drain the list are part of the same batch,
+// and need no wakeup of their own.
+static void push_incoming(struct mp_dispatch_queue *queue,
+                          struct mp_dispatch_item *item)
+{
+    struct mp_dispatch_item *head = atomic_load(&queue->incoming);
+    do {
+        item->next = head;
+    } while (!atomic_compare_exchange_weak(&queue->incoming, &head, item));
+    if (head)
+        return;
+
+    mp_mutex_lock(&queue->lock);
+    bool wakeup = wakeup_locked(queue);
+    mp_mutex_unlock(&queue->lock);
+
+    if (wakeup)
+        queue->wakeup_fn(queue->wakeup_ctx);
+}
+
 static void mp_dispatch_append(struct mp_dispatch_queue *queue,
                                struct mp_dispatch_item *item)
 {
+    if (!item->mergeable) {
+        push_incoming(queue, item);
+        return;
+    }
+
+    // Mergeable items need to look at the queued items.
     mp_mutex_lock(&queue->lock);
-    if (item->mergeable) {
-        for (struct mp_dispatch_item *cur = queue->head; cur; cur = cur->next) {
-            if (cur->mergeable && cur->fn == item->fn &&
-                cur->fn_data == item->fn_data)
-            {
-                talloc_free(item);
-                mp_mutex_unlock(&queue->lock);
-                return;
-            }
+    drain_incoming(queue);
+    for (struct mp_dispatch_item *cur = queue->head; cur; cur = cur->next) {
+        if (cur->mergeable && cur->fn == item->fn &&
+            cur->fn_data == item->fn_data)
+        {
+            talloc_free(item);
+            mp_mutex_unlock(&queue->lock);
+            return;
         }
     }
 
@@ -146,16 +215,10 @@ static void mp_dispatch_append(struct mp_dispatch_queue *queue,
     }
     queue->tail = item;
 
-    // Wake up the main thread; note that other threads might wait on this
-    // condition for reasons, so broadcast the condition.
-    mp_cond_broadcast(&queue->cond);
-    // No wakeup callback -> assume mp_dispatch_queue_process() needs to be
-    // interrupted instead.
-    if (!queue->wakeup_fn)
-        queue->interrupted = true;
+    bool wakeup = wakeup_locked(queue);
     mp_mutex_unlock(&queue->lock);
 
-    if (queue->wakeup_fn)
+    if (wakeup)
         queue->wakeup_fn(queue->wakeup_ctx);
 }
 
@@ -219,6 +282,7 @@ void mp_dispatch_cancel_fn(struct mp_dispatch_queue *queue,
                            mp_dispatch_fn fn, void *fn_data)
 {
     mp_mutex_lock(&queue->lock);
+    drain_incoming(queue);
     struct mp_dispatch_item **pcur = &queue->head;
     queue->tail = NULL;
     while (*pcur) {
@@ -280,6 +344,7 @@ void mp_dispatch_queue_process(struct mp_dispatch_queue *queue, double timeout)
     if (queue->lock_requests)
         mp_cond_broadcast(&queue->cond);
     while (1) {
+        drain_incoming(queue);
         if (queue->lock_requests) {
             // Block due to something having called mp_dispatch_lock().
             mp_cond_wait(&queue->cond, &queue->lock);
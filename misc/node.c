@@ -28,6 +28,18 @@ void node_init(struct mpv_node *dst, int format, struct mpv_node *parent)
         dst->u.ba = talloc_zero(ta_parent, struct mpv_byte_array);
 }
 
+// Init a MPV_FORMAT_NODE_MAP or MPV_FORMAT_NODE_ARRAY node without parent, whose
+// list is created as TA arena, so that the nodes added to it later don't need a
+// malloc() each. Use this only for trees that are built once and freed soon,
+// such as property values: the arena's memory is pinned until the last
+// allocation in it is freed.
+void node_init_arena(struct mpv_node *dst, int format)
+{
+    assert(format == MPV_FORMAT_NODE_MAP || format == MPV_FORMAT_NODE_ARRAY);
+    *dst = (struct mpv_node){ .format = format };
+    dst->u.list = talloc_zero_arena(NULL, struct mpv_node_list);
+}
+
 // Add an entry to a MPV_FORMAT_NODE_ARRAY.
 // m_option_type_node memory management rules apply.
 struct mpv_node *node_array_add(struct mpv_node *dst, int format)
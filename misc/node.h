@@ -5,6 +5,7 @@
 #include "misc/bstr.h"
 
 void node_init(struct mpv_node *dst, int format, struct mpv_node *parent);
+void node_init_arena(struct mpv_node *dst, int format);
 struct mpv_node *node_array_add(struct mpv_node *dst, int format);
 struct mpv_node *node_map_add(struct mpv_node *dst, const char *key, int format);
 struct mpv_node *node_map_badd(struct mpv_node *dst, struct bstr key, int format);
@@ -0,0 +1,401 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include <libavutil/cpu.h>
+
+#include "common/common.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
+
+#include "task_pool.h"
+
+#define MAX_WORKERS 64
+
+// Workers exit after this many seconds without work.
+#define DESTROY_TIMEOUT 10
+
+struct task {
+    void (*fn)(void *ctx);
+    void *fn_ctx;
+};
+
+// Ring buffer of tasks.
+struct task_queue {
+    struct task *tasks;
+    int start, num, alloc;
+    atomic_int size;            // copy of num, for checking without the lock
+};
+
+struct worker {
+    mp_mutex lock;              // protects queues
+    struct task_queue queues[MP_TASK_PRIORITY_COUNT];
+    int index;
+
+    // --- protected by pool.lock
+    mp_thread thread;
+    bool active;
+};
+
+static struct {
+    mp_mutex lock;
+    mp_cond wakeup;
+
+    int max_workers;
+
+    // --- protected by lock
+    int num_users;              // mp_task_pool_ref()
+    bool terminate;             // joining all workers
+    struct worker workers[MAX_WORKERS];
+
+    atomic_int num_workers;     // written with lock held
+    atomic_int num_sleeping;    // written with lock held
+    atomic_int num_wakeups;     // signaled sleepers that didn't wake up yet,
+                                // written with lock held
+    atomic_int pending;         // number of queued tasks
+
+    mp_mutex shared_lock;       // protects shared
+    struct task_queue shared[MP_TASK_PRIORITY_COUNT];
+} pool;
+
+static mp_once pool_once = MP_STATIC_ONCE_INITIALIZER;
+
+static _Thread_local struct worker *current_worker;
+
+// The queues are never freed, so use malloc instead of talloc to keep them out
+// of leak reports.
+static void queue_push(struct task_queue *q, struct task t)
+{
+    if (q->num == q->alloc) {
+        int alloc = MPMAX(16, q->alloc * 2);
+        struct task *tasks = malloc(alloc * sizeof(tasks[0]));
+        MP_HANDLE_OOM(tasks);
+        for (int n = 0; n < q->num; n++)
+            tasks[n] = q->tasks[(q->start + n) % q->alloc];
+        free(q->tasks);
+        q->tasks = tasks;
+        q->start = 0;
+        q->alloc = alloc;
+    }
+    q->tasks[(q->start + q->num) % q->alloc] = t;
+    q->num++;
+    atomic_store(&q->size, q->num);
+}
+
+// Remove the oldest task (front) or the newest one (back).
+static bool queue_pop(struct task_queue *q, bool front, struct task *t)
+{
+    if (!q->num)
+        return false;
+    q->num--;
+    if (front) {
+        *t = q->tasks[q->start];
+        q->start = (q->start + 1) % q->alloc;
+    } else {
+        *t = q->tasks[(q->start + q->num) % q->alloc];
+    }
+    atomic_store(&q->size, q->num);
+    return true;
+}
+
+static bool queue_pop_locked(mp_mutex *lock, struct task_queue *q, bool front,
+                             struct task *t)
+{
+    if (!atomic_load(&q->size))
+        return false;
+    mp_mutex_lock(lock);
+    bool r = queue_pop(q, front, t);
+    mp_mutex_unlock(lock);
+    return r;
+}
+
+static void init_pool(void)
+{
+    pool.max_workers = MPCLAMP(av_cpu_count(), 1, MAX_WORKERS);
+    mp_mutex_init(&pool.lock);
+    mp_cond_init(&pool.wakeup);
+    mp_mutex_init(&pool.shared_lock);
+    for (int n = 0; n < MAX_WORKERS; n++) {
+        mp_mutex_init(&pool.workers[n].lock);
+        pool.workers[n].index = n;
+    }
+}
+
+// Find the next task to run, highest priority first. Own tasks are taken
+// newest first, stolen ones oldest first. w is NULL if not called by a worker.
+static bool get_task(struct worker *w, struct task *t)
+{
+    int start = w ? w->index + 1 : 0;
+    for (int prio = 0; prio < MP_TASK_PRIORITY_COUNT; prio++) {
+        if (w && queue_pop_locked(&w->lock, &w->queues[prio], false, t))
+            goto found;
+        if (queue_pop_locked(&pool.shared_lock, &pool.shared[prio], true, t))
+            goto found;
+        for (int n = 0; n < pool.max_workers; n++) {
+            struct worker *v = &pool.workers[(start + n) % pool.max_workers];
+            if (v != w && queue_pop_locked(&v->lock, &v->queues[prio], true, t))
+                goto found;
+        }
+    }
+    return false;
+
+found:
+    atomic_fetch_add(&pool.pending, -1);
+    return true;
+}
+
+static MP_THREAD_VOID worker_thread(void *arg)
+{
+    struct worker *w = arg;
+
+    mp_thread_set_name("task");
+    current_worker = w;
+
+    int64_t destroy_deadline = 0;
+    while (1) {
+        struct task t;
+        if (get_task(w, &t)) {
+            t.fn(t.fn_ctx);
+            destroy_deadline = 0;
+            continue;
+        }
+
+        mp_mutex_lock(&pool.lock);
+        // Pairs with the check in wakeup_workers(): either we see the new
+        // pending task, or the submitter sees us sleeping.
+        atomic_fetch_add(&pool.num_sleeping, 1);
+        bool timeout = false;
+        while (!atomic_load(&pool.num_wakeups) && !atomic_load(&pool.pending) &&
+               !pool.terminate && !timeout)
+        {
+            if (!destroy_deadline)
+                destroy_deadline = mp_time_ns() + MP_TIME_S_TO_NS(DESTROY_TIMEOUT);
+            timeout = mp_cond_timedwait_until(&pool.wakeup, &pool.lock,
+                                              destroy_deadline);
+        }
+        // Whoever is awake takes the wakeup, even if it wasn't signaled itself
+        // (then the signaled worker goes back to sleep).
+        if (atomic_load(&pool.num_wakeups))
+            atomic_fetch_add(&pool.num_wakeups, -1);
+        atomic_fetch_add(&pool.num_sleeping, -1);
+        // Only the worker itself adds to its own queues, so they're empty.
+        if ((timeout || pool.terminate) && !atomic_load(&pool.pending)) {
+            // When terminating, mp_task_pool_unref() joins us.
+            if (!pool.terminate)
+                mp_thread_detach(w->thread);
+            w->active = false;
+            atomic_fetch_add(&pool.num_workers, -1);
+            mp_mutex_unlock(&pool.lock);
+            break;
+        }
+        mp_mutex_unlock(&pool.lock);
+    }
+
+    current_worker = NULL;
+    MP_THREAD_RETURN();
+}
+
+// Must be called with pool.lock held.
+static bool add_worker(void)
+{
+    if (pool.terminate)
+        return false;
+    for (int n = 0; n < pool.max_workers; n++) {
+        struct worker *w = &pool.workers[n];
+        if (w->active)
+            continue;
+        if (mp_thread_create(&w->thread, worker_thread, w))
+            return false;
+        w->active = true;
+        atomic_fetch_add(&pool.num_workers, 1);
+        return true;
+    }
+    return false;
+}
+
+// Wake up a sleeping worker for a new task, or create a new worker if all of
+// them are busy. Sleepers that were signaled, but didn't wake up yet, count as
+// busy: signaling them again would be lost. Returns false if there are no
+// workers at all.
+static bool wakeup_workers(void)
+{
+    if (atomic_load(&pool.num_sleeping) == atomic_load(&pool.num_wakeups) &&
+        atomic_load(&pool.num_workers) == pool.max_workers)
+        return true;
+
+    mp_mutex_lock(&pool.lock);
+    if (atomic_load(&pool.num_sleeping) > atomic_load(&pool.num_wakeups)) {
+        atomic_fetch_add(&pool.num_wakeups, 1);
+        mp_cond_signal(&pool.wakeup);
+    } else {
+        add_worker();
+    }
+    bool ok = atomic_load(&pool.num_workers) > 0;
+    mp_mutex_unlock(&pool.lock);
+    return ok;
+}
+
+void mp_task_queue(enum mp_task_priority prio, void (*fn)(void *ctx),
+                   void *fn_ctx)
+{
+    assert(prio >= 0 && prio < MP_TASK_PRIORITY_COUNT);
+    assert(fn);
+
+    mp_exec_once(&pool_once, init_pool);
+
+    struct task t = {fn, fn_ctx};
+    struct worker *w = current_worker;
+    if (w) {
+        mp_mutex_lock(&w->lock);
+        queue_push(&w->queues[prio], t);
+        mp_mutex_unlock(&w->lock);
+    } else {
+        mp_mutex_lock(&pool.shared_lock);
+        queue_push(&pool.shared[prio], t);
+        mp_mutex_unlock(&pool.shared_lock);
+    }
+    atomic_fetch_add(&pool.pending, 1);
+
+    if (!wakeup_workers() && !w) {
+        // Could not create a worker. Run the task here (it might be a
+        // different task of the same priority, which is fine).
+        if (queue_pop_locked(&pool.shared_lock, &pool.shared[prio], true, &t)) {
+            atomic_fetch_add(&pool.pending, -1);
+            t.fn(t.fn_ctx);
+        }
+    }
+}
+
+struct parallel_for {
+    void (*fn)(void *ctx, int index);
+    void *fn_ctx;
+    int count;
+    atomic_int next;            // next index to run
+    atomic_int done;            // number of finished calls
+    atomic_int refs;
+    mp_mutex lock;
+    mp_cond wakeup;             // signaled when done == count
+};
+
+static void parallel_for_unref(struct parallel_for *pf)
+{
+    if (atomic_fetch_add(&pf->refs, -1) == 1) {
+        mp_mutex_destroy(&pf->lock);
+        mp_cond_destroy(&pf->wakeup);
+        talloc_free(pf);
+    }
+}
+
+static void parallel_for_run(struct parallel_for *pf)
+{
+    int n;
+    while ((n = atomic_fetch_add(&pf->next, 1)) < pf->count) {
+        pf->fn(pf->fn_ctx, n);
+        if (atomic_fetch_add(&pf->done, 1) + 1 == pf->count) {
+            mp_mutex_lock(&pf->lock);
+            mp_cond_broadcast(&pf->wakeup);
+            mp_mutex_unlock(&pf->lock);
+        }
+    }
+}
+
+static void parallel_for_task(void *ptr)
+{
+    struct parallel_for *pf = ptr;
+    parallel_for_run(pf);
+    parallel_for_unref(pf);
+}
+
+void mp_task_parallel_for(enum mp_task_priority prio, int count, int max_jobs,
+                          void (*fn)(void *ctx, int index), void *fn_ctx)
+{
+    int helpers = MPMIN(count, max_jobs > 0 ? max_jobs : count) - 1;
+    helpers = MPMIN(helpers, mp_task_pool_max_threads());
+    if (helpers <= 0) {
+        for (int n = 0; n < count; n++)
+            fn(fn_ctx, n);
+        return;
+    }
+
+    // Helper tasks can start after all work is done, so the state must
+    // outlive this call.
+    struct parallel_for *pf = talloc_ptrtype(NULL, pf);
+    *pf = (struct parallel_for){
+        .fn = fn,
+        .fn_ctx = fn_ctx,
+        .count = count,
+    };
+    atomic_init(&pf->refs, helpers + 1);
+    mp_mutex_init(&pf->lock);
+    mp_cond_init(&pf->wakeup);
+
+    for (int n = 0; n < helpers; n++)
+        mp_task_queue(prio, parallel_for_task, pf);
+
+    parallel_for_run(pf);
+
+    mp_mutex_lock(&pf->lock);
+    while (atomic_load(&pf->done) < count)
+        mp_cond_wait(&pf->wakeup, &pf->lock);
+    mp_mutex_unlock(&pf->lock);
+
+    parallel_for_unref(pf);
+}
+
+int mp_task_pool_max_threads(void)
+{
+    mp_exec_once(&pool_once, init_pool);
+    return pool.max_workers;
+}
+
+void mp_task_pool_ref(void)
+{
+    mp_exec_once(&pool_once, init_pool);
+    mp_mutex_lock(&pool.lock);
+    pool.num_users++;
+    mp_mutex_unlock(&pool.lock);
+}
+
+void mp_task_pool_unref(void)
+{
+    mp_thread threads[MAX_WORKERS];
+    int num_threads = 0;
+
+    mp_mutex_lock(&pool.lock);
+    assert(pool.num_users > 0);
+    pool.num_users--;
+    if (pool.num_users || pool.terminate) {
+        mp_mutex_unlock(&pool.lock);
+        return;
+    }
+    pool.terminate = true;
+    for (int n = 0; n < pool.max_workers; n++) {
+        if (pool.workers[n].active)
+            threads[num_threads++] = pool.workers[n].thread;
+    }
+    mp_cond_broadcast(&pool.wakeup);
+    mp_mutex_unlock(&pool.lock);
+
+    for (int n = 0; n < num_threads; n++)
+        mp_thread_join(threads[n]);
+
+    mp_mutex_lock(&pool.lock);
+    pool.terminate = false;
+    mp_mutex_unlock(&pool.lock);
+}
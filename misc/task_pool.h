@@ -0,0 +1,50 @@
+#ifndef MPV_MP_TASK_POOL_H
+#define MPV_MP_TASK_POOL_H
+
+// Process-wide pool of worker threads for CPU-bound work, shared by all
+// subsystems. There is at most one worker per CPU core. Workers are created on
+// demand, and exit after some time without work.
+//
+// Each worker has its own task deque. Tasks queued from a worker thread go to
+// the worker's own deque and are run in LIFO order, while idle workers steal
+// the oldest tasks from other workers. Tasks queued from other threads go to a
+// shared FIFO queue.
+//
+// Tasks are picked by priority class first. A running task is never preempted,
+// so the priorities only affect which queued task runs next.
+//
+// Tasks must not block for long (e.g. on network I/O); use mp_thread_pool for
+// that.
+
+enum mp_task_priority {
+    MP_TASK_REALTIME,   // audio/video output and conversion on the frame path
+    MP_TASK_NORMAL,
+    MP_TASK_BACKGROUND, // scanning, precomputing, things nobody waits for
+    MP_TASK_PRIORITY_COUNT,
+};
+
+// Queue fn(fn_ctx) to be run on a worker thread. This function always succeeds
+// and is thread-safe. If no worker thread could be created, fn is run on the
+// calling thread before returning.
+void mp_task_queue(enum mp_task_priority prio, void (*fn)(void *ctx),
+                   void *fn_ctx);
+
+// Run fn(fn_ctx, n) for each n in [0, count), and return once all calls are
+// done. The calls are distributed over the calling thread and up to
+// max_jobs - 1 worker threads (max_jobs <= 0 means no limit). The calling
+// thread always takes part, so this can be used from within tasks, and never
+// waits for a worker to become available.
+void mp_task_parallel_for(enum mp_task_priority prio, int count, int max_jobs,
+                          void (*fn)(void *ctx, int index), void *fn_ctx);
+
+// Maximum number of worker threads.
+int mp_task_pool_max_threads(void);
+
+// Users that need the worker threads to be gone at some point (e.g. libmpv
+// before it might be unloaded) hold a reference. Releasing the last reference
+// waits until all queued tasks are done, and joins the worker threads. The
+// pool can still be used afterwards.
+void mp_task_pool_ref(void);
+void mp_task_pool_unref(void);
+
+#endif
@@ -1057,7 +1057,7 @@ void m_config_finish_default_profile(struct m_config *config, int flags)
 struct mpv_node m_config_get_profiles(struct m_config *config)
 {
     struct mpv_node root;
-    node_init(&root, MPV_FORMAT_NODE_ARRAY, NULL);
+    node_init_arena(&root, MPV_FORMAT_NODE_ARRAY);
 
     for (m_profile_t *profile = config->profiles; profile; profile = profile->next)
     {
@@ -474,7 +474,7 @@ int m_property_read_sub(const struct m_sub_property *props, int action, void *ar
     case M_PROPERTY_GET: {
         struct mpv_node node;
         node.format = MPV_FORMAT_NODE_MAP;
-        node.u.list = talloc_zero(NULL, mpv_node_list);
+        node.u.list = talloc_zero_arena(NULL, mpv_node_list);
         mpv_node_list *list = node.u.list;
         for (int n = 0; props && props[n].name; n++) {
             const struct m_sub_property *prop = &props[n];
@@ -560,7 +560,7 @@ int m_property_read_list(int action, void *arg, int count,
     case M_PROPERTY_GET: {
         struct mpv_node node;
         node.format = MPV_FORMAT_NODE_ARRAY;
-        node.u.list = talloc_zero(NULL, mpv_node_list);
+        node.u.list = talloc_zero_arena(NULL, mpv_node_list);
         node.u.list->num = count;
         node.u.list->values = talloc_array(node.u.list, mpv_node, count);
         for (int n = 0; n < count; n++) {
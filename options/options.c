@@ -62,6 +62,7 @@ extern const struct m_sub_options stream_bluray_conf;
 extern const struct m_sub_options stream_cdda_conf;
 extern const struct m_sub_options stream_dvb_conf;
 extern const struct m_sub_options stream_lavf_conf;
+extern const struct m_sub_options stream_file_conf;
 extern const struct m_sub_options sws_conf;
 extern const struct m_sub_options zimg_conf;
 extern const struct m_sub_options drm_conf;
@@ -500,10 +501,15 @@ static const m_option_t mp_opts[] = {
         .flags = M_OPT_PRE_PARSE | UPDATE_TERM},
     {"dump-stats", OPT_STRING(dump_stats),
         .flags = UPDATE_TERM | M_OPT_PRE_PARSE | M_OPT_FILE},
+    {"dump-trace", OPT_STRING(dump_trace),
+        .flags = UPDATE_TERM | M_OPT_PRE_PARSE | M_OPT_FILE},
+    {"startup-profile", OPT_BOOL(startup_profile)},
     {"msg-color", OPT_BOOL(msg_color), .flags = M_OPT_PRE_PARSE | UPDATE_TERM},
 #ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
     {"log-file", OPT_STRING(log_file),
         .flags = M_OPT_PRE_PARSE | M_OPT_FILE | UPDATE_TERM},
+    {"log-file-format", OPT_CHOICE(log_file_format, {"text", 0}, {"binary", 1}),
+        .flags = M_OPT_PRE_PARSE | UPDATE_TERM},
 #endif
     {"msg-module", OPT_BOOL(msg_module), .flags = UPDATE_TERM},
     {"msg-time", OPT_BOOL(msg_time), .flags = UPDATE_TERM},
@@ -548,6 +554,8 @@ static const m_option_t mp_opts[] = {
         OPT_CHOICE(lua_load_auto_profiles, {"no", 0}, {"yes", 1}, {"auto", -1}),
         .flags = UPDATE_BUILTIN_SCRIPTS},
     {"load-select", OPT_BOOL(lua_load_select), .flags = UPDATE_BUILTIN_SCRIPTS},
+    {"lazy-builtin-scripts", OPT_BOOL(lua_lazy_builtin_scripts),
+        .flags = UPDATE_BUILTIN_SCRIPTS},
 #endif
 
 // ------------------------- stream options --------------------
@@ -632,6 +640,7 @@ static const m_option_t mp_opts[] = {
     {"demuxer-termination-timeout", OPT_DOUBLE(demux_termination_timeout)},
     {"demuxer-cache-wait", OPT_BOOL(demuxer_cache_wait)},
     {"prefetch-playlist", OPT_BOOL(prefetch_open)},
+    {"prefetch-decoders", OPT_BOOL(prefetch_decoders)},
     {"cache-pause", OPT_BOOL(cache_pause)},
     {"cache-pause-initial", OPT_BOOL(cache_pause_initial)},
     {"cache-pause-wait", OPT_FLOAT(cache_pause_wait), M_RANGE(0, FLT_MAX)},
@@ -640,6 +649,7 @@ static const m_option_t mp_opts[] = {
     {"dvbin", OPT_SUBSTRUCT(stream_dvb_opts, stream_dvb_conf)},
 #endif
     {"", OPT_SUBSTRUCT(stream_lavf_opts, stream_lavf_conf)},
+    {"", OPT_SUBSTRUCT(stream_file_opts, stream_file_conf)},
 
 // ------------------------- a-v sync options --------------------
 
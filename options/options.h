@@ -150,6 +150,8 @@ typedef struct MPOpts {
     bool property_print_help;
     bool use_terminal;
     char *dump_stats;
+    char *dump_trace;
+    bool startup_profile;
     int verbose;
     bool msg_really_quiet;
     char **msg_levels;
@@ -157,6 +159,7 @@ typedef struct MPOpts {
     bool msg_module;
     bool msg_time;
     char *log_file;
+    int log_file_format;
 
     int operation_mode;
 
@@ -172,6 +175,7 @@ typedef struct MPOpts {
     bool lua_load_console;
     int lua_load_auto_profiles;
     bool lua_load_select;
+    bool lua_lazy_builtin_scripts;
 
     bool auto_load_scripts;
 
@@ -297,6 +301,7 @@ typedef struct MPOpts {
     double demux_termination_timeout;
     bool demuxer_cache_wait;
     bool prefetch_open;
+    bool prefetch_decoders;
     char *audio_demuxer_name;
     char *sub_demuxer_name;
 
@@ -344,6 +349,7 @@ typedef struct MPOpts {
     struct cdda_opts *stream_cdda_opts;
     struct dvb_opts *stream_dvb_opts;
     struct lavf_opts *stream_lavf_opts;
+    struct stream_file_opts *stream_file_opts;
 
     char *bluray_device;
 
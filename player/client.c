@@ -257,6 +257,22 @@ bool mp_client_id_exists(struct MPContext *mpctx, int64_t id)
     return r;
 }
 
+// Whether the client has started waiting for events (see
+// mp_clients_all_initialized()). Returns true if the client doesn't exist.
+bool mp_client_id_initialized(struct MPContext *mpctx, int64_t id)
+{
+    bool r = true;
+    mp_mutex_lock(&mpctx->clients->lock);
+    struct mpv_handle *ctx = find_client_id(mpctx->clients, id);
+    if (ctx) {
+        mp_mutex_lock(&ctx->lock);
+        r = ctx->fuzzy_initialized;
+        mp_mutex_unlock(&ctx->lock);
+    }
+    mp_mutex_unlock(&mpctx->clients->lock);
+    return r;
+}
+
 struct mpv_handle *mp_new_client(struct mp_client_api *clients, const char *name)
 {
     mp_mutex_lock(&clients->lock);
@@ -147,6 +147,7 @@ struct hook_handler {
     int priority;   // priority for global hook order
     int64_t seq;    // unique ID, != 0, also for fixed order on equal priorities
     bool active;    // hook is currently in progress (only 1 at a time for now)
+    bool lazy;      // placeholder for a builtin script that isn't loaded yet
 };
 
 enum load_action_type {
@@ -174,6 +175,7 @@ static int set_filters(struct MPContext *mpctx, enum stream_type mediatype,
                        struct m_obj_settings *new_chain);
 
 static bool is_property_set(int action, void *val);
+static int run_next_hook_handler(struct MPContext *mpctx, char *type, int start);
 
 static void hook_remove(struct MPContext *mpctx, struct hook_handler *h)
 {
@@ -194,6 +196,15 @@ bool mp_hook_test_completion(struct MPContext *mpctx, char *type)
     for (int n = 0; n < cmd->num_hooks; n++) {
         struct hook_handler *h = cmd->hooks[n];
         if (h->active && strcmp(h->type, type) == 0) {
+            if (h->lazy) {
+                // The script was loaded by the placeholder. Once it has added
+                // its own hooks, continue with them.
+                if (mp_client_id_initialized(mpctx, h->client_id)) {
+                    hook_remove(mpctx, h);
+                    run_next_hook_handler(mpctx, type, n);
+                }
+                return false;
+            }
             if (!mp_client_id_exists(mpctx, h->client_id)) {
                 MP_WARN(mpctx, "client removed during hook handling\n");
                 // Trigger completion of this hook and continue with the next one.
@@ -208,6 +219,19 @@ bool mp_hook_test_completion(struct MPContext *mpctx, char *type)
 
 static int invoke_hook_handler(struct MPContext *mpctx, struct hook_handler *h)
 {
+    if (h->lazy) {
+        int64_t id = mp_lazy_builtin_script_hook(mpctx, h->client);
+        if (id < 0) {
+            hook_remove(mpctx, h);
+            return -1;
+        }
+        if (!id)
+            return 1; // skip
+        h->client_id = id;
+        h->active = true;
+        return 0;
+    }
+
     MP_VERBOSE(mpctx, "Running hook: %s/%s\n", h->client, h->type);
     h->active = true;
 
@@ -243,6 +267,8 @@ static int run_next_hook_handler(struct MPContext *mpctx, char *type, int start)
                 --n;
                 continue;
             }
+            if (ret > 0)
+                continue;
             return ret;
         }
     }
@@ -303,6 +329,25 @@ void mp_hook_add(struct MPContext *mpctx, char *client, int64_t client_id,
     qsort(cmd->hooks, cmd->num_hooks, sizeof(cmd->hooks[0]), compare_hook);
 }
 
+// Add a placeholder hook for a builtin script that is loaded on first use. When
+// the hook runs, the script may be loaded, and its own hooks are run instead.
+void mp_hook_add_lazy(struct MPContext *mpctx, const char *client,
+                      const char *name, int pri)
+{
+    struct command_ctx *cmd = mpctx->command_ctx;
+    for (int n = 0; n < cmd->num_hooks; n++) {
+        struct hook_handler *h = cmd->hooks[n];
+        if (h->lazy && strcmp(h->client, client) == 0 &&
+            strcmp(h->type, name) == 0)
+            return;
+    }
+    mp_hook_add(mpctx, (char *)client, 0, name, 0, pri);
+    for (int n = 0; n < cmd->num_hooks; n++) {
+        if (cmd->hooks[n]->seq == cmd->hook_seq)
+            cmd->hooks[n]->lazy = true;
+    }
+}
+
 // Call before a seek, in order to allow revert-seek to undo the seek.
 void mark_seek(struct MPContext *mpctx)
 {
@@ -705,6 +750,15 @@ static int mp_property_duration(void *ctx, struct m_property *prop,
     return property_time(action, arg, len);
 }
 
+static int mp_property_transition_gap(void *ctx, struct m_property *prop,
+                                      int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (mpctx->transition_gap < 0)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_double_ro(action, arg, mpctx->transition_gap);
+}
+
 static int mp_property_avsync(void *ctx, struct m_property *prop,
                               int action, void *arg)
 {
@@ -1551,7 +1605,7 @@ static int mp_property_demuxer_cache_state(void *ctx, struct m_property *prop,
     demux_get_reader_state(mpctx->demuxer, &s);
 
     struct mpv_node *r = (struct mpv_node *)arg;
-    node_init(r, MPV_FORMAT_NODE_MAP, NULL);
+    node_init_arena(r, MPV_FORMAT_NODE_MAP);
 
     if (s.ts_info.end != MP_NOPTS_VALUE)
         node_map_add_double(r, "cache-end", s.ts_info.end);
@@ -2904,7 +2958,7 @@ static int mp_property_vo_passes(void *ctx, struct m_property *prop,
 
     case M_PROPERTY_GET: {
         struct mpv_node node;
-        node_init(&node, MPV_FORMAT_NODE_MAP, NULL);
+        node_init_arena(&node, MPV_FORMAT_NODE_MAP);
         struct mpv_node *fresh = node_map_add(&node, "fresh", MPV_FORMAT_NODE_ARRAY);
         struct mpv_node *redraw = node_map_add(&node, "redraw", MPV_FORMAT_NODE_ARRAY);
         get_frame_perf(fresh, &data->fresh);
@@ -2935,6 +2989,23 @@ static int mp_property_perf_info(void *ctx, struct m_property *p, int action,
     return M_PROPERTY_NOT_IMPLEMENTED;
 }
 
+static int mp_property_trace_events(void *ctx, struct m_property *p,
+                                    int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+
+    switch (action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET: {
+        stats_trace_query(mpctx->global, (struct mpv_node *)arg);
+        return M_PROPERTY_OK;
+    }
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
 static int mp_property_vo(void *ctx, struct m_property *p, int action, void *arg)
 {
     MPContext *mpctx = ctx;
@@ -3034,7 +3105,7 @@ static int mp_property_mouse_pos(void *ctx, struct m_property *prop,
         int x, y, hover;
         mp_input_get_mouse_pos(mpctx->input, &x, &y, &hover);
 
-        node_init(&node, MPV_FORMAT_NODE_MAP, NULL);
+        node_init_arena(&node, MPV_FORMAT_NODE_MAP);
         node_map_add_int64(&node, "x", x);
         node_map_add_int64(&node, "y", y);
         node_map_add_flag(&node, "hover", hover);
@@ -3380,6 +3451,13 @@ static int mp_property_playlist_path(void *ctx, struct m_property *prop,
     return m_property_strdup_ro(action, arg, e->playlist_path);
 }
 
+static int mp_property_playlist_generation(void *ctx, struct m_property *prop,
+                                           int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    return m_property_int64_ro(action, arg, mpctx->playlist->generation);
+}
+
 static int mp_property_playlist(void *ctx, struct m_property *prop,
                                 int action, void *arg)
 {
@@ -3388,8 +3466,9 @@ static int mp_property_playlist(void *ctx, struct m_property *prop,
         struct playlist *pl = mpctx->playlist;
         char *res = talloc_strdup(NULL, "");
 
-        for (int n = 0; n < pl->num_entries; n++) {
-            struct playlist_entry *e = pl->entries[n];
+        for (struct playlist_entry *e = playlist_get_first(pl); e;
+             e = playlist_entry_get_rel(e, 1))
+        {
             if (pl->current == e)
                 res = append_selected_style(mpctx, res);
             const char *reset = pl->current == e ? get_style_reset(mpctx) : "";
@@ -3858,7 +3937,7 @@ static int mp_property_commands(void *ctx, struct m_property *prop,
         return M_PROPERTY_OK;
     case M_PROPERTY_GET: {
         struct mpv_node *root = arg;
-        node_init(root, MPV_FORMAT_NODE_ARRAY, NULL);
+        node_init_arena(root, MPV_FORMAT_NODE_ARRAY);
 
         for (int n = 0; mp_cmds[n].name; n++) {
             const struct mp_cmd_def *cmd = &mp_cmds[n];
@@ -4165,7 +4244,7 @@ static int mp_property_clipboard(void *ctx, struct m_property *prop,
     case M_PROPERTY_GET:
     case M_PROPERTY_GET_NODE: {
         struct mpv_node node;
-        node_init(&node, MPV_FORMAT_NODE_MAP, NULL);
+        node_init_arena(&node, MPV_FORMAT_NODE_MAP);
         char *data = NULL;
         if (get_clipboard(mpctx, &data, &params) == M_PROPERTY_OK) {
             node_map_add_string(&node, "text", data);
@@ -4233,6 +4312,7 @@ static const struct m_property mp_properties_base[] = {
     {"stream-end", mp_property_stream_end},
     {"duration", mp_property_duration},
     {"avsync", mp_property_avsync},
+    {"transition-gap", mp_property_transition_gap},
     {"total-avsync-change", mp_property_total_avsync_change},
     {"mistimed-frame-count", mp_property_mistimed_frame_count},
     {"vsync-ratio", mp_property_vsync_ratio},
@@ -4291,6 +4371,7 @@ static const struct m_property mp_properties_base[] = {
     {"playlist-pos-1", mp_property_playlist_pos_1},
     {"playlist-current-pos", mp_property_playlist_current_pos},
     {"playlist-playing-pos", mp_property_playlist_playing_pos},
+    {"playlist-generation", mp_property_playlist_generation},
     M_PROPERTY_ALIAS("playlist-count", "playlist/count"),
 
     // Audio
@@ -4325,6 +4406,7 @@ static const struct m_property mp_properties_base[] = {
     {"vo-configured", mp_property_vo_configured},
     {"vo-passes", mp_property_vo_passes},
     {"perf-info", mp_property_perf_info},
+    {"trace-events", mp_property_trace_events},
     {"current-vo", mp_property_vo},
     {"current-gpu-context", mp_property_gpu_context},
     {"container-fps", mp_property_fps},
@@ -4484,7 +4566,7 @@ static const char *const *const mp_event_property_change[] = {
     E(MP_EVENT_AMBIENT_LIGHTING_CHANGED, "ambient-light"),
     E(MP_EVENT_CHANGE_PLAYLIST, "playlist", "playlist-pos", "playlist-pos-1",
       "playlist-count", "playlist/count", "playlist-current-pos",
-      "playlist-playing-pos"),
+      "playlist-playing-pos", "playlist-generation"),
     E(MP_EVENT_INPUT_PROCESSED, "mouse-pos", "touch-pos"),
     E(MP_EVENT_CORE_IDLE, "core-idle", "eof-reached"),
 };
@@ -6101,6 +6183,77 @@ static void cmd_playlist_move(void *p)
     mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
 }
 
+static void add_playlist_change_entry(struct mpv_node *list, uint64_t id,
+                                      const char *filename, const char *title,
+                                      const char *playlist_path)
+{
+    struct mpv_node *e = node_array_add(list, MPV_FORMAT_NODE_MAP);
+    node_map_add_string(e, "filename", filename);
+    if (title)
+        node_map_add_string(e, "title", title);
+    node_map_add_int64(e, "id", id);
+    if (playlist_path)
+        node_map_add_string(e, "playlist-path", playlist_path);
+}
+
+static const char *const playlist_change_names[] = {
+    [PLAYLIST_CHANGE_INSERT] = "insert",
+    [PLAYLIST_CHANGE_REMOVE] = "remove",
+    [PLAYLIST_CHANGE_MOVE]   = "move",
+    [PLAYLIST_CHANGE_UPDATE] = "update",
+};
+
+static void cmd_playlist_changes(void *p)
+{
+    struct mp_cmd_ctx *cmd = p;
+    struct MPContext *mpctx = cmd->mpctx;
+    struct playlist *pl = mpctx->playlist;
+    int64_t since = cmd->args[0].v.i64;
+
+    struct playlist_change **changes;
+    int num_changes;
+    bool ok = playlist_get_changes(pl, since, &changes, &num_changes) &&
+              since >= 0;
+
+    struct mpv_node *res = &cmd->result;
+    node_init(res, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_int64(res, "generation", pl->generation);
+
+    if (!ok) {
+        // The client has to start over with a full copy of the playlist.
+        node_map_add_flag(res, "reset", true);
+        struct mpv_node *list = node_map_add(res, "entries", MPV_FORMAT_NODE_ARRAY);
+        for (struct playlist_entry *e = playlist_get_first(pl); e;
+             e = playlist_entry_get_rel(e, 1))
+        {
+            add_playlist_change_entry(list, e->id, e->filename, e->title,
+                                      e->playlist_path);
+        }
+        return;
+    }
+
+    struct mpv_node *list = node_map_add(res, "changes", MPV_FORMAT_NODE_ARRAY);
+    for (int n = 0; n < num_changes; n++) {
+        struct playlist_change *c = changes[n];
+        struct mpv_node *cn = node_array_add(list, MPV_FORMAT_NODE_MAP);
+        node_map_add_string(cn, "op", playlist_change_names[c->op]);
+        node_map_add_int64(cn, "generation", c->generation);
+        node_map_add_int64(cn, "index", c->index);
+        node_map_add_int64(cn, "count", c->count);
+        if (c->op == PLAYLIST_CHANGE_MOVE)
+            node_map_add_int64(cn, "to", c->to);
+        if (c->op == PLAYLIST_CHANGE_INSERT || c->op == PLAYLIST_CHANGE_UPDATE) {
+            struct mpv_node *entries =
+                node_map_add(cn, "entries", MPV_FORMAT_NODE_ARRAY);
+            for (int i = 0; i < c->count; i++) {
+                struct playlist_change_entry *e = &c->entries[i];
+                add_playlist_change_entry(entries, e->id, e->filename, e->title,
+                                          e->playlist_path);
+            }
+        }
+    }
+}
+
 static void cmd_playlist_shuffle(void *p)
 {
     struct mp_cmd_ctx *cmd = p;
@@ -6586,6 +6739,9 @@ static void cmd_script_binding(void *p)
         target = space;
         name = sep + 1;
     }
+    if (target)
+        mp_load_lazy_builtin_script(mpctx, target);
+
     char state[4] = {'p', incmd->is_mouse_button ? 'm' : '-',
                           incmd->canceled ? 'c' : '-'};
     if (incmd->is_up_down)
@@ -6622,6 +6778,8 @@ static void cmd_script_message_to(void *p)
     struct mp_cmd_ctx *cmd = p;
     struct MPContext *mpctx = cmd->mpctx;
 
+    mp_load_lazy_builtin_script(mpctx, cmd->args[0].v.s);
+
     mpv_event_client_message *event = talloc_ptrtype(NULL, event);
     *event = (mpv_event_client_message){0};
     for (int n = 1; n < cmd->num_args; n++) {
@@ -7231,6 +7389,9 @@ const struct mp_cmd_def mp_cmds[] = {
             .flags = MP_CMD_OPT_ARG, M_RANGE(0, INT_MAX)}, }},
     { "playlist-move", cmd_playlist_move,  { {"index1", OPT_INT(v.i)},
                                              {"index2", OPT_INT(v.i)}, }},
+    { "playlist-changes", cmd_playlist_changes, {
+        {"generation", OPT_INT64(v.i64), OPTDEF_INT64(-1),
+            .flags = MP_CMD_OPT_ARG}, }},
     { "run", cmd_run, { {"command", OPT_STRING(v.s)},
                         {"args", OPT_STRING(v.s)}, },
         .vararg = true,
@@ -7559,7 +7720,10 @@ static void command_event(struct MPContext *mpctx, int event, void *arg)
             const char *const name = find_non_filename_media_title(mpctx);
             if (name && name[0]) {
                 pe->title = talloc_strdup(pe, name);
+                if (pe->pl)
+                    playlist_entry_changed(pe->pl, pe);
                 mp_notify_property(mpctx, "playlist");
+                mp_notify_property(mpctx, "playlist-generation");
             }
         }
     }
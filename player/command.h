@@ -115,6 +115,8 @@ enum {
 bool mp_hook_test_completion(struct MPContext *mpctx, char *type);
 void mp_hook_start(struct MPContext *mpctx, char *type);
 int mp_hook_continue(struct MPContext *mpctx, int64_t client_id, uint64_t id);
+void mp_hook_add_lazy(struct MPContext *mpctx, const char *client,
+                      const char *name, int pri);
 void mp_hook_add(struct MPContext *mpctx, char *client, int64_t client_id,
                  const char *name, uint64_t user_id, int pri);
 
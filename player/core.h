@@ -233,6 +233,13 @@ extern const int num_ptracks[STREAM_TYPE_COUNT];
 // Maximum of all num_ptracks[] values.
 #define MAX_PTRACKS 2
 
+// A decoder created ahead for the next playlist entry (--prefetch-decoders).
+struct decoder_ahead {
+    struct sh_stream *stream;
+    struct mp_decoder_wrapper *dec;
+    char *opts;     // decoder options it was created with, owned by dec->f
+};
+
 typedef struct MPContext {
     bool initialized;
     bool is_cli;
@@ -241,6 +248,7 @@ typedef struct MPContext {
     struct MPOpts *opts;
     struct mp_log *log;
     struct stats_ctx *stats;
+    struct stats_handle *stats_iterations;
     struct m_config *mconfig;
     struct input_ctx *input;
     struct mp_client_api *clients;
@@ -254,6 +262,7 @@ typedef struct MPContext {
     int64_t outstanding_async;
 
     struct mp_thread_pool *thread_pool; // for coarse I/O, often during loading
+    struct external_files_cache *external_files_cache;
 
     struct mp_log *statusline;
     struct osd_state *osd;
@@ -444,6 +453,16 @@ typedef struct MPContext {
     struct mp_ipc_ctx *ipc_ctx;
 
     int64_t builtin_script_ids[6];
+    // Builtin script is enabled, but waits for its first use before loading
+    // (--lazy-builtin-scripts).
+    bool builtin_script_pending[6];
+
+    // --startup-profile: startup phases, recorded until the first file starts
+    // playing.
+    int64_t startup_time;
+    struct startup_phase *startup_phases;
+    int num_startup_phases;
+    bool startup_profile_done;
 
     mp_mutex abort_lock;
 
@@ -463,10 +482,26 @@ typedef struct MPContext {
     char *open_format;
     int open_url_flags;
     bool open_for_prefetch;
+    bool open_decode_ahead;         // --prefetch-decoders
+    bool open_decode_video;         // also for video (no hwdec)
+    char *open_dec_opts[STREAM_TYPE_COUNT]; // see get_decoder_opts()
+    bool open_rebase_start_time;
     // --- All fields below are owned by open_thread, unless open_done was set
     //     to true.
     struct demuxer *open_res_demuxer;
     int open_res_error;
+    // Filter root with decoders for open_res_demuxer, which decode ahead.
+    struct mp_filter *open_res_filter_root;
+    struct decoder_ahead open_res_decs[STREAM_TYPE_COUNT];
+
+    // Decoders taken from the prefetched file, which init_video_decoder() and
+    // init_audio_decoder() use instead of creating new ones.
+    struct decoder_ahead prefetched_decs[STREAM_TYPE_COUNT];
+
+    // Playlist transitions: time the last file ended (0 if it wasn't at EOF),
+    // and time from then until playback of the next file started.
+    int64_t transition_start;
+    double transition_gap;          // in ms, <0 if unknown
 } MPContext;
 
 // Contains information about an asynchronous work item, how it can be aborted,
@@ -552,6 +587,8 @@ void autoload_external_files(struct MPContext *mpctx, struct mp_cancel *cancel);
 struct track *select_default_track(struct MPContext *mpctx, int order,
                                    enum stream_type type);
 void prefetch_next(struct MPContext *mpctx);
+struct mp_decoder_wrapper *take_prefetched_decoder(struct MPContext *mpctx,
+                                                   struct track *track);
 void update_lavfi_complex(struct MPContext *mpctx);
 
 // main.c
@@ -576,6 +613,8 @@ int stream_dump(struct MPContext *mpctx, const char *source_filename);
 double get_track_seek_offset(struct MPContext *mpctx, struct track *track);
 bool str_in_list(bstr str, char **list);
 char *mp_format_track_metadata(void *ctx, struct track *t, bool add_lang);
+void mp_startup_phase(struct MPContext *mpctx, const char *name, int64_t start);
+void mp_startup_report(struct MPContext *mpctx);
 
 // osd.c
 void set_osd_bar(struct MPContext *mpctx, int type,
@@ -640,6 +679,8 @@ struct mp_scripting {
 };
 bool mp_load_scripts(struct MPContext *mpctx);
 void mp_load_builtin_scripts(struct MPContext *mpctx);
+int64_t mp_load_lazy_builtin_script(struct MPContext *mpctx, const char *name);
+int64_t mp_lazy_builtin_script_hook(struct MPContext *mpctx, const char *name);
 int64_t mp_load_user_script(struct MPContext *mpctx, const char *fname);
 
 // sub.c
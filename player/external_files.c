@@ -18,22 +18,159 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <time.h>
+#include <sys/stat.h>
 
 #include "osdep/io.h"
+#include "osdep/threads.h"
 
 #include "common/common.h"
 #include "common/global.h"
 #include "common/msg.h"
 #include "misc/charset_conv.h"
 #include "misc/language.h"
+#include "misc/thread_pool.h"
 #include "options/options.h"
 #include "options/path.h"
 #include "player/core.h"
 #include "external_files.h"
 
+// Maximum number of directory listings kept in external_files_cache.
+#define MAX_CACHED_DIRS 64
+
 // Needed for mp_might_be_subtitle_file
 char **sub_exts;
 
+// Immutable list of the names in a directory.
+struct dir_listing {
+    char *path;
+    time_t mtime;
+    char **names;
+    int num_names;
+    uint64_t last_use;
+    int refs;           // protected by external_files_cache.lock
+};
+
+struct external_files_cache {
+    mp_mutex lock;
+    struct dir_listing **dirs;
+    int num_dirs;
+    uint64_t use_counter;
+};
+
+static void cache_destroy(void *p)
+{
+    struct external_files_cache *cache = p;
+    mp_mutex_destroy(&cache->lock);
+}
+
+// Create a cache for directory listings, which is used by find_external_files()
+// to avoid listing the same directories again for every loaded file. Cached
+// listings are reused until the modification time of the directory changes.
+struct external_files_cache *external_files_cache_create(void *ta_parent)
+{
+    struct external_files_cache *cache = talloc_zero(ta_parent, struct external_files_cache);
+    mp_mutex_init(&cache->lock);
+    talloc_set_destructor(cache, cache_destroy);
+    return cache;
+}
+
+static struct dir_listing *read_dir_listing(const char *path, time_t mtime)
+{
+    DIR *d = opendir(path);
+    if (!d)
+        return NULL;
+    struct dir_listing *list = talloc_zero(NULL, struct dir_listing);
+    list->path = talloc_strdup(list, path);
+    list->mtime = mtime;
+    list->refs = 1;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        MP_TARRAY_APPEND(list, list->names, list->num_names,
+                         talloc_strdup(list, de->d_name));
+    }
+    closedir(d);
+    return list;
+}
+
+static void release_dir_listing(struct external_files_cache *cache,
+                                struct dir_listing *list)
+{
+    if (cache)
+        mp_mutex_lock(&cache->lock);
+    bool last = --list->refs == 0;
+    if (cache)
+        mp_mutex_unlock(&cache->lock);
+    if (last)
+        talloc_free(list);
+}
+
+// Must be called with cache->lock held.
+static void drop_cached_listing(struct external_files_cache *cache, int index)
+{
+    struct dir_listing *list = cache->dirs[index];
+    MP_TARRAY_REMOVE_AT(cache->dirs, cache->num_dirs, index);
+    if (--list->refs == 0)
+        talloc_free(list);
+}
+
+// Return the names in the directory, or NULL if it can't be listed. Release the
+// result with release_dir_listing(). cache can be NULL.
+static struct dir_listing *get_dir_listing(struct external_files_cache *cache,
+                                           const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+        return NULL;
+
+    if (cache) {
+        mp_mutex_lock(&cache->lock);
+        for (int n = 0; n < cache->num_dirs; n++) {
+            struct dir_listing *list = cache->dirs[n];
+            if (strcmp(list->path, path) == 0) {
+                if (list->mtime == st.st_mtime) {
+                    list->last_use = ++cache->use_counter;
+                    list->refs++;
+                    mp_mutex_unlock(&cache->lock);
+                    return list;
+                }
+                drop_cached_listing(cache, n);
+                break;
+            }
+        }
+        mp_mutex_unlock(&cache->lock);
+    }
+
+    struct dir_listing *list = read_dir_listing(path, st.st_mtime);
+
+    // The mtime has a resolution of 1 second (or worse), so a directory that
+    // was changed very recently could change again without a different mtime.
+    if (!cache || !list || time(NULL) - st.st_mtime < 2)
+        return list;
+
+    mp_mutex_lock(&cache->lock);
+    for (int n = 0; n < cache->num_dirs; n++) {
+        // Read concurrently by someone else.
+        if (strcmp(cache->dirs[n]->path, path) == 0) {
+            drop_cached_listing(cache, n);
+            break;
+        }
+    }
+    if (cache->num_dirs == MAX_CACHED_DIRS) {
+        int oldest = 0;
+        for (int n = 1; n < cache->num_dirs; n++) {
+            if (cache->dirs[n]->last_use < cache->dirs[oldest]->last_use)
+                oldest = n;
+        }
+        drop_cached_listing(cache, oldest);
+    }
+    list->last_use = ++cache->use_counter;
+    list->refs++;
+    MP_TARRAY_APPEND(cache, cache->dirs, cache->num_dirs, list);
+    mp_mutex_unlock(&cache->lock);
+    return list;
+}
+
 static int test_ext(MPOpts *opts, bstr ext)
 {
     if (str_in_list(ext, opts->sub_auto_exts))
@@ -86,6 +223,7 @@ static int compare_sub_priority(const void *a, const void *b)
 }
 
 static void append_dir_subtitles(struct mpv_global *global, struct MPOpts *opts,
+                                 struct external_files_cache *cache,
                                  struct subfn **slist, int *nsub,
                                  struct bstr path, const char *fname,
                                  int limit_fuzziness, int limit_type)
@@ -107,14 +245,14 @@ static void append_dir_subtitles(struct mpv_global *global, struct MPOpts *opts,
     if (mp_is_url(bstr0(path0)))
         goto out;
 
-    DIR *d = opendir(path0);
-    if (!d)
+    struct dir_listing *list = get_dir_listing(cache, path0);
+    if (!list)
         goto out;
     mp_verbose(log, "Loading external files in %.*s\n", BSTR_P(path));
-    struct dirent *de;
-    while ((de = readdir(d))) {
+    for (int i = 0; i < list->num_names; i++) {
+        const char *d_name = list->names[i];
         void *tmpmem2 = talloc_new(tmpmem);
-        struct bstr den = bstr0(de->d_name);
+        struct bstr den = bstr0(d_name);
         struct bstr dename = mp_iconv_to_utf8(log, den,
                                               "UTF-8-MAC", MP_NO_LATIN1_FALLBACK);
         // retrieve various parts of the filename
@@ -184,7 +322,7 @@ static void append_dir_subtitles(struct mpv_global *global, struct MPOpts *opts,
             prio |= 1;
 
         mp_trace(log, "Potential external file: \"%s\"  Priority: %d\n",
-               de->d_name, prio);
+               d_name, prio);
 
         if (prio) {
             char *subpath = mp_path_join_bstr(*slist, path, dename);
@@ -207,7 +345,7 @@ static void append_dir_subtitles(struct mpv_global *global, struct MPOpts *opts,
     next_sub:
         talloc_free(tmpmem2);
     }
-    closedir(d);
+    release_dir_listing(cache, list);
 
  out:
     talloc_free(tmpmem);
@@ -240,51 +378,147 @@ static void filter_subidx(struct subfn **slist, int *nsub)
     }
 }
 
-static void load_paths(struct mpv_global *global, struct MPOpts *opts,
-                       struct subfn **slist, int *nsubs, const char *fname,
-                       char **paths, char *cfg_path, int type)
+// A directory to search, see append_dir_subtitles().
+struct dir_search {
+    struct find_ctx *ctx;
+    char *path;
+    int limit_fuzziness;
+    int limit_type;
+    struct subfn *list;
+    int num;
+};
+
+struct find_ctx {
+    struct mpv_global *global;
+    struct MPOpts *opts;
+    struct external_files_cache *cache;
+    const char *fname;
+    struct dir_search *searches;
+    int num_searches;
+
+    mp_mutex lock;
+    mp_cond wakeup;
+    int pending;        // number of queued or running search_dir_fn() calls
+};
+
+static void add_search(struct find_ctx *ctx, char *path, int limit_fuzziness,
+                       int limit_type)
+{
+    struct dir_search search = {
+        .ctx = ctx,
+        .path = path,
+        .limit_fuzziness = limit_fuzziness,
+        .limit_type = limit_type,
+    };
+    MP_TARRAY_APPEND(ctx, ctx->searches, ctx->num_searches, search);
+}
+
+static void search_dir(struct dir_search *search)
+{
+    struct find_ctx *ctx = search->ctx;
+    search->list = talloc_array_ptrtype(NULL, search->list, 1);
+    append_dir_subtitles(ctx->global, ctx->opts, ctx->cache, &search->list,
+                         &search->num, bstr0(search->path), ctx->fname,
+                         search->limit_fuzziness, search->limit_type);
+}
+
+static void search_dir_fn(void *arg)
+{
+    struct dir_search *search = arg;
+    struct find_ctx *ctx = search->ctx;
+
+    search_dir(search);
+
+    mp_mutex_lock(&ctx->lock);
+    ctx->pending -= 1;
+    if (!ctx->pending)
+        mp_cond_broadcast(&ctx->wakeup);
+    mp_mutex_unlock(&ctx->lock);
+}
+
+static void add_search_paths(struct find_ctx *ctx, char **paths, char *cfg_path,
+                             int type)
 {
     for (int i = 0; paths && paths[i]; i++) {
-        char *expanded_path = mp_get_user_path(NULL, global, paths[i]);
+        char *expanded_path = mp_get_user_path(NULL, ctx->global, paths[i]);
         char *path = mp_path_join_bstr(
-            *slist, mp_dirname(fname),
+            ctx, mp_dirname(ctx->fname),
             bstr0(expanded_path ? expanded_path : paths[i]));
-        append_dir_subtitles(global, opts, slist, nsubs, bstr0(path),
-                             fname, 0, type);
+        add_search(ctx, path, 0, type);
         talloc_free(expanded_path);
     }
 
     // Load subtitles in ~/.mpv/sub (or similar) limiting sub fuzziness
-    char *mp_subdir = mp_find_config_file(NULL, global, cfg_path);
-    if (mp_subdir) {
-        append_dir_subtitles(global, opts, slist, nsubs, bstr0(mp_subdir),
-                             fname, 1, type);
-    }
-    talloc_free(mp_subdir);
+    char *mp_subdir = mp_find_config_file(ctx, ctx->global, cfg_path);
+    if (mp_subdir)
+        add_search(ctx, mp_subdir, 1, type);
 }
 
 // Return a list of subtitles and audio files found, sorted by priority.
 // Last element is terminated with a fname==NULL entry.
+// The directories are searched concurrently on pool if possible. cache and
+// pool can be NULL.
 struct subfn *find_external_files(struct mpv_global *global, const char *fname,
-                                  struct MPOpts *opts)
+                                  struct MPOpts *opts,
+                                  struct external_files_cache *cache,
+                                  struct mp_thread_pool *pool)
 {
-    struct subfn *slist = talloc_array_ptrtype(NULL, slist, 1);
-    int n = 0;
+    struct find_ctx *ctx = talloc_ptrtype(NULL, ctx);
+    *ctx = (struct find_ctx){
+        .global = global,
+        .opts = opts,
+        .cache = cache,
+        .fname = fname,
+    };
+    mp_mutex_init(&ctx->lock);
+    mp_cond_init(&ctx->wakeup);
 
     // Load subtitles from current media directory
-    append_dir_subtitles(global, opts, &slist, &n, mp_dirname(fname), fname, 0, -1);
+    add_search(ctx, bstrdup0(ctx, mp_dirname(fname)), 0, -1);
 
     // Load subtitles in dirs specified by sub-paths option
-    if (opts->sub_auto >= 0) {
-        load_paths(global, opts, &slist, &n, fname, opts->sub_paths, "sub",
-                   STREAM_SUB);
+    if (opts->sub_auto >= 0)
+        add_search_paths(ctx, opts->sub_paths, "sub", STREAM_SUB);
+
+    if (opts->audiofile_auto >= 0)
+        add_search_paths(ctx, opts->audiofile_paths, "audio", STREAM_AUDIO);
+
+    // Every search except the first one goes to the thread pool, if there's a
+    // free thread. On network filesystems, each directory costs a few round
+    // trips, so doing them in parallel helps a lot.
+    for (int i = 1; i < ctx->num_searches; i++) {
+        struct dir_search *search = &ctx->searches[i];
+        mp_mutex_lock(&ctx->lock);
+        ctx->pending += 1;
+        mp_mutex_unlock(&ctx->lock);
+        if (pool && mp_thread_pool_run(pool, search_dir_fn, search))
+            continue;
+        mp_mutex_lock(&ctx->lock);
+        ctx->pending -= 1;
+        mp_mutex_unlock(&ctx->lock);
+        search_dir(search);
     }
+    if (ctx->num_searches)
+        search_dir(&ctx->searches[0]);
+
+    mp_mutex_lock(&ctx->lock);
+    while (ctx->pending)
+        mp_cond_wait(&ctx->wakeup, &ctx->lock);
+    mp_mutex_unlock(&ctx->lock);
 
-    if (opts->audiofile_auto >= 0) {
-        load_paths(global, opts, &slist, &n, fname, opts->audiofile_paths,
-                   "audio", STREAM_AUDIO);
+    struct subfn *slist = talloc_array_ptrtype(NULL, slist, 1);
+    int n = 0;
+    for (int i = 0; i < ctx->num_searches; i++) {
+        struct dir_search *search = &ctx->searches[i];
+        for (int j = 0; j < search->num; j++)
+            MP_TARRAY_APPEND(NULL, slist, n, search->list[j]);
+        talloc_steal(slist, search->list);
     }
 
+    mp_cond_destroy(&ctx->wakeup);
+    mp_mutex_destroy(&ctx->lock);
+    talloc_free(ctx);
+
     // Sort by name for filter_subidx()
     qsort(slist, n, sizeof(*slist), compare_sub_filename);
 
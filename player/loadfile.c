@@ -944,7 +944,9 @@ void autoload_external_files(struct MPContext *mpctx, struct mp_cancel *cancel)
         return;
 
     void *tmp = talloc_new(NULL);
-    struct subfn *list = find_external_files(mpctx->global, mpctx->filename, opts);
+    struct subfn *list = find_external_files(mpctx->global, mpctx->filename, opts,
+                                             mpctx->external_files_cache,
+                                             mpctx->thread_pool);
     talloc_steal(tmp, list);
 
     int sc[STREAM_TYPE_COUNT] = {0};
@@ -1095,6 +1097,48 @@ static void load_per_file_options(m_config_t *conf,
     }
 }
 
+// Create decoders for the audio and video streams the next file will most
+// likely play, and let them decode ahead. The player takes them over if it
+// selects the same streams. Runs on the opener thread.
+static void create_decoders_ahead(struct MPContext *mpctx, struct demuxer *demux)
+{
+    struct mp_filter *root = mp_filter_create_root(mpctx->global);
+    int num_streams = demux_get_num_stream(demux);
+
+    for (int t = 0; t < STREAM_TYPE_COUNT; t++) {
+        if (t != STREAM_AUDIO && !(t == STREAM_VIDEO && mpctx->open_decode_video))
+            continue;
+
+        // A guess; the first default track, else the first track.
+        struct sh_stream *sh = NULL;
+        for (int n = 0; n < num_streams; n++) {
+            struct sh_stream *s = demux_get_stream(demux, n);
+            if (s->type != t || s->attached_picture || s->image)
+                continue;
+            if (!sh || (s->default_track && !sh->default_track))
+                sh = s;
+        }
+        if (!sh)
+            continue;
+
+        struct mp_decoder_wrapper *dec = mp_decoder_wrapper_create_ahead(root, sh);
+        if (!dec)
+            continue;
+        // Same as init_audio_decoder() for tracks that go to the AO.
+        if (t == STREAM_AUDIO)
+            mp_decoder_wrapper_set_spdif_flag(dec, true);
+        if (!mp_decoder_wrapper_reinit(dec)) {
+            talloc_free(dec->f);
+            continue;
+        }
+        MP_VERBOSE(mpctx, "Decoding ahead: %s stream %d\n",
+                   stream_type_name(t), sh->index);
+        mpctx->open_res_decs[t] = (struct decoder_ahead){sh, dec};
+    }
+
+    mpctx->open_res_filter_root = root;
+}
+
 static MP_THREAD_VOID open_demux_thread(void *ctx)
 {
     struct MPContext *mpctx = ctx;
@@ -1123,9 +1167,17 @@ static MP_THREAD_VOID open_demux_thread(void *ctx)
                 demuxer_select_track(demux, sh, MP_NOPTS_VALUE, true);
             }
 
+            // Decoders created ahead read packets before the player could set
+            // this.
+            if (mpctx->open_rebase_start_time)
+                demux_set_ts_offset(demux, -demux->start_time);
+
             demux_set_wakeup_cb(demux, wakeup_demux, mpctx);
             demux_start_thread(demux);
             demux_start_prefetch(demux);
+
+            if (mpctx->open_decode_ahead)
+                create_decoders_ahead(mpctx, demux);
         }
     } else {
         MP_VERBOSE(mpctx, "Opening failed or was aborted: %s\n", mpctx->open_url);
@@ -1151,6 +1203,11 @@ static void cancel_open(struct MPContext *mpctx)
         mp_thread_join(mpctx->open_thread);
     mpctx->open_active = false;
 
+    // The decoders use the demuxer's streams.
+    TA_FREEP(&mpctx->open_res_filter_root);
+    for (int t = 0; t < STREAM_TYPE_COUNT; t++)
+        mpctx->open_res_decs[t] = (struct decoder_ahead){0};
+
     if (mpctx->open_res_demuxer)
         demux_cancel_and_free(mpctx->open_res_demuxer);
     mpctx->open_res_demuxer = NULL;
@@ -1158,10 +1215,58 @@ static void cancel_open(struct MPContext *mpctx)
     TA_FREEP(&mpctx->open_cancel);
     TA_FREEP(&mpctx->open_url);
     TA_FREEP(&mpctx->open_format);
+    for (int t = 0; t < STREAM_TYPE_COUNT; t++)
+        TA_FREEP(&mpctx->open_dec_opts[t]);
 
     atomic_store(&mpctx->open_done, false);
 }
 
+// Video decoders created ahead can't use the VO's hwdec devices, because the
+// VO might go away before the decoder is used or freed. Don't create them if
+// hwdec is wanted, since they'd decode the whole file in software.
+static bool hwdec_requested(struct MPContext *mpctx)
+{
+    struct m_config_option *co = m_config_get_co(mpctx->mconfig, bstr0("hwdec"));
+    char **list = co ? *(char ***)co->data : NULL;
+    for (int n = 0; list && list[n]; n++) {
+        if (strcmp(list[n], "no") != 0)
+            return true;
+    }
+    return false;
+}
+
+// Options that affect how decoders are created and initialized. Entries ending
+// with '-' match all options with this prefix.
+static const char *const decoder_opts[STREAM_TYPE_COUNT][5] = {
+    [STREAM_VIDEO] = {"vd", "hwdec", "hwdec-", "vd-lavc-"},
+    [STREAM_AUDIO] = {"ad", "audio-spdif", "ad-lavc-"},
+};
+
+// Return the current values of the options in decoder_opts[type] as string.
+// Decoders created ahead are used only if this didn't change.
+static char *get_decoder_opts(void *ta_parent, struct MPContext *mpctx,
+                              enum stream_type type)
+{
+    char *res = talloc_strdup(ta_parent, "");
+    for (int n = 0; n < mpctx->mconfig->num_opts; n++) {
+        struct m_config_option *co = &mpctx->mconfig->opts[n];
+        bool match = false;
+        for (int i = 0; decoder_opts[type][i]; i++) {
+            const char *name = decoder_opts[type][i];
+            size_t len = strlen(name);
+            match |= name[len - 1] == '-' ? !strncmp(co->name, name, len)
+                                          : !strcmp(co->name, name);
+        }
+        if (!match || !co->data)
+            continue;
+        char *val = m_option_print(co->opt, co->data);
+        res = talloc_asprintf_append_buffer(res, "%s=%s\n", co->name,
+                                            val ? val : "");
+        talloc_free(val);
+    }
+    return res;
+}
+
 // Setup all the field to open this url, and make sure a thread is running.
 static void start_open(struct MPContext *mpctx, char *url, int url_flags,
                        bool for_prefetch)
@@ -1178,6 +1283,16 @@ static void start_open(struct MPContext *mpctx, char *url, int url_flags,
     mpctx->open_format = talloc_strdup(NULL, mpctx->opts->demuxer_name);
     mpctx->open_url_flags = url_flags;
     mpctx->open_for_prefetch = for_prefetch && mpctx->opts->demuxer_thread;
+    mpctx->open_decode_ahead = mpctx->open_for_prefetch &&
+                               mpctx->opts->prefetch_decoders &&
+                               mpctx->opts->play_dir > 0 &&
+                               !mpctx->encode_lavc_ctx;
+    mpctx->open_decode_video = !hwdec_requested(mpctx);
+    if (mpctx->open_decode_ahead) {
+        for (int t = 0; t < STREAM_TYPE_COUNT; t++)
+            mpctx->open_dec_opts[t] = get_decoder_opts(NULL, mpctx, t);
+    }
+    mpctx->open_rebase_start_time = mpctx->opts->rebase_start_time;
 
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
     // Don't allow to open local paths or stdin during fuzzing
@@ -1244,6 +1359,24 @@ static void open_demux_reentrant(struct MPContext *mpctx)
         mpctx->demuxer = mpctx->open_res_demuxer;
         mpctx->open_res_demuxer = NULL;
         mp_cancel_set_parent(mpctx->demuxer->cancel, mpctx->playback_abort);
+
+        // Nothing was added to the new filter root yet, so replace it with
+        // the one of the decoders created ahead.
+        if (mpctx->open_res_filter_root) {
+            talloc_free(mpctx->filter_root);
+            mpctx->filter_root = mpctx->open_res_filter_root;
+            mpctx->open_res_filter_root = NULL;
+            mp_filter_graph_set_wakeup_cb(mpctx->filter_root,
+                                          mp_wakeup_core_cb, mpctx);
+            mp_filter_graph_set_max_run_time(mpctx->filter_root, 0.1);
+            for (int t = 0; t < STREAM_TYPE_COUNT; t++) {
+                struct decoder_ahead *d = &mpctx->prefetched_decs[t];
+                *d = mpctx->open_res_decs[t];
+                mpctx->open_res_decs[t] = (struct decoder_ahead){0};
+                if (d->dec)
+                    d->opts = talloc_strdup(d->dec->f, mpctx->open_dec_opts[t]);
+            }
+        }
     } else {
         mpctx->error_playing = mpctx->open_res_error;
     }
@@ -1264,6 +1397,49 @@ void prefetch_next(struct MPContext *mpctx)
     }
 }
 
+// Return the decoder created ahead for this track, if any. It's initialized,
+// and might have decoded some frames already.
+struct mp_decoder_wrapper *take_prefetched_decoder(struct MPContext *mpctx,
+                                                   struct track *track)
+{
+    struct decoder_ahead *d = &mpctx->prefetched_decs[track->type];
+    if (!d->dec || d->stream != track->stream)
+        return NULL;
+    // Per-file options, profiles, or the user might have changed the decoder
+    // options since it was created.
+    char *opts = get_decoder_opts(NULL, mpctx, track->type);
+    bool same = d->opts && strcmp(opts, d->opts) == 0;
+    talloc_free(opts);
+    if (!same) {
+        MP_VERBOSE(mpctx, "Decoder options changed, dropping %s decoder "
+                   "created ahead.\n", stream_type_name(track->type));
+        talloc_free(d->dec->f);
+        *d = (struct decoder_ahead){0};
+        return NULL;
+    }
+    struct mp_decoder_wrapper *dec = d->dec;
+    *d = (struct decoder_ahead){0};
+    MP_VERBOSE(mpctx, "Using %s decoder created ahead.\n",
+               stream_type_name(track->type));
+    return dec;
+}
+
+// Free the decoders created ahead that won't be used. The demuxer stream of a
+// decoder must stay selected until it's freed.
+static void drop_prefetched_decoders(struct MPContext *mpctx, bool all)
+{
+    for (int t = 0; t < STREAM_TYPE_COUNT; t++) {
+        struct decoder_ahead *d = &mpctx->prefetched_decs[t];
+        if (!d->dec)
+            continue;
+        struct track *track = mpctx->current_track[0][t];
+        if (!all && track && track->selected && track->stream == d->stream)
+            continue;
+        talloc_free(d->dec->f);
+        *d = (struct decoder_ahead){0};
+    }
+}
+
 static void clear_playlist_paths(struct MPContext *mpctx)
 {
     TA_FREEP(&mpctx->playlist_paths);
@@ -1273,7 +1449,7 @@ static void clear_playlist_paths(struct MPContext *mpctx)
 static bool infinite_playlist_loading_loop(struct MPContext *mpctx, struct playlist *pl)
 {
     if (pl->num_entries) {
-        struct playlist_entry *e = pl->entries[0];
+        struct playlist_entry *e = playlist_get_first(pl);
         for (int n = 0; n < mpctx->playlist_paths_len; n++) {
             if (strcmp(mpctx->playlist_paths[n], e->filename) == 0) {
                 clear_playlist_paths(mpctx);
@@ -1628,7 +1804,9 @@ static void play_current_file(struct MPContext *mpctx)
         goto terminate_playback;
     }
 
+    int64_t demux_start = mp_time_ns();
     open_demux_reentrant(mpctx);
+    mp_startup_phase(mpctx, "demuxer open", demux_start);
     if (!mpctx->stop_play && !mpctx->demuxer) {
         process_hooks(mpctx, "on_load_fail");
         if (strcmp(mpctx->stream_open_filename, mpctx->filename) != 0 &&
@@ -1720,6 +1898,8 @@ static void play_current_file(struct MPContext *mpctx)
         }
     }
 
+    drop_prefetched_decoders(mpctx, false);
+
     for (int t = 0; t < STREAM_TYPE_COUNT; t++)
         for (int n = 0; n < mpctx->num_tracks; n++)
             if (mpctx->tracks[n]->type == t)
@@ -1819,6 +1999,9 @@ terminate_playback:
     if (!mpctx->stop_play)
         mpctx->stop_play = PT_ERROR;
 
+    mpctx->transition_start =
+        mpctx->stop_play == AT_END_OF_FILE ? mp_time_ns() : 0;
+
     if (mpctx->stop_play != AT_END_OF_FILE)
         clear_audio_output_buffers(mpctx);
 
@@ -1836,6 +2019,7 @@ terminate_playback:
     uninit_audio_chain(mpctx);
     uninit_video_chain(mpctx);
     uninit_sub_all(mpctx);
+    drop_prefetched_decoders(mpctx, true);
     if (!opts->gapless_audio && !mpctx->encode_lavc_ctx)
         uninit_audio_out(mpctx);
 
@@ -1957,11 +2141,9 @@ struct playlist_entry *mp_next_file(struct MPContext *mpctx, int direction,
         if (!force && next && next->init_failed && !ignore_failures) {
             // Don't endless loop if no file in playlist is playable
             bool all_failed = true;
-            for (int n = 0; n < mpctx->playlist->num_entries; n++) {
-                all_failed &= mpctx->playlist->entries[n]->init_failed;
-                if (!all_failed)
-                    break;
-            }
+            for (struct playlist_entry *e = playlist_get_first(mpctx->playlist);
+                 e && all_failed; e = playlist_entry_get_rel(e, 1))
+                all_failed &= e->init_failed;
             if (all_failed)
                 next = NULL;
         }
@@ -1978,8 +2160,10 @@ void mp_play_files(struct MPContext *mpctx)
     // Wait for all scripts to load before possibly starting playback.
     if (!mp_clients_all_initialized(mpctx)) {
         MP_VERBOSE(mpctx, "Waiting for scripts...\n");
+        int64_t start = mp_time_ns();
         while (!mp_clients_all_initialized(mpctx))
             mp_idle(mpctx);
+        mp_startup_phase(mpctx, "waiting for scripts", start);
         mp_wakeup_core(mpctx); // avoid lost wakeups during waiting
         MP_VERBOSE(mpctx, "Done loading scripts.\n");
     }
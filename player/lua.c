@@ -248,6 +248,8 @@ static int check_error(lua_State *L, int err)
 
 static void add_functions(struct script_ctx *ctx);
 
+static void add_node_proxy_metatable(lua_State *L);
+
 static void load_file(lua_State *L, const char *fname)
 {
     struct script_ctx *ctx = get_ctx(L);
@@ -406,6 +408,8 @@ static int run_lua(lua_State *L)
     lua_setfield(L, LUA_REGISTRYINDEX, "ARRAY"); // mp table
     lua_setfield(L, -2, "ARRAY"); // mp
 
+    add_node_proxy_metatable(L);
+
     lua_pop(L, 1); // -
 
     assert(lua_gettop(L) == 0);
@@ -667,6 +671,131 @@ static int script_set_property_number(lua_State *L)
     return check_error(L, res);
 }
 
+// mp.get_property_lazy() returns maps and arrays as read-only userdata proxies,
+// which convert entries to Lua values only when they are indexed. All proxies
+// created from the same property value share a reference counted root, which
+// owns the mpv_node.
+struct node_root {
+    mpv_node node;
+    int refs;
+};
+
+#define NODE_PROXY "mp_node_proxy"
+
+struct node_proxy {
+    struct node_root *root;
+    mpv_node *node;     // MPV_FORMAT_NODE_ARRAY or MPV_FORMAT_NODE_MAP
+};
+
+// Return the proxy at the given stack index, or NULL if it's something else.
+static struct node_proxy *to_node_proxy(lua_State *L, int idx)
+{
+    struct node_proxy *p = lua_touserdata(L, idx);
+    if (!p || !lua_getmetatable(L, idx)) // mt
+        return NULL;
+    luaL_getmetatable(L, NODE_PROXY); // mt proxy_mt
+    bool is_proxy = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2); // -
+    return is_proxy ? p : NULL;
+}
+
+static struct node_proxy *check_node_proxy(lua_State *L, int idx)
+{
+    struct node_proxy *p = luaL_checkudata(L, idx, NODE_PROXY);
+    if (!p->root)
+        luaL_error(L, "node proxy used after it was freed");
+    return p;
+}
+
+static void push_node_lazy(lua_State *L, struct node_root *root, mpv_node *node)
+{
+    if (node->format != MPV_FORMAT_NODE_ARRAY &&
+        node->format != MPV_FORMAT_NODE_MAP)
+    {
+        pushnode(L, node);
+        return;
+    }
+    struct node_proxy *p = lua_newuserdata(L, sizeof(*p)); // ud
+    *p = (struct node_proxy){root, node};
+    root->refs++;
+    luaL_getmetatable(L, NODE_PROXY); // ud mt
+    lua_setmetatable(L, -2); // ud
+}
+
+static int node_proxy_index(lua_State *L)
+{
+    struct node_proxy *p = check_node_proxy(L, 1);
+    mpv_node_list *list = p->node->u.list;
+    if (p->node->format == MPV_FORMAT_NODE_ARRAY) {
+        if (lua_type(L, 2) == LUA_TNUMBER) {
+            lua_Number n = lua_tonumber(L, 2);
+            if (n >= 1 && n <= list->num && n == (int)n) {
+                push_node_lazy(L, p->root, &list->values[(int)n - 1]);
+                return 1;
+            }
+        }
+    } else if (lua_type(L, 2) == LUA_TSTRING) {
+        const char *key = lua_tostring(L, 2);
+        for (int n = 0; n < list->num; n++) {
+            if (strcmp(list->keys[n], key) == 0) {
+                push_node_lazy(L, p->root, &list->values[n]);
+                return 1;
+            }
+        }
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+static int node_proxy_newindex(lua_State *L)
+{
+    return luaL_error(L, "node proxies are read-only");
+}
+
+static int node_proxy_len(lua_State *L)
+{
+    struct node_proxy *p = check_node_proxy(L, 1);
+    lua_pushinteger(L, p->node->u.list->num);
+    return 1;
+}
+
+static int node_proxy_tostring(lua_State *L)
+{
+    struct node_proxy *p = check_node_proxy(L, 1);
+    lua_pushfstring(L, "%s proxy: %p",
+        p->node->format == MPV_FORMAT_NODE_MAP ? "MAP" : "ARRAY", (void *)p);
+    return 1;
+}
+
+static int node_proxy_gc(lua_State *L)
+{
+    struct node_proxy *p = luaL_checkudata(L, 1, NODE_PROXY);
+    if (p->root && --p->root->refs == 0)
+        talloc_free(p->root);
+    p->root = NULL;
+    return 0;
+}
+
+static const luaL_Reg node_proxy_meta[] = {
+    {"__index", node_proxy_index},
+    {"__newindex", node_proxy_newindex},
+    {"__len", node_proxy_len},
+    {"__tostring", node_proxy_tostring},
+    {"__gc", node_proxy_gc},
+    {0}
+};
+
+// used by push_node_lazy()
+static void add_node_proxy_metatable(lua_State *L)
+{
+    luaL_newmetatable(L, NODE_PROXY); // mt
+    for (int n = 0; node_proxy_meta[n].name; n++) {
+        lua_pushcfunction(L, node_proxy_meta[n].func); // mt fn
+        lua_setfield(L, -2, node_proxy_meta[n].name); // mt
+    }
+    lua_pop(L, 1); // -
+}
+
 static void makenode(void *tmp, mpv_node *dst, lua_State *L, int t)
 {
     luaL_checkstack(L, 6, "makenode");
@@ -783,6 +912,15 @@ static void makenode(void *tmp, mpv_node *dst, lua_State *L, int t)
         }
         break;
     }
+    case LUA_TUSERDATA: {
+        struct node_proxy *p = to_node_proxy(L, t);
+        if (p && p->root) {
+            // Shallow copy; the proxy keeps the data alive during the call.
+            *dst = *p->node;
+            break;
+        }
+    }
+    // fallthrough
     default:
         // unknown type
         luaL_error(L, "disallowed Lua type found: %s\n", lua_typename(L, t));
@@ -938,6 +1076,27 @@ static int script_get_property_native(lua_State *L, void *tmp)
     return 2;
 }
 
+static int script_get_property_lazy(lua_State *L, void *tmp)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    const char *name = luaL_checkstring(L, 1);
+    mp_lua_optarg(L, 2);
+
+    struct node_root *root = talloc_zero(tmp, struct node_root);
+    int err = mpv_get_property(ctx->client, name, MPV_FORMAT_NODE, &root->node);
+    if (err >= 0) {
+        steal_node_allocations(root, &root->node);
+        push_node_lazy(L, root, &root->node);
+        // Owned by the proxy now, freed by its __gc.
+        if (root->refs)
+            talloc_steal(NULL, root);
+        return 1;
+    }
+    lua_pushvalue(L, 2);
+    lua_pushstring(L, mpv_error_string(err));
+    return 2;
+}
+
 static mpv_format check_property_format(lua_State *L, int arg)
 {
     if (lua_isnil(L, arg))
@@ -1198,6 +1357,51 @@ static int script_format_json(lua_State *L, void *tmp)
     return 2;
 }
 
+static int node_pairs_next(lua_State *L)
+{
+    struct node_proxy *p = check_node_proxy(L, lua_upvalueindex(1));
+    int n = lua_tointeger(L, lua_upvalueindex(2));
+    mpv_node_list *list = p->node->u.list;
+    if (n >= list->num)
+        return 0;
+    lua_pushinteger(L, n + 1);
+    lua_replace(L, lua_upvalueindex(2));
+    if (p->node->format == MPV_FORMAT_NODE_MAP) {
+        lua_pushstring(L, list->keys[n]);
+    } else {
+        lua_pushinteger(L, n + 1);
+    }
+    push_node_lazy(L, p->root, &list->values[n]);
+    return 2;
+}
+
+static int script_node_pairs(lua_State *L)
+{
+    if (lua_istable(L, 1)) {
+        lua_getglobal(L, "next"); // next
+        lua_pushvalue(L, 1); // next t
+        lua_pushnil(L); // next t nil
+        return 3;
+    }
+    check_node_proxy(L, 1);
+    lua_pushvalue(L, 1); // proxy
+    lua_pushinteger(L, 0); // proxy index
+    lua_pushcclosure(L, node_pairs_next, 2); // iter
+    return 1;
+}
+
+static int script_to_table(lua_State *L)
+{
+    struct node_proxy *p = to_node_proxy(L, 1);
+    if (p) {
+        check_node_proxy(L, 1);
+        pushnode(L, p->node);
+    } else {
+        lua_pushvalue(L, 1);
+    }
+    return 1;
+}
+
 static int script_get_env_list(lua_State *L)
 {
     lua_newtable(L); // table
@@ -1232,6 +1436,7 @@ static const struct fn_entry main_fns[] = {
     FN_ENTRY(get_property_bool),
     FN_ENTRY(get_property_number),
     AF_ENTRY(get_property_native),
+    AF_ENTRY(get_property_lazy),
     FN_ENTRY(del_property),
     FN_ENTRY(set_property),
     FN_ENTRY(set_property_bool),
@@ -1256,6 +1461,8 @@ static const struct fn_entry utils_fns[] = {
     AF_ENTRY(join_path),
     AF_ENTRY(parse_json),
     AF_ENTRY(format_json),
+    FN_ENTRY(node_pairs),
+    FN_ENTRY(to_table),
     FN_ENTRY(get_env_list),
     {0}
 };
@@ -31,6 +31,7 @@
 
 #include "misc/dispatch.h"
 #include "misc/random.h"
+#include "misc/task_pool.h"
 #include "misc/thread_pool.h"
 #include "osdep/io.h"
 #include "osdep/terminal.h"
@@ -66,6 +67,7 @@
 #include "core.h"
 #include "client.h"
 #include "command.h"
+#include "external_files.h"
 #include "screenshot.h"
 
 static const char def_config[] =
@@ -123,6 +125,11 @@ void mp_update_logging(struct MPContext *mpctx, bool preinit)
 
     mp_msg_update_msglevels(mpctx->global, mpctx->opts);
 
+    char *trace_path = mp_get_user_path(NULL, mpctx->global,
+                                        mpctx->opts->dump_trace);
+    stats_set_trace_file(mpctx->global, trace_path);
+    talloc_free(trace_path);
+
     bool enable = mpctx->opts->use_terminal;
     bool enabled = cas_terminal_owner(mpctx, mpctx);
     if (enable != enabled) {
@@ -207,6 +214,8 @@ void mp_destroy(struct MPContext *mpctx)
     mp_mutex_destroy(&mpctx->abort_lock);
     talloc_free(mpctx->mconfig); // destroy before dispatch
     talloc_free(mpctx);
+
+    mp_task_pool_unref();
 }
 
 static bool handle_help_options(struct MPContext *mpctx)
@@ -266,6 +275,7 @@ struct MPContext *mp_create(void)
 
     mp_time_init();
     mp_rand_seed(0);
+    mp_task_pool_ref();
 
     struct MPContext *mpctx = talloc(NULL, MPContext);
     *mpctx = (struct MPContext){
@@ -276,8 +286,11 @@ struct MPContext *mp_create(void)
         .dispatch = mp_dispatch_create(mpctx),
         .playback_abort = mp_cancel_new(mpctx),
         .thread_pool = mp_thread_pool_create(mpctx, 0, 1, 30),
+        .external_files_cache = external_files_cache_create(mpctx),
         .stop_play = PT_NEXT_ENTRY,
         .play_dir = 1,
+        .startup_time = mp_time_ns(),
+        .transition_gap = -1,
     };
 
     mp_mutex_init(&mpctx->abort_lock);
@@ -292,6 +305,7 @@ struct MPContext *mp_create(void)
     mpctx->statusline = mp_log_new(mpctx, mpctx->log, "!statusline");
 
     mpctx->stats = stats_ctx_create(mpctx, mpctx->global, "main");
+    mpctx->stats_iterations = stats_handle_create(mpctx->stats, "iterations");
 
     // Create the config context and register the options
     mpctx->mconfig = m_config_new(mpctx, mpctx->log, &mp_opt_root);
@@ -354,13 +368,17 @@ int mp_initialize(struct MPContext *mpctx, char **options)
 
     mp_print_version(mpctx->log, false);
 
+    int64_t start = mp_time_ns();
     mp_parse_cfgfiles(mpctx);
+    mp_startup_phase(mpctx, "config files", start);
 
     if (options) {
+        start = mp_time_ns();
         int r = m_config_parse_mp_command_line(mpctx->mconfig, mpctx->playlist,
                                                mpctx->global, options);
         if (r < 0)
             return r == M_OPT_EXIT ? 1 : -1;
+        mp_startup_phase(mpctx, "command line", start);
     }
 
     if (opts->operation_mode == 1) {
@@ -374,7 +392,9 @@ int mp_initialize(struct MPContext *mpctx, char **options)
     // the command line.
     m_config_backup_watch_later_opts(mpctx->mconfig);
 
+    start = mp_time_ns();
     mp_input_load_config(mpctx->input);
+    mp_startup_phase(mpctx, "input config", start);
 
     // From this point on, all mpctx members are initialized.
     mpctx->initialized = true;
@@ -418,7 +438,9 @@ int mp_initialize(struct MPContext *mpctx, char **options)
         }
     }
 
+    start = mp_time_ns();
     mp_load_scripts(mpctx);
+    mp_startup_phase(mpctx, "user scripts", start);
 
     if (opts->force_vo == 2 && handle_force_window(mpctx, false) < 0)
         return -1;
@@ -313,10 +313,13 @@ void merge_playlist_files(struct playlist *pl)
     if (!pl->num_entries)
         return;
     char *edl = talloc_strdup(NULL, "edl://");
-    for (int n = 0; n < pl->num_entries; n++) {
-        struct playlist_entry *e = pl->entries[n];
-        if (n)
+    bool first = true;
+    for (struct playlist_entry *e = playlist_get_first(pl); e;
+         e = playlist_entry_get_rel(e, 1))
+    {
+        if (!first)
             edl = talloc_strdup_append_buffer(edl, ";");
+        first = false;
         // Escape if needed
         if (e->filename[strcspn(e->filename, "=%,;\n")] ||
             bstr_strip(bstr0(e->filename)).len != strlen(e->filename))
@@ -413,3 +416,44 @@ char *mp_format_track_metadata(void *ctx, struct track *t, bool add_lang)
 
     return bstrto0(ctx, dst);
 }
+
+struct startup_phase {
+    const char *name;
+    int64_t start, end;
+};
+
+// Record that the startup phase with the given name (a static string) ran from
+// start until now. Does nothing after the startup profile was reported.
+void mp_startup_phase(struct MPContext *mpctx, const char *name, int64_t start)
+{
+    if (mpctx->startup_profile_done)
+        return;
+    struct startup_phase phase = {name, start, mp_time_ns()};
+    MP_TARRAY_APPEND(mpctx, mpctx->startup_phases, mpctx->num_startup_phases,
+                     phase);
+}
+
+// Called when the first file starts playing. Prints the startup phases if
+// --startup-profile is enabled.
+void mp_startup_report(struct MPContext *mpctx)
+{
+    if (mpctx->startup_profile_done)
+        return;
+    mpctx->startup_profile_done = true;
+
+    if (mpctx->opts->startup_profile) {
+        int64_t now = mp_time_ns();
+        MP_INFO(mpctx, "Startup profile (start offset, duration):\n");
+        for (int n = 0; n < mpctx->num_startup_phases; n++) {
+            struct startup_phase *p = &mpctx->startup_phases[n];
+            MP_INFO(mpctx, "  %-20s %9.3f ms %9.3f ms\n", p->name,
+                    MP_TIME_NS_TO_MS(p->start - mpctx->startup_time),
+                    MP_TIME_NS_TO_MS(p->end - p->start));
+        }
+        MP_INFO(mpctx, "  %-20s %9.3f ms\n", "first frame",
+                MP_TIME_NS_TO_MS(now - mpctx->startup_time));
+    }
+
+    TA_FREEP(&mpctx->startup_phases);
+    mpctx->num_startup_phases = 0;
+}
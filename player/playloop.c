@@ -54,7 +54,7 @@ void mp_wait_events(struct MPContext *mpctx)
 {
     mp_client_send_property_changes(mpctx);
 
-    stats_event(mpctx->stats, "iterations");
+    stats_handle_event(mpctx->stats_iterations);
 
     bool sleeping = mpctx->sleeptime > 0;
     if (sleeping)
@@ -1022,7 +1022,9 @@ int handle_force_window(struct MPContext *mpctx, bool force)
             .wakeup_cb = mp_wakeup_core_cb,
             .wakeup_ctx = mpctx,
         };
+        int64_t start = mp_time_ns();
         mpctx->video_out = init_best_video_out(mpctx->global, &ex);
+        mp_startup_phase(mpctx, "VO init", start);
         if (!mpctx->video_out)
             goto err;
         mpctx->mouse_cursor_visible = true;
@@ -1146,9 +1148,18 @@ static void handle_playback_restart(struct MPContext *mpctx)
         mpctx->hrseek_active = false;
         mpctx->restart_complete = true;
         mpctx->current_seek = (struct seek_params){0};
+        if (mpctx->transition_start) {
+            mpctx->transition_gap =
+                MP_TIME_NS_TO_MS(mp_time_ns() - mpctx->transition_start);
+            mpctx->transition_start = 0;
+            MP_VERBOSE(mpctx, "Playlist transition took %.1f ms.\n",
+                       mpctx->transition_gap);
+            mp_notify_property(mpctx, "transition-gap");
+        }
         handle_playback_time(mpctx);
         mp_notify(mpctx, MPV_EVENT_PLAYBACK_RESTART, NULL);
         update_core_idle_state(mpctx);
+        mp_startup_report(mpctx);
         if (!mpctx->playing_msg_shown) {
             if (opts->playing_msg && opts->playing_msg[0]) {
                 char *msg =
@@ -1272,6 +1283,8 @@ void run_playloop(struct MPContext *mpctx)
     if (mp_filter_graph_run(mpctx->filter_root))
         mp_wakeup_core(mpctx);
 
+    stats_trace_flush(mpctx->global);
+
     mp_wait_events(mpctx);
 
     handle_update_cache(mpctx);
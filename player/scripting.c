@@ -25,6 +25,7 @@
 #include "osdep/io.h"
 #include "osdep/subprocess.h"
 #include "osdep/threads.h"
+#include "osdep/timer.h"
 
 #include "common/common.h"
 #include "common/msg.h"
@@ -35,6 +36,7 @@
 #include "misc/bstr.h"
 #include "core.h"
 #include "client.h"
+#include "command.h"
 #include "libmpv/client.h"
 #include "libmpv/render.h"
 #include "libmpv/stream_cb.h"
@@ -237,16 +239,48 @@ static char **list_script_files(void *talloc_ctx, char *path)
     return files;
 }
 
-static void load_builtin_script(struct MPContext *mpctx, int slot, bool enable,
-                                const char *fname)
+// Builtin scripts, in the order of MPContext.builtin_script_ids. Scripts with
+// lazy set are only triggered by script-binding/script-message-to commands or
+// by the listed hooks, so with --lazy-builtin-scripts they are loaded on first
+// use instead of at startup.
+static const struct builtin_script {
+    const char *filename;
+    bool lazy;
+    struct {
+        const char *type;
+        int priority;
+    } hooks[2];
+} builtin_scripts[] = {
+    {"@osc.lua"},
+    {"@ytdl_hook.lua", true, {{"on_load", 10}, {"on_load_fail", 10}}},
+    {"@stats.lua", true},
+    {"@console.lua", true},
+    {"@auto_profiles.lua"},
+    {"@select.lua", true},
+};
+
+static void load_builtin_script(struct MPContext *mpctx, int slot, bool enable)
 {
-    assert(slot < MP_ARRAY_SIZE(mpctx->builtin_script_ids));
+    static_assert(MP_ARRAY_SIZE(builtin_scripts) ==
+                  MP_ARRAY_SIZE(mpctx->builtin_script_ids), "");
+    const struct builtin_script *s = &builtin_scripts[slot];
     int64_t *pid = &mpctx->builtin_script_ids[slot];
     if (*pid > 0 && !mp_client_id_exists(mpctx, *pid))
         *pid = 0; // died
+    bool lazy = enable && s->lazy && mpctx->opts->lua_lazy_builtin_scripts &&
+                *pid <= 0;
+    if (lazy && !mpctx->builtin_script_pending[slot]) {
+        char *name = script_name_from_filename(NULL, s->filename);
+        for (int n = 0; n < MP_ARRAY_SIZE(s->hooks) && s->hooks[n].type; n++)
+            mp_hook_add_lazy(mpctx, name, s->hooks[n].type, s->hooks[n].priority);
+        talloc_free(name);
+    }
+    mpctx->builtin_script_pending[slot] = lazy;
+    if (lazy)
+        return;
     if ((*pid > 0) != enable) {
         if (enable) {
-            *pid = mp_load_script(mpctx, fname);
+            *pid = mp_load_script(mpctx, s->filename);
         } else {
             char *name = mp_tprintf(22, "@%"PRIi64, *pid);
             mp_client_send_event(mpctx, name, 0, MPV_EVENT_SHUTDOWN, NULL);
@@ -256,13 +290,68 @@ static void load_builtin_script(struct MPContext *mpctx, int slot, bool enable,
 
 void mp_load_builtin_scripts(struct MPContext *mpctx)
 {
-    load_builtin_script(mpctx, 0, mpctx->opts->lua_load_osc, "@osc.lua");
-    load_builtin_script(mpctx, 1, mpctx->opts->lua_load_ytdl, "@ytdl_hook.lua");
-    load_builtin_script(mpctx, 2, mpctx->opts->lua_load_stats, "@stats.lua");
-    load_builtin_script(mpctx, 3, mpctx->opts->lua_load_console, "@console.lua");
-    load_builtin_script(mpctx, 4, mpctx->opts->lua_load_auto_profiles,
-                        "@auto_profiles.lua");
-    load_builtin_script(mpctx, 5, mpctx->opts->lua_load_select, "@select.lua");
+    struct MPOpts *opts = mpctx->opts;
+    bool enable[] = {
+        opts->lua_load_osc,
+        opts->lua_load_ytdl,
+        opts->lua_load_stats,
+        opts->lua_load_console,
+        opts->lua_load_auto_profiles,
+        opts->lua_load_select,
+    };
+    static_assert(MP_ARRAY_SIZE(enable) == MP_ARRAY_SIZE(builtin_scripts), "");
+
+    int64_t start = mp_time_ns();
+    for (int n = 0; n < MP_ARRAY_SIZE(builtin_scripts); n++)
+        load_builtin_script(mpctx, n, enable[n]);
+    mp_startup_phase(mpctx, "builtin scripts", start);
+}
+
+// Return the slot of the builtin script with the given client name, if it is
+// waiting for its first use, or -1.
+static int find_pending_builtin_script(struct MPContext *mpctx,
+                                       const char *name)
+{
+    for (int n = 0; n < MP_ARRAY_SIZE(builtin_scripts); n++) {
+        if (!mpctx->builtin_script_pending[n])
+            continue;
+        char *script_name = script_name_from_filename(NULL,
+                                                      builtin_scripts[n].filename);
+        bool match = strcmp(script_name, name) == 0;
+        talloc_free(script_name);
+        if (match)
+            return n;
+    }
+    return -1;
+}
+
+// If name is the client name of a builtin script that waits for its first use,
+// load it now. Returns the client ID, or 0 if nothing was loaded.
+int64_t mp_load_lazy_builtin_script(struct MPContext *mpctx, const char *name)
+{
+    int slot = find_pending_builtin_script(mpctx, name);
+    if (slot < 0)
+        return 0;
+    const char *fname = builtin_scripts[slot].filename;
+    MP_VERBOSE(mpctx, "Loading %s on first use.\n", fname);
+    mpctx->builtin_script_pending[slot] = false;
+    int64_t id = mp_load_script(mpctx, fname);
+    mpctx->builtin_script_ids[slot] = id;
+    return MPMAX(id, 0);
+}
+
+// Called when a hook placeholder of a lazily loaded builtin script runs.
+// Returns the client ID of the loaded script (>0), 0 if the script doesn't
+// need to be loaded for the current file, or -1 if the placeholder is stale.
+int64_t mp_lazy_builtin_script_hook(struct MPContext *mpctx, const char *name)
+{
+    if (find_pending_builtin_script(mpctx, name) < 0)
+        return -1;
+    // Only ytdl_hook uses hooks, and it only handles URLs.
+    if (!mpctx->filename || !mp_is_url(bstr0(mpctx->filename)))
+        return 0;
+    int64_t id = mp_load_lazy_builtin_script(mpctx, name);
+    return id > 0 ? id : -1;
 }
 
 bool mp_load_scripts(struct MPContext *mpctx)
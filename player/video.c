@@ -29,6 +29,7 @@
 #include "options/m_option.h"
 #include "common/common.h"
 #include "common/encode.h"
+#include "common/stats.h"
 #include "options/m_property.h"
 #include "osdep/timer.h"
 
@@ -174,6 +175,10 @@ int init_video_decoder(struct MPContext *mpctx, struct track *track)
     if (!track->stream)
         goto err_out;
 
+    track->dec = take_prefetched_decoder(mpctx, track);
+    if (track->dec)
+        return 1;
+
     struct mp_filter *parent = mpctx->filter_root;
 
     // If possible, set this as parent so the decoder gets the hwdec and DR
@@ -232,7 +237,9 @@ void reinit_video_chain_src(struct MPContext *mpctx, struct track *track)
             .wakeup_cb = mp_wakeup_core_cb,
             .wakeup_ctx = mpctx,
         };
+        int64_t start = mp_time_ns();
         mpctx->video_out = init_best_video_out(mpctx->global, &ex);
+        mp_startup_phase(mpctx, "VO init", start);
         if (!mpctx->video_out) {
             MP_FATAL(mpctx, "Error opening/initializing "
                     "the selected video_out (--vo) device.\n");
@@ -1265,6 +1272,8 @@ void write_video(struct MPContext *mpctx)
     mpctx->osd_force_update = true;
     update_osd_msg(mpctx);
 
+    stats_trace_event(mpctx->stats, "video", "vo-queue", mpctx->video_pts);
+
     vo_queue_frame(vo, frame);
 
     check_framedrop(mpctx, vo_c);
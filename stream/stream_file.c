@@ -19,6 +19,8 @@
 
 #include "config.h"
 
+#include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -34,7 +36,10 @@
 #include "common/common.h"
 #include "common/msg.h"
 #include "misc/thread_tools.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
 #include "stream.h"
+#include "options/m_config.h"
 #include "options/m_option.h"
 #include "options/path.h"
 
@@ -85,6 +90,24 @@ typedef enum _FSINFOCLASS {
 #endif
 #endif
 
+struct stream_file_opts {
+    int readahead;
+};
+
+#define OPT_BASE_STRUCT struct stream_file_opts
+
+const struct m_sub_options stream_file_conf = {
+    .opts = (const m_option_t[]) {
+        {"stream-file-readahead", OPT_CHOICE(readahead,
+            {"no", 0}, {"auto", -1}, {"yes", 1})},
+        {0}
+    },
+    .size = sizeof(struct stream_file_opts),
+    .defaults = &(const struct stream_file_opts){
+        .readahead = -1,
+    },
+};
+
 struct priv {
     int fd;
     bool close;
@@ -92,13 +115,59 @@ struct priv {
     bool regular_file;
     bool appending;
     int64_t orig_size;
+    int64_t pos;                // position of the next read
     struct mp_cancel *cancel;
+    struct readahead *ra;
 };
 
 // Total timeout = RETRY_TIMEOUT * MAX_RETRIES
 #define RETRY_TIMEOUT 0.2
 #define MAX_RETRIES 10
 
+// Read-ahead: I/O threads read aligned blocks following the current position
+// with pread(), so that reading overlaps with demuxing. The number of blocks
+// read ahead is derived from the observed read latency and the rate at which
+// blocks are consumed.
+#define RA_BLOCK_SIZE (256 * 1024)
+#define RA_MAX_BLOCKS 16
+#define RA_MIN_DEPTH 2
+#define RA_MAX_THREADS 4
+
+enum ra_state {
+    RA_EMPTY,
+    RA_READING,
+    RA_DONE,
+};
+
+struct ra_block {
+    int64_t index;              // file offset / RA_BLOCK_SIZE
+    enum ra_state state;
+    int len;                    // for RA_DONE; < RA_BLOCK_SIZE on EOF/error
+    char *data;                 // allocated on first use
+};
+
+struct readahead {
+    struct mp_log *log;
+    int fd;
+    struct mp_cancel *cancel;   // wakes up the reader
+    mp_mutex lock;
+    mp_cond wakeup;             // state changes, for both sides
+
+    mp_thread threads[RA_MAX_THREADS];
+
+    // --- protected by lock
+    int num_threads;
+    bool terminate;
+    int64_t first;              // block the reader is in
+    int depth;                  // number of blocks to keep read ahead
+    struct ra_block blocks[RA_MAX_BLOCKS]; // blocks[index % RA_MAX_BLOCKS]
+    double latency_ns;          // average pread() time per block
+    double interval_ns;         // average time the reader spends per block
+    int64_t last_advance;       // time the reader entered the current block
+    // Statistics.
+    int64_t num_reads, num_stalls;
+};
+
 static int64_t get_size(stream_t *s)
 {
     struct priv *p = s->priv;
@@ -112,11 +181,215 @@ static int64_t get_size(stream_t *s)
     return -1;
 }
 
+#ifndef _WIN32
+
+// Average a new sample into *avg.
+static void ra_average(double *avg, double sample)
+{
+    *avg = *avg ? *avg * 0.8 + sample * 0.2 : sample;
+}
+
+static void ra_update_depth(struct readahead *ra)
+{
+    int depth = RA_MIN_DEPTH;
+    if (ra->interval_ns > 0)
+        depth = ceil(ra->latency_ns / ra->interval_ns) + 1;
+    ra->depth = MPCLAMP(depth, RA_MIN_DEPTH, RA_MAX_BLOCKS);
+}
+
+// Pick the nearest block in the read-ahead window that needs to be read.
+static struct ra_block *ra_claim_block(struct readahead *ra)
+{
+    for (int64_t n = ra->first; n < ra->first + ra->depth; n++) {
+        struct ra_block *b = &ra->blocks[n % RA_MAX_BLOCKS];
+        if (b->index == n && b->state != RA_EMPTY)
+            continue;
+        // A stale block can be reused only once its read is done.
+        if (b->state == RA_READING)
+            continue;
+        // Only as many blocks as the depth ever reached get allocated.
+        if (!b->data)
+            b->data = talloc_size(ra, RA_BLOCK_SIZE);
+        b->index = n;
+        b->state = RA_READING;
+        return b;
+    }
+    return NULL;
+}
+
+static MP_THREAD_VOID ra_thread(void *arg)
+{
+    struct readahead *ra = arg;
+
+    mp_thread_set_name("file-read");
+
+    mp_mutex_lock(&ra->lock);
+    while (!ra->terminate) {
+        struct ra_block *b = ra_claim_block(ra);
+        if (!b) {
+            mp_cond_wait(&ra->wakeup, &ra->lock);
+            continue;
+        }
+        int64_t index = b->index;
+        mp_mutex_unlock(&ra->lock);
+
+        int64_t start = mp_time_ns();
+        ssize_t r = pread(ra->fd, b->data, RA_BLOCK_SIZE,
+                          index * RA_BLOCK_SIZE);
+        int64_t latency = mp_time_ns() - start;
+
+        mp_mutex_lock(&ra->lock);
+        b->state = RA_DONE;
+        b->len = MPMAX(r, 0);
+        ra->num_reads += 1;
+        ra_average(&ra->latency_ns, latency);
+        ra_update_depth(ra);
+        mp_cond_broadcast(&ra->wakeup);
+    }
+    mp_mutex_unlock(&ra->lock);
+
+    MP_THREAD_RETURN();
+}
+
+// Must be called with ra->lock held.
+static void ra_add_threads(struct readahead *ra)
+{
+    int want = MPMIN(ra->depth, RA_MAX_THREADS);
+    while (ra->num_threads < want) {
+        if (mp_thread_create(&ra->threads[ra->num_threads], ra_thread, ra))
+            break;
+        ra->num_threads++;
+    }
+}
+
+static void ra_cancel_cb(void *ctx)
+{
+    struct readahead *ra = ctx;
+    mp_mutex_lock(&ra->lock);
+    mp_cond_broadcast(&ra->wakeup);
+    mp_mutex_unlock(&ra->lock);
+}
+
+static void ra_destroy(void *ptr)
+{
+    struct readahead *ra = ptr;
+
+    mp_cancel_set_cb(ra->cancel, NULL, NULL);
+
+    mp_mutex_lock(&ra->lock);
+    ra->terminate = true;
+    mp_cond_broadcast(&ra->wakeup);
+    mp_mutex_unlock(&ra->lock);
+
+    for (int n = 0; n < ra->num_threads; n++)
+        mp_thread_join(ra->threads[n]);
+
+    MP_VERBOSE(ra, "read-ahead: %"PRId64" blocks, %"PRId64" stalls, "
+               "latency %.1f ms, depth %d\n", ra->num_reads, ra->num_stalls,
+               MP_TIME_NS_TO_MS(ra->latency_ns), ra->depth);
+
+    mp_mutex_destroy(&ra->lock);
+    mp_cond_destroy(&ra->wakeup);
+}
+
+static struct readahead *ra_create(stream_t *s, int fd,
+                                   struct mp_cancel *cancel)
+{
+    struct readahead *ra = talloc_ptrtype(s, ra);
+    *ra = (struct readahead){
+        .log = s->log,
+        .fd = fd,
+        .cancel = cancel,
+        .depth = RA_MIN_DEPTH,
+        .last_advance = mp_time_ns(),
+    };
+    for (int n = 0; n < RA_MAX_BLOCKS; n++)
+        ra->blocks[n] = (struct ra_block){ .index = -1 };
+    mp_mutex_init(&ra->lock);
+    mp_cond_init(&ra->wakeup);
+
+    mp_mutex_lock(&ra->lock);
+    ra_add_threads(ra);
+    bool ok = ra->num_threads > 0;
+    mp_mutex_unlock(&ra->lock);
+    if (!ok) {
+        mp_mutex_destroy(&ra->lock);
+        mp_cond_destroy(&ra->wakeup);
+        talloc_free(ra);
+        return NULL;
+    }
+    talloc_set_destructor(ra, ra_destroy);
+    mp_cancel_set_cb(cancel, ra_cancel_cb, ra);
+    return ra;
+}
+
+// Read from the read-ahead blocks. Returns -1 if the caller should read
+// directly, which is the case at EOF (the file might be growing) and on errors.
+// Returns 0 if the stream was cancelled while waiting for the block.
+static int ra_read(struct readahead *ra, int64_t pos, void *buffer, int max_len)
+{
+    int64_t index = pos / RA_BLOCK_SIZE;
+    int offset = pos % RA_BLOCK_SIZE;
+
+    mp_mutex_lock(&ra->lock);
+
+    if (index != ra->first) {
+        int64_t now = mp_time_ns();
+        // Only sequential reads say something about the consumption rate.
+        if (index == ra->first + 1)
+            ra_average(&ra->interval_ns, now - ra->last_advance);
+        ra->last_advance = now;
+        ra->first = index;
+        ra_update_depth(ra);
+        ra_add_threads(ra);
+        mp_cond_broadcast(&ra->wakeup);
+    }
+
+    struct ra_block *b = &ra->blocks[index % RA_MAX_BLOCKS];
+    bool stalled = false;
+    while (b->index != index || b->state != RA_DONE) {
+        if (mp_cancel_test(ra->cancel)) {
+            mp_mutex_unlock(&ra->lock);
+            return 0;
+        }
+        stalled = true;
+        mp_cond_wait(&ra->wakeup, &ra->lock);
+    }
+    ra->num_stalls += stalled;
+
+    int r = -1;
+    if (offset < b->len) {
+        r = MPMIN(max_len, b->len - offset);
+        memcpy(buffer, b->data + offset, r);
+    } else {
+        // Don't keep the short block around; the file might grow.
+        b->state = RA_EMPTY;
+        b->index = -1;
+    }
+
+    mp_mutex_unlock(&ra->lock);
+    return r;
+}
+
+#endif
+
 static int fill_buffer(stream_t *s, void *buffer, int max_len)
 {
     struct priv *p = s->priv;
 
 #ifndef _WIN32
+    if (p->ra) {
+        int r = ra_read(p->ra, p->pos, buffer, max_len);
+        if (r > 0) {
+            p->pos += r;
+            return r;
+        }
+        if (r == 0)
+            return -1;
+        if (lseek(p->fd, p->pos, SEEK_SET) == (off_t)-1)
+            return 0;
+    }
+
     if (p->use_poll) {
         int c = mp_cancel_get_fd(p->cancel);
         struct pollfd fds[2] = {
@@ -131,8 +404,10 @@ static int fill_buffer(stream_t *s, void *buffer, int max_len)
 
     for (int retries = 0; retries < MAX_RETRIES; retries++) {
         int r = read(p->fd, buffer, max_len);
-        if (r > 0)
+        if (r > 0) {
+            p->pos += r;
             return r;
+        }
 
         // Try to detect and handle files being appended during playback.
         int64_t size = get_size(s);
@@ -161,12 +436,21 @@ static int write_buffer(stream_t *s, void *buffer, int len)
 static int seek(stream_t *s, int64_t newpos)
 {
     struct priv *p = s->priv;
-    return lseek(p->fd, newpos, SEEK_SET) != (off_t)-1;
+    if (lseek(p->fd, newpos, SEEK_SET) == (off_t)-1)
+        return 0;
+    p->pos = newpos;
+#ifdef POSIX_FADV_WILLNEED
+    // Let the kernel start reading at the new position right away.
+    if (p->regular_file && !p->ra)
+        posix_fadvise(p->fd, newpos, RA_BLOCK_SIZE, POSIX_FADV_WILLNEED);
+#endif
+    return 1;
 }
 
 static void s_close(stream_t *s)
 {
     struct priv *p = s->priv;
+    TA_FREEP(&p->ra);
     if (p->close)
         close(p->fd);
 }
@@ -397,6 +681,24 @@ static int open_f(stream_t *stream, const struct stream_open_args *args)
     if (stream->cancel)
         mp_cancel_set_parent(p->cancel, stream->cancel);
 
+#ifndef _WIN32
+    if (p->regular_file && !write && !p->appending) {
+        struct stream_file_opts *opts =
+            mp_get_config_group(NULL, stream->global, &stream_file_conf);
+        bool readahead = opts->readahead > 0 ||
+                         (opts->readahead < 0 && stream->streaming);
+        talloc_free(opts);
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(p->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        if (readahead) {
+            p->ra = ra_create(stream, p->fd, p->cancel);
+            MP_VERBOSE(stream, "read-ahead %s\n",
+                       p->ra ? "enabled" : "could not be started");
+        }
+    }
+#endif
+
     return STREAM_OK;
 }
 
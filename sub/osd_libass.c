@@ -176,6 +176,35 @@ static ASS_Event *add_osd_ass_event(ASS_Track *track, const char *style,
     return event;
 }
 
+// Set the text of event n, reusing the event if the text is the same. Events
+// past the end of the track are appended.
+static void set_osd_ass_event(ASS_Track *track, int n, const char *style,
+                              const char *text)
+{
+    if (n >= track->n_events) {
+        add_osd_ass_event(track, style, text);
+        return;
+    }
+    ASS_Event *event = track->events + n;
+    if (event->Text && strcmp(event->Text, text) == 0)
+        return;
+    ass_free_event(track, n);
+    *event = (ASS_Event){
+        .Duration = 100,
+        .Style = find_style(track, style, 0),
+        .ReadOrder = n,
+        .Text = strdup(text),
+    };
+}
+
+// Remove all events starting with index n.
+static void truncate_ass_events(ASS_Track *track, int n)
+{
+    for (int i = n; i < track->n_events; i++)
+        ass_free_event(track, i);
+    track->n_events = MPMIN(track->n_events, n);
+}
+
 static void clear_ass(struct ass_state *ass)
 {
     if (ass->track)
@@ -515,8 +544,6 @@ static void update_external(struct osd_state *osd, struct osd_object *obj,
     ext->ass.res_y = ext->ov.res_y;
     create_ass_track(osd, obj, &ext->ass);
 
-    clear_ass(&ext->ass);
-
     int resy = ext->ass.track->PlayResY;
     mp_ass_set_style(get_style(&ext->ass, "OSD"), resy, osd->opts->osd_style);
 
@@ -524,15 +551,28 @@ static void update_external(struct osd_state *osd, struct osd_object *obj,
     const struct osd_style_opts *def = osd_style_conf.defaults;
     mp_ass_set_style(get_style(&ext->ass, "Default"), resy, def);
 
+    // Scripts typically change only a few lines per update, so keep the
+    // events of unchanged lines instead of rebuilding the whole track.
+    int num_events = 0;
     while (t.len) {
         bstr line;
         bstr_split_tok(t, "\n", &line, &t);
         if (line.len) {
             char *tmp = bstrdup0(NULL, line);
-            add_osd_ass_event(ext->ass.track, "OSD", tmp);
+            set_osd_ass_event(ext->ass.track, num_events++, "OSD", tmp);
             talloc_free(tmp);
         }
     }
+    truncate_ass_events(ext->ass.track, num_events);
+}
+
+static bool external_unchanged(struct osd_external *e,
+                               struct osd_external_ass *ov)
+{
+    return e->ov.data && e->ov.format == ov->format &&
+           e->ov.res_x == ov->res_x && e->ov.res_y == ov->res_y &&
+           e->ov.z == ov->z && e->ov.hidden == ov->hidden &&
+           strcmp(e->ov.data, ov->data) == 0;
 }
 
 static int cmp_zorder(const void *pa, const void *pb)
@@ -580,7 +620,9 @@ void osd_set_external(struct osd_state *osd, struct osd_external_ass *ov)
         goto done;
     }
 
-    if (!entry->ov.hidden || !ov->hidden) {
+    // An identical update changes nothing, so don't force a redraw. If the
+    // rendering changes anyway (e.g. OSD style options), libass reports it.
+    if ((!entry->ov.hidden || !ov->hidden) && !external_unchanged(entry, ov)) {
         obj->changed = true;
         osd->want_redraw_notification = true;
     }
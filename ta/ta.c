@@ -14,6 +14,7 @@
  */
 
 #include <assert.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -39,6 +40,9 @@ struct ta_header {
     struct ta_header *child;    // points to first child
     struct ta_header *parent;   // set for _first_ child only, NULL otherwise
     void (*destructor)(void *);
+    // Invariant: arena!=NULL => the allocation is in the tree of arena->root
+    struct ta_arena *arena;     // where children are allocated (NULL: malloc)
+    struct ta_chunk *chunk;     // arena chunk containing this (NULL: malloc)
 #if TA_MEMORY_DEBUGGING
     unsigned int canary;
     struct ta_header *leak_next;
@@ -65,6 +69,28 @@ union aligned_header {
 
 #define MAX_ALLOC (((size_t)-1) - sizeof(union aligned_header))
 
+#define ALIGN_SIZE(s) (((s) + MIN_ALIGN - 1) & ~(MIN_ALIGN - 1))
+
+#define CHUNK_MIN_SIZE (4 * 1024)
+#define CHUNK_MAX_SIZE (64 * 1024)
+
+// Memory block arena allocations are carved from. It's freed once all
+// allocations in it were freed, and the arena moved on to another chunk (or
+// was freed itself). Allocations stolen out of the arena's tree keep their
+// chunk alive, so they remain valid even after the arena is gone.
+struct ta_chunk {
+    atomic_size_t refs;         // live allocations, +1 while the current chunk
+};
+
+#define CHUNK_HEADER_SIZE ALIGN_SIZE(sizeof(struct ta_chunk))
+
+struct ta_arena {
+    struct ta_header *root;     // allocation created by ta_zalloc_arena_size()
+    struct ta_chunk *chunk;     // current chunk
+    char *ptr, *end;            // unused part of the current chunk
+    size_t chunk_size;          // size of the next chunk
+};
+
 static void ta_dbg_add(struct ta_header *h);
 static void ta_dbg_check_header(struct ta_header *h);
 static void ta_dbg_remove(struct ta_header *h);
@@ -76,6 +102,81 @@ static struct ta_header *get_header(void *ptr)
     return h;
 }
 
+// Number of arena chunks that weren't freed yet, for tests.
+static atomic_size_t live_chunks;
+
+static bool is_arena_root(struct ta_header *h)
+{
+    return h->arena && h->arena->root == h;
+}
+
+static void chunk_unref(struct ta_chunk *c)
+{
+    if (atomic_fetch_sub(&c->refs, 1) == 1) {
+        free(c);
+        atomic_fetch_sub(&live_chunks, 1);
+    }
+}
+
+/* Allocate a header followed by size bytes. Small allocations are taken from
+ * the arena if there is one, everything else from malloc(). The header is
+ * initialized with only size and chunk set.
+ */
+static struct ta_header *alloc_header(struct ta_arena *arena, size_t size,
+                                      bool zero)
+{
+    size_t full = sizeof(union aligned_header) + size;
+    struct ta_header *h;
+    if (arena && full <= arena->chunk_size / 4) {
+        full = ALIGN_SIZE(full);
+        if ((size_t)(arena->end - arena->ptr) < full) {
+            struct ta_chunk *c = malloc(arena->chunk_size);
+            if (!c)
+                return NULL;
+            atomic_init(&c->refs, 1);
+            atomic_fetch_add(&live_chunks, 1);
+            if (arena->chunk)
+                chunk_unref(arena->chunk);
+            arena->chunk = c;
+            arena->ptr = (char *)c + CHUNK_HEADER_SIZE;
+            arena->end = (char *)c + arena->chunk_size;
+            if (arena->chunk_size < CHUNK_MAX_SIZE)
+                arena->chunk_size *= 2;
+        }
+        h = (struct ta_header *)arena->ptr;
+        arena->ptr += full;
+        atomic_fetch_add(&arena->chunk->refs, 1);
+        if (zero)
+            memset(h, 0, full);
+        *h = (struct ta_header) {.size = size, .chunk = arena->chunk};
+    } else {
+        h = zero ? calloc(1, full) : malloc(full);
+        if (!h)
+            return NULL;
+        *h = (struct ta_header) {.size = size};
+    }
+    return h;
+}
+
+static void free_header(struct ta_header *h)
+{
+    if (h->chunk) {
+        chunk_unref(h->chunk);
+    } else {
+        free(h);
+    }
+}
+
+// Stop allocating from arena for h and its descendants.
+static void clear_arena(struct ta_header *h, struct ta_arena *arena)
+{
+    h->arena = NULL;
+    for (struct ta_header *c = h->child; c; c = c->next) {
+        if (c->arena == arena)
+            clear_arena(c, arena);
+    }
+}
+
 /* Set the parent allocation of ptr. If parent==NULL, remove the parent.
  * Setting parent==NULL (with ptr!=NULL) unsets the parent of ptr.
  * With ptr==NULL, the function does nothing.
@@ -115,6 +216,11 @@ void ta_set_parent(void *ptr, void *ta_parent)
         new_parent->child = ch;
         ch->parent = new_parent;
     }
+    // Allocations moved out of an arena's tree must not use the arena anymore,
+    // because it could be freed, or be in use by another thread.
+    struct ta_arena *arena = new_parent ? new_parent->arena : NULL;
+    if (ch->arena && ch->arena != arena && !is_arena_root(ch))
+        clear_arena(ch, ch->arena);
 }
 
 /* Return the parent allocation, or NULL if none or if ptr==NULL.
@@ -136,10 +242,12 @@ void *ta_alloc_size(void *ta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
-    struct ta_header *h = malloc(sizeof(union aligned_header) + size);
+    struct ta_header *parent = get_header(ta_parent);
+    struct ta_header *h = alloc_header(parent ? parent->arena : NULL, size,
+                                       false);
     if (!h)
         return NULL;
-    *h = (struct ta_header) {.size = size};
+    h->arena = parent ? parent->arena : NULL;
     ta_dbg_add(h);
     void *ptr = PTR_FROM_HEADER(h);
     ta_set_parent(ptr, ta_parent);
@@ -153,10 +261,12 @@ void *ta_zalloc_size(void *ta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
-    struct ta_header *h = calloc(1, sizeof(union aligned_header) + size);
+    struct ta_header *parent = get_header(ta_parent);
+    struct ta_header *h = alloc_header(parent ? parent->arena : NULL, size,
+                                       true);
     if (!h)
         return NULL;
-    *h = (struct ta_header) {.size = size};
+    h->arena = parent ? parent->arena : NULL;
     ta_dbg_add(h);
     void *ptr = PTR_FROM_HEADER(h);
     ta_set_parent(ptr, ta_parent);
@@ -189,13 +299,44 @@ void *ta_realloc_size(void *ta_parent, void *ptr, size_t size)
     struct ta_header *old_h = h;
     if (h->size == size)
         return ptr;
-    ta_dbg_remove(h);
-    h = realloc(h, sizeof(union aligned_header) + size);
-    ta_dbg_add(h ? h : old_h);
-    if (!h)
-        return NULL;
+    if (h->chunk) {
+        struct ta_arena *arena = h->arena;
+        size_t old_full = ALIGN_SIZE(sizeof(union aligned_header) + h->size);
+        size_t new_full = ALIGN_SIZE(sizeof(union aligned_header) + size);
+        // Shrink in place, or grow in place if it's the last allocation in the
+        // arena's current chunk.
+        if (size < h->size) {
+            h->size = size;
+            return ptr;
+        }
+        if (arena && h->chunk == arena->chunk &&
+            (char *)h + old_full == arena->ptr &&
+            new_full - old_full <= (size_t)(arena->end - arena->ptr))
+        {
+            arena->ptr += new_full - old_full;
+            h->size = size;
+            return ptr;
+        }
+        h = alloc_header(arena, size, false);
+        if (!h)
+            return NULL;
+        struct ta_chunk *chunk = h->chunk;
+        ta_dbg_remove(old_h);
+        memcpy(h, old_h, sizeof(union aligned_header) + old_h->size);
+        h->chunk = chunk;
+        free_header(old_h);
+        ta_dbg_add(h);
+    } else {
+        ta_dbg_remove(h);
+        h = realloc(h, sizeof(union aligned_header) + size);
+        ta_dbg_add(h ? h : old_h);
+        if (!h)
+            return NULL;
+    }
     h->size = size;
     if (h != old_h) {
+        if (h->arena && h->arena->root == old_h)
+            h->arena->root = h;
         // Relink parent
         if (h->parent)
             h->parent->child = h;
@@ -243,7 +384,45 @@ void ta_free(void *ptr)
     ta_free_children(ptr);
     ta_set_parent(ptr, NULL);
     ta_dbg_remove(h);
-    free(h);
+    if (is_arena_root(h)) {
+        if (h->arena->chunk)
+            chunk_unref(h->arena->chunk);
+        free(h->arena);
+    }
+    free_header(h);
+}
+
+/* Like ta_zalloc_size(), but make the new allocation an arena: allocations
+ * whose parent is the arena, or (recursively) a child of it, are carved out of
+ * larger memory chunks instead of being allocated with malloc() one by one.
+ * This is meant for trees of many small allocations that are freed all at
+ * once, such as mpv_node trees.
+ *
+ * Everything else works as usual. Destructors are run, and allocations can be
+ * freed, reallocated, or moved to other parents, even after the arena itself
+ * was freed. But the memory of an arena chunk is released only once all
+ * allocations in it were freed, and reallocations that grow a block always
+ * copy it. Allocations that are moved out of the arena's tree stop using the
+ * arena for new children, while allocations moved into the tree keep using
+ * malloc().
+ */
+void *ta_zalloc_arena_size(void *ta_parent, size_t size)
+{
+    struct ta_arena *arena = malloc(sizeof(*arena));
+    if (!arena)
+        return NULL;
+    void *ptr = ta_zalloc_size(ta_parent, size);
+    if (!ptr) {
+        free(arena);
+        return NULL;
+    }
+    struct ta_header *h = get_header(ptr);
+    *arena = (struct ta_arena) {
+        .root = h,
+        .chunk_size = CHUNK_MIN_SIZE,
+    };
+    h->arena = arena;
+    return ptr;
 }
 
 /* Set a destructor that is to be called when the given allocation is freed.
@@ -263,6 +442,12 @@ void ta_set_destructor(void *ptr, void (*destructor)(void *))
         h->destructor = destructor;
 }
 
+// Return the number of arena chunks currently allocated.
+size_t ta_dbg_arena_chunks(void)
+{
+    return atomic_load(&live_chunks);
+}
+
 #if TA_MEMORY_DEBUGGING
 
 #include "osdep/threads.h"
@@ -53,6 +53,7 @@ void ta_free_children(void *ptr);
 void ta_set_destructor(void *ptr, void (*destructor)(void *));
 void ta_set_parent(void *ptr, void *ta_parent);
 void *ta_get_parent(void *ptr);
+void *ta_zalloc_arena_size(void *ta_parent, size_t size);
 
 // Utility functions
 size_t ta_calc_array_size(size_t element_size, size_t count);
@@ -76,6 +77,13 @@ bool ta_vasprintf_append_buffer(char **str, const char *fmt, va_list ap) TA_PRF(
 #define ta_new(ta_parent, type)  (type *)ta_alloc_size(ta_parent, sizeof(type))
 #define ta_znew(ta_parent, type) (type *)ta_zalloc_size(ta_parent, sizeof(type))
 
+// Arena memory is released per chunk: a chunk stays allocated until every
+// allocation carved from it was freed, including allocations that were moved
+// out of the arena's tree. Keeping one small allocation pins its whole chunk.
+#define ta_new_arena(ta_parent)  ta_zalloc_arena_size(ta_parent, 0)
+#define ta_znew_arena(ta_parent, type) \
+    (type *)ta_zalloc_arena_size(ta_parent, sizeof(type))
+
 #define ta_new_array(ta_parent, type, count) \
     (type *)ta_alloc_size(ta_parent, ta_calc_array_size(sizeof(type), count))
 
@@ -129,6 +137,8 @@ bool ta_vasprintf_append_buffer(char **str, const char *fmt, va_list ap) TA_PRF(
 #define ta_xvasprintf_append_buffer(...) ta_oom_b(ta_vasprintf_append_buffer(__VA_ARGS__))
 #define ta_xnew(...)                    ta_oom_g(ta_new(__VA_ARGS__))
 #define ta_xznew(...)                   ta_oom_g(ta_znew(__VA_ARGS__))
+#define ta_xnew_arena(...)              ta_oom_p(ta_new_arena(__VA_ARGS__))
+#define ta_xznew_arena(...)             ta_oom_g(ta_znew_arena(__VA_ARGS__))
 #define ta_xnew_array(...)              ta_oom_g(ta_new_array(__VA_ARGS__))
 #define ta_xznew_array(...)             ta_oom_g(ta_znew_array(__VA_ARGS__))
 #define ta_xnew_array_size(...)         ta_oom_p(ta_new_array_size(__VA_ARGS__))
@@ -148,6 +158,7 @@ void *ta_xrealloc_size(void *ta_parent, void *ptr, size_t size);
 #ifndef TA_NO_WRAPPERS
 #define ta_alloc_size(...)      ta_dbg_set_loc(ta_alloc_size(__VA_ARGS__), TA_LOC)
 #define ta_zalloc_size(...)     ta_dbg_set_loc(ta_zalloc_size(__VA_ARGS__), TA_LOC)
+#define ta_zalloc_arena_size(...) ta_dbg_set_loc(ta_zalloc_arena_size(__VA_ARGS__), TA_LOC)
 #define ta_realloc_size(...)    ta_dbg_set_loc(ta_realloc_size(__VA_ARGS__), TA_LOC)
 #define ta_memdup(...)          ta_dbg_set_loc(ta_memdup(__VA_ARGS__), TA_LOC)
 #define ta_xmemdup(...)         ta_dbg_set_loc(ta_xmemdup(__VA_ARGS__), TA_LOC)
@@ -178,6 +189,7 @@ static inline char *ta_oom_s(char *s)
 #define ta_oom_g(ptr) (TA_TYPEOF(ptr))ta_oom_p(ptr)
 
 void ta_enable_leak_report(void);
+size_t ta_dbg_arena_chunks(void);
 void *ta_dbg_set_loc(void *ptr, const char *name);
 void *ta_dbg_mark_as_string(void *ptr);
 
@@ -37,6 +37,8 @@
 #define talloc_steal                    ta_steal
 #define talloc_realloc_size             ta_xrealloc_size
 #define talloc_new                      ta_xnew_context
+#define talloc_new_arena                ta_xnew_arena
+#define talloc_zero_arena               ta_xznew_arena
 #define talloc_set_destructor           ta_set_destructor
 #define talloc_enable_leak_report       ta_enable_leak_report
 #define talloc_size                     ta_xalloc_size
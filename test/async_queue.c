@@ -0,0 +1,228 @@
+#include <inttypes.h>
+
+#include "audio/aframe.h"
+#include "audio/chmap.h"
+#include "audio/format.h"
+#include "common/common.h"
+#include "common/global.h"
+#include "filters/f_async_queue.h"
+#include "filters/filter_internal.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
+#include "test_utils.h"
+#include "video/hwdec.h"
+
+// Not needed for audio frames.
+struct demux_packet *demux_copy_packet(struct demux_packet *dp) { abort(); }
+int64_t mp_pts_to_av(double mp_pts, AVRational *tb) { abort(); }
+double mp_pts_from_av(int64_t av_pts, AVRational *tb) { abort(); }
+void hwdec_devices_request_for_img_fmt(struct mp_hwdec_devices *devs,
+                                       struct hwdec_imgfmt_request *params) {}
+struct mp_hwdec_ctx *hwdec_devices_get_by_imgfmt_and_type(
+    struct mp_hwdec_devices *devs, int hw_imgfmt,
+    enum AVHWDeviceType device_type) { return NULL; }
+
+#define NUM_FRAMES 5000
+#define BENCH_FRAMES 200000
+#define FRAME_SAMPLES 64
+
+// A filter graph run by its own thread.
+struct runner {
+    struct mp_filter *root;
+    mp_mutex lock;
+    mp_cond wakeup;
+    bool woken;
+    bool eof;
+    bool done;
+    int64_t num_frames; // source only: frames to send before EOF
+    int64_t frames, samples;
+    double last_pts;
+};
+
+static void wakeup_cb(void *ctx)
+{
+    struct runner *r = ctx;
+    mp_mutex_lock(&r->lock);
+    r->woken = true;
+    mp_cond_signal(&r->wakeup);
+    mp_mutex_unlock(&r->lock);
+}
+
+static MP_THREAD_VOID run_thread(void *arg)
+{
+    struct runner *r = arg;
+    while (!r->done) {
+        mp_filter_graph_run(r->root);
+        mp_mutex_lock(&r->lock);
+        while (!r->woken && !r->done)
+            mp_cond_wait(&r->wakeup, &r->lock);
+        r->woken = false;
+        mp_mutex_unlock(&r->lock);
+    }
+    MP_THREAD_RETURN();
+}
+
+static struct mp_aframe *template;
+
+static void source_process(struct mp_filter *f)
+{
+    struct runner *r = f->priv;
+    if (r->done || !mp_pin_in_needs_data(f->ppins[0]))
+        return;
+    if (r->eof) {
+        // The queue took the EOF frame.
+        r->done = true;
+        return;
+    }
+    if (r->frames == r->num_frames) {
+        mp_pin_in_write(f->ppins[0], MP_EOF_FRAME);
+        r->eof = true;
+        return;
+    }
+    struct mp_aframe *a = mp_aframe_new_ref(template);
+    mp_aframe_set_pts(a, r->frames * FRAME_SAMPLES / 48000.0);
+    mp_pin_in_write(f->ppins[0], MAKE_FRAME(MP_FRAME_AUDIO, a));
+    r->frames += 1;
+    r->samples += FRAME_SAMPLES;
+}
+
+static const struct mp_filter_info source_filter = {
+    .name = "source",
+    .process = source_process,
+};
+
+static void sink_process(struct mp_filter *f)
+{
+    struct runner *r = f->priv;
+    if (!mp_pin_out_request_data(f->ppins[0]))
+        return;
+    struct mp_frame frame = mp_pin_out_read(f->ppins[0]);
+    if (frame.type == MP_FRAME_EOF) {
+        mp_mutex_lock(&r->lock);
+        r->done = true;
+        mp_mutex_unlock(&r->lock);
+        return;
+    }
+    assert_int_equal(frame.type, MP_FRAME_AUDIO);
+    double pts = mp_frame_get_pts(frame);
+    assert_true(pts > r->last_pts);
+    r->last_pts = pts;
+    r->frames += 1;
+    r->samples += mp_aframe_get_size(frame.data);
+    mp_frame_unref(&frame);
+    mp_pin_out_request_data_next(f->ppins[0]);
+}
+
+static const struct mp_filter_info sink_filter = {
+    .name = "sink",
+    .process = sink_process,
+};
+
+static struct mp_filter *create_runner(struct mpv_global *global,
+                                       struct runner *r,
+                                       const struct mp_filter_info *info,
+                                       enum mp_pin_dir dir)
+{
+    *r = (struct runner){
+        .root = mp_filter_create_root(global),
+        .last_pts = MP_NOPTS_VALUE,
+    };
+    mp_mutex_init(&r->lock);
+    mp_cond_init(&r->wakeup);
+    mp_filter_graph_set_wakeup_cb(r->root, wakeup_cb, r);
+
+    struct mp_filter *f = mp_filter_create(r->root, info);
+    mp_filter_add_pin(f, dir, dir == MP_PIN_OUT ? "out" : "in");
+    f->priv = r;
+    return f;
+}
+
+static void destroy_runner(struct runner *r)
+{
+    talloc_free(r->root);
+    mp_mutex_destroy(&r->lock);
+    mp_cond_destroy(&r->wakeup);
+}
+
+// Send num_frames through the queue, and print the time it took if bench is set.
+static void run_queue(struct mpv_global *global, struct mp_async_queue_config cfg,
+                      int64_t num_frames, bool bench)
+{
+    struct runner src, sink;
+    struct mp_filter *src_f = create_runner(global, &src, &source_filter, MP_PIN_OUT);
+    struct mp_filter *sink_f = create_runner(global, &sink, &sink_filter, MP_PIN_IN);
+    src.num_frames = num_frames;
+
+    struct mp_async_queue *queue = mp_async_queue_create();
+    mp_async_queue_set_config(queue, cfg);
+    struct mp_filter *in = mp_async_queue_create_filter(src.root, MP_PIN_IN, queue);
+    struct mp_filter *out = mp_async_queue_create_filter(sink.root, MP_PIN_OUT, queue);
+    mp_pin_connect(in->pins[0], src_f->pins[0]);
+    mp_pin_connect(sink_f->pins[0], out->pins[0]);
+    mp_async_queue_resume_reading(queue);
+
+    int64_t start = mp_time_ns();
+    mp_thread src_thread, sink_thread;
+    assert_false(mp_thread_create(&src_thread, run_thread, &src));
+    assert_false(mp_thread_create(&sink_thread, run_thread, &sink));
+    mp_thread_join(src_thread);
+    mp_thread_join(sink_thread);
+    double ms = MP_TIME_NS_TO_MS(mp_time_ns() - start);
+
+    if (bench) {
+        printf("%s, max %"PRId64" samples: %"PRId64" frames: %.1f ms "
+               "(%.0f frames/s)\n", cfg.lockless ? "lockless" : "locked",
+               cfg.max_samples, num_frames, ms, num_frames / (ms / 1e3));
+    }
+
+    assert_int_equal(sink.frames, num_frames);
+    assert_int_equal(sink.samples, src.samples);
+    assert_int_equal(mp_async_queue_get_frames(queue), 0);
+    assert_int_equal(mp_async_queue_get_samples(queue), 0);
+
+    talloc_free(queue);
+    destroy_runner(&src);
+    destroy_runner(&sink);
+}
+
+int main(int argc, char *argv[])
+{
+    mp_time_init();
+
+    // Send many frames and print the throughput.
+    bool bench = test_is_bench(argc, argv);
+    int64_t num_frames = bench ? BENCH_FRAMES : NUM_FRAMES;
+
+    struct mpv_global *global = talloc_zero(NULL, struct mpv_global);
+
+    template = mp_aframe_create();
+    mp_aframe_set_format(template, AF_FORMAT_FLOAT);
+    mp_aframe_set_chmap(template, &(struct mp_chmap)MP_CHMAP_INIT_STEREO);
+    mp_aframe_set_rate(template, 48000);
+    assert_true(mp_aframe_alloc_data(template, FRAME_SAMPLES));
+
+    int64_t sizes[] = {FRAME_SAMPLES, FRAME_SAMPLES * 64, FRAME_SAMPLES * 1024};
+    for (int n = 0; n < MP_ARRAY_SIZE(sizes); n++) {
+        for (int lockless = 0; lockless < 2; lockless++) {
+            run_queue(global, (struct mp_async_queue_config){
+                .sample_unit = AQUEUE_UNIT_SAMPLES,
+                .max_samples = sizes[n],
+                .max_bytes = INT64_MAX,
+                .lockless = lockless,
+            }, num_frames, bench);
+        }
+    }
+
+    // Duration limit, as used by the decoder queue.
+    run_queue(global, (struct mp_async_queue_config){
+        .sample_unit = AQUEUE_UNIT_SAMPLES,
+        .max_samples = INT64_MAX,
+        .max_bytes = INT64_MAX,
+        .max_duration = 0.1,
+        .lockless = true,
+    }, num_frames, bench);
+
+    talloc_free(template);
+    talloc_free(global);
+    return 0;
+}
@@ -0,0 +1,722 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Headless end-to-end benchmark. Run with "meson compile pipeline-bench" (or
+// "meson test --benchmark"), or directly with the names of the scenarios to
+// run as arguments. The results are written to stdout as JSON, progress
+// messages to stderr.
+//
+// The test media is generated with lavfi sources in a directory under $TMPDIR
+// (or /tmp) before the scenarios run.
+// The frame and second counts are read from the player after each run: video
+// frames shown (dropped frames don't count), seconds of audio played, or the
+// duration of the demuxed data.
+// CPU time is reported per thread name (threads created by a named thread,
+// like libavcodec's, inherit its name). Per-thread CPU time and the per-run
+// peak RSS are available on Linux only.
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <libmpv/client.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// Stolen from osdep/compiler.h
+#ifdef __GNUC__
+#define PRINTF_ATTRIBUTE(a1, a2) __attribute__ ((format(printf, a1, a2)))
+#define MP_NORETURN __attribute__((noreturn))
+#else
+#define PRINTF_ATTRIBUTE(a1, a2)
+#define MP_NORETURN
+#endif
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define ARRAY_SIZE(x) ((int)(sizeof(x) / sizeof((x)[0])))
+
+#define DURATION 20
+#define FPS 30
+
+#define NUM_SUB_RENDERS 300
+#define NUM_IPC_REQUESTS 20000
+#define IPC_BATCH 100
+#define NUM_SEEKS 200
+
+#define MAX_THREADS 256
+
+// Global handle
+static mpv_handle *ctx;
+// Temporary files
+static char tmp_dir[256];
+static char media_path[300], sub_path[300], ipc_path[300];
+
+static void exit_cleanup(void)
+{
+    if (ctx)
+        mpv_destroy(ctx);
+    if (tmp_dir[0]) {
+        unlink(media_path);
+        unlink(sub_path);
+        unlink(ipc_path);
+        rmdir(tmp_dir);
+    }
+}
+
+MP_NORETURN PRINTF_ATTRIBUTE(1, 2)
+static void fail(const char *fmt, ...)
+{
+    if (fmt) {
+        va_list va;
+        va_start(va, fmt);
+        vfprintf(stderr, fmt, va);
+        va_end(va);
+    }
+    exit(1);
+}
+
+static void check_api_error(int status)
+{
+    if (status < 0)
+        fail("libmpv error: %s\n", mpv_error_string(status));
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct thread_cpu {
+    long tid;
+    char name[16];
+    double secs;
+};
+
+// Return the CPU time of all threads of this process.
+static int read_thread_cpu(struct thread_cpu *threads)
+{
+    int num = 0;
+#ifdef __linux__
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir)
+        return 0;
+    double tick = sysconf(_SC_CLK_TCK);
+    struct dirent *ent;
+    while (num < MAX_THREADS && (ent = readdir(dir))) {
+        if (ent->d_name[0] == '.')
+            continue;
+        char path[300], buf[512];
+        snprintf(path, sizeof(path), "/proc/self/task/%s/stat", ent->d_name);
+        FILE *fp = fopen(path, "r");
+        if (!fp)
+            continue; // thread exited
+        size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+        fclose(fp);
+        buf[len] = '\0';
+        char *name = strchr(buf, '(');
+        char *end = strrchr(buf, ')');
+        unsigned long utime, stime;
+        if (!name || !end || sscanf(end + 2, "%*c %*d %*d %*d %*d %*d %*u %*u "
+                                    "%*u %*u %*u %lu %lu", &utime, &stime) != 2)
+            continue;
+        struct thread_cpu *t = &threads[num++];
+        t->tid = atol(ent->d_name);
+        snprintf(t->name, sizeof(t->name), "%.*s", (int)(end - name - 1), name + 1);
+        t->secs = (utime + stime) / tick;
+    }
+    closedir(dir);
+#endif
+    return num;
+}
+
+static double process_cpu(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+static void reset_peak_rss(void)
+{
+#ifdef __linux__
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (fp) {
+        fputs("5", fp);
+        fclose(fp);
+    }
+#endif
+}
+
+// In KiB. Falls back to the peak of the whole process.
+static long peak_rss(void)
+{
+#ifdef __linux__
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp) {
+        char line[128];
+        long kb = -1;
+        while (fgets(line, sizeof(line), fp)) {
+            if (sscanf(line, "VmHWM: %ld kB", &kb) == 1)
+                break;
+        }
+        fclose(fp);
+        if (kb >= 0)
+            return kb;
+    }
+#endif
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+}
+
+struct result {
+    double start_time, start_cpu;
+    struct thread_cpu start_threads[MAX_THREADS];
+    int num_start_threads;
+
+    double wall, cpu;
+    struct thread_cpu stages[MAX_THREADS];
+    int num_stages;
+    long rss;
+};
+
+static void measure_start(struct result *r)
+{
+    r->num_start_threads = read_thread_cpu(r->start_threads);
+    r->start_cpu = process_cpu();
+    r->start_time = now();
+}
+
+// Must be called before the threads of interest exit.
+static void measure_stop(struct result *r)
+{
+    r->wall = now() - r->start_time;
+    r->cpu = process_cpu() - r->start_cpu;
+    r->rss = peak_rss();
+
+    struct thread_cpu threads[MAX_THREADS];
+    int num = read_thread_cpu(threads);
+    for (int n = 0; n < num; n++) {
+        struct thread_cpu *t = &threads[n];
+        for (int i = 0; i < r->num_start_threads; i++) {
+            if (r->start_threads[i].tid == t->tid)
+                t->secs -= r->start_threads[i].secs;
+        }
+        struct thread_cpu *stage = NULL;
+        for (int i = 0; i < r->num_stages; i++) {
+            if (strcmp(r->stages[i].name, t->name) == 0)
+                stage = &r->stages[i];
+        }
+        if (!stage) {
+            stage = &r->stages[r->num_stages++];
+            *stage = (struct thread_cpu){0};
+            snprintf(stage->name, sizeof(stage->name), "%s", t->name);
+        }
+        stage->secs += t->secs;
+    }
+}
+
+// opts is a NULL terminated list of option name/value pairs.
+static void create(const char *const *opts)
+{
+    ctx = mpv_create();
+    if (!ctx)
+        fail("could not create mpv handle\n");
+
+    static const char *const defaults[] = {
+        "config", "no",
+        "load-scripts", "no",
+        "ytdl", "no",
+        "input-default-bindings", "no",
+        "terminal", "no",
+        "vo", "null",
+        "ao", "null",
+        "keep-open", "yes",
+        NULL
+    };
+    for (int n = 0; defaults[n]; n += 2)
+        check_api_error(mpv_set_option_string(ctx, defaults[n], defaults[n + 1]));
+    for (int n = 0; opts && opts[n]; n += 2)
+        check_api_error(mpv_set_option_string(ctx, opts[n], opts[n + 1]));
+
+    check_api_error(mpv_initialize(ctx));
+}
+
+static void destroy(void)
+{
+    mpv_destroy(ctx);
+    ctx = NULL;
+}
+
+static void loadfile(const char *path)
+{
+    const char *cmd[] = {"loadfile", path, NULL};
+    check_api_error(mpv_command(ctx, cmd));
+}
+
+static void wait_event(mpv_event_id id)
+{
+    while (1) {
+        mpv_event *ev = mpv_wait_event(ctx, -1.0);
+        if (ev->event_id == id)
+            return;
+        if (ev->event_id == MPV_EVENT_END_FILE) {
+            mpv_event_end_file *ef = ev->data;
+            if (ef->reason == MPV_END_FILE_REASON_ERROR)
+                fail("playback failed: %s\n", mpv_error_string(ef->error));
+        }
+        if (ev->event_id == MPV_EVENT_SHUTDOWN)
+            fail("unexpected shutdown\n");
+    }
+}
+
+// Wait until playback reaches the end (the player pauses due to keep-open).
+static void wait_eof(void)
+{
+    check_api_error(mpv_observe_property(ctx, 0, "eof-reached", MPV_FORMAT_FLAG));
+    while (1) {
+        mpv_event *ev = mpv_wait_event(ctx, -1.0);
+        if (ev->event_id == MPV_EVENT_PROPERTY_CHANGE) {
+            mpv_event_property *prop = ev->data;
+            if (prop->format == MPV_FORMAT_FLAG && *(int *)prop->data)
+                return;
+        }
+        if (ev->event_id == MPV_EVENT_END_FILE || ev->event_id == MPV_EVENT_SHUTDOWN)
+            fail("playback ended early\n");
+    }
+}
+
+// Wait until the demuxer has cached the whole file. Returns the end of the
+// cached range in seconds.
+static double wait_cached(void)
+{
+    const uint64_t id = 1;
+    check_api_error(mpv_observe_property(ctx, id, "demuxer-cache-state",
+                                         MPV_FORMAT_NODE));
+    bool eof = false;
+    double end = 0;
+    while (!eof) {
+        mpv_event *ev = mpv_wait_event(ctx, -1.0);
+        if (ev->event_id == MPV_EVENT_PROPERTY_CHANGE && ev->reply_userdata == id) {
+            mpv_event_property *prop = ev->data;
+            mpv_node *node = prop->data;
+            if (prop->format != MPV_FORMAT_NODE || node->format != MPV_FORMAT_NODE_MAP)
+                continue;
+            for (int n = 0; n < node->u.list->num; n++) {
+                mpv_node *val = &node->u.list->values[n];
+                if (strcmp(node->u.list->keys[n], "eof") == 0 &&
+                    val->format == MPV_FORMAT_FLAG)
+                    eof = val->u.flag;
+                if (strcmp(node->u.list->keys[n], "cache-end") == 0 &&
+                    val->format == MPV_FORMAT_DOUBLE)
+                    end = val->u.double_;
+            }
+        }
+        if (ev->event_id == MPV_EVENT_END_FILE || ev->event_id == MPV_EVENT_SHUTDOWN)
+            fail("playback ended before the file was cached\n");
+    }
+    check_api_error(mpv_unobserve_property(ctx, id));
+    return end;
+}
+
+static double get_double_property(const char *name)
+{
+    double val;
+    check_api_error(mpv_get_property(ctx, name, MPV_FORMAT_DOUBLE, &val));
+    return val;
+}
+
+static int64_t get_int_property(const char *name)
+{
+    int64_t val;
+    check_api_error(mpv_get_property(ctx, name, MPV_FORMAT_INT64, &val));
+    return val;
+}
+
+// Number of video frames shown up to the current position.
+static double frames_shown(void)
+{
+    return get_int_property("estimated-frame-number") + 1 -
+           get_int_property("frame-drop-count") -
+           get_int_property("decoder-frame-drop-count");
+}
+
+static void generate_media(void)
+{
+    create((const char *[]){
+        "o", media_path,
+        "vo", "lavc",
+        "ao", "lavc",
+        "keep-open", "no",
+        "ovc", "mpeg4",
+        "ovcopts", "b=8M",
+        "oac", "flac",
+        "end", XSTR(DURATION),
+        "audio-files", "av://lavfi:sine=frequency=440:sample_rate=48000",
+        NULL
+    });
+    check_api_error(mpv_set_option_string(ctx, "idle", "once"));
+    loadfile("av://lavfi:testsrc2=size=1280x720:rate=" XSTR(FPS));
+    while (mpv_wait_event(ctx, -1.0)->event_id != MPV_EVENT_SHUTDOWN) {}
+    destroy();
+
+    // Overlapping, styled events, several per second.
+    FILE *fp = fopen(sub_path, "w");
+    if (!fp)
+        fail("could not write %s\n", sub_path);
+    fprintf(fp, "[Script Info]\nScriptType: v4.00+\nPlayResX: 1280\nPlayResY: 720\n\n"
+                "[V4+ Styles]\n"
+                "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, "
+                "OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, "
+                "ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, "
+                "Alignment, MarginL, MarginR, MarginV, Encoding\n"
+                "Style: Default,sans-serif,48,&H00FFFFFF,&H000000FF,&H00000000,"
+                "&H80000000,0,0,0,0,100,100,0,0,1,3,2,2,20,20,20,1\n\n"
+                "[Events]\n"
+                "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, "
+                "Effect, Text\n");
+    for (int n = 0; n < DURATION * 10; n++) {
+        int start = n * 10, end = start + 50; // centiseconds
+        fprintf(fp, "Dialogue: 0,0:%02d:%02d.%02d,0:%02d:%02d.%02d,Default,,0,0,0,,"
+                    "{\\pos(%d,%d)\\blur2\\frz%d}Line %d with {\\b1}some{\\b0} "
+                    "styled {\\c&H00FFFF&}text\\Nand a second line\n",
+                start / 6000, start / 100 % 60, start % 100,
+                end / 6000, end / 100 % 60, end % 100,
+                100 + n * 37 % 1080, 80 + n * 53 % 600, n % 30 - 15, n);
+    }
+    fclose(fp);
+}
+
+static double bench_demux(struct result *r)
+{
+    create((const char *[]){
+        "pause", "yes",
+        "cache", "yes",
+        "demuxer-readahead-secs", "100000",
+        "demuxer-max-bytes", "1GiB",
+        NULL
+    });
+    measure_start(r);
+    loadfile(media_path);
+    double end = wait_cached();
+    measure_stop(r);
+    destroy();
+    return end * FPS;
+}
+
+// Returns the number of video frames shown, or the seconds of audio played if
+// there is no video.
+static double play(struct result *r, const char *const *opts)
+{
+    create(opts);
+    measure_start(r);
+    loadfile(media_path);
+    wait_eof();
+    measure_stop(r);
+    int64_t vid;
+    bool video = mpv_get_property(ctx, "current-tracks/video/id",
+                                  MPV_FORMAT_INT64, &vid) >= 0;
+    double count = video ? frames_shown() : get_double_property("audio-pts");
+    destroy();
+    return count;
+}
+
+static double bench_decode(struct result *r)
+{
+    return play(r, (const char *[]){
+        "untimed", "yes",
+        "ao-null-untimed", "yes",
+        "framedrop", "no",
+        NULL
+    });
+}
+
+static double bench_scale_sws(struct result *r)
+{
+    return play(r, (const char *[]){
+        "untimed", "yes",
+        "aid", "no",
+        "framedrop", "no",
+        "vf", "format=fmt=bgra:w=1920:h=1080:convert=yes:force-scaler=sws",
+        NULL
+    });
+}
+
+static double bench_scale_zimg(struct result *r)
+{
+    return play(r, (const char *[]){
+        "untimed", "yes",
+        "aid", "no",
+        "framedrop", "no",
+        "vf", "format=fmt=bgra:w=1920:h=1080:convert=yes:force-scaler=zimg",
+        NULL
+    });
+}
+
+static double bench_audio_filters(struct result *r)
+{
+    return play(r, (const char *[]){
+        "vid", "no",
+        "ao-null-untimed", "yes",
+        "af", "scaletempo2,lavfi=[volume=0.5],format=srate=44100",
+        "speed", "1.5",
+        NULL
+    });
+}
+
+static double bench_sub_render(struct result *r)
+{
+    create((const char *[]){"pause", "yes", "sub-files", sub_path, NULL});
+    loadfile(media_path);
+    wait_event(MPV_EVENT_PLAYBACK_RESTART);
+
+    measure_start(r);
+    for (int n = 0; n < NUM_SUB_RENDERS; n++) {
+        // Show different subtitle events without seeking the video.
+        double delay = -(n % (DURATION * 10 - 1)) * 0.1;
+        check_api_error(mpv_set_property(ctx, "sub-delay", MPV_FORMAT_DOUBLE, &delay));
+        const char *cmd[] = {"screenshot-raw", "subtitles", NULL};
+        mpv_node res;
+        check_api_error(mpv_command_ret(ctx, cmd, &res));
+        mpv_free_node_contents(&res);
+    }
+    measure_stop(r);
+    destroy();
+    return NUM_SUB_RENDERS;
+}
+
+static void ipc_send(int fd, const char *s)
+{
+    size_t len = strlen(s);
+    while (len) {
+        ssize_t w = write(fd, s, len);
+        if (w <= 0)
+            fail("ipc write failed\n");
+        s += w;
+        len -= w;
+    }
+}
+
+// Read until num replies (lines) were received.
+static void ipc_wait_replies(int fd, int num)
+{
+    char buf[4096];
+    while (num > 0) {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len <= 0)
+            fail("ipc read failed\n");
+        for (ssize_t n = 0; n < len; n++)
+            num -= buf[n] == '\n';
+    }
+}
+
+static double bench_ipc(struct result *r)
+{
+    create((const char *[]){"pause", "yes", "input-ipc-server", ipc_path, NULL});
+    loadfile(media_path);
+    wait_event(MPV_EVENT_PLAYBACK_RESTART);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", ipc_path);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+        fail("could not connect to %s\n", ipc_path);
+    ipc_send(fd, "{\"command\": [\"disable_event\", \"all\"]}\n");
+    ipc_wait_replies(fd, 1);
+
+    // What a typical frontend polls.
+    static const char *const props[] = {
+        "time-pos", "pause", "duration", "volume", "track-list",
+        "demuxer-cache-state", "metadata", "chapter-list",
+    };
+
+    measure_start(r);
+    for (int n = 0; n < NUM_IPC_REQUESTS; n += IPC_BATCH) {
+        char req[IPC_BATCH * 64] = "";
+        size_t len = 0;
+        for (int i = 0; i < IPC_BATCH; i++) {
+            len += snprintf(req + len, sizeof(req) - len,
+                            "{\"command\": [\"get_property\", \"%s\"]}\n",
+                            props[(n + i) % ARRAY_SIZE(props)]);
+        }
+        ipc_send(fd, req);
+        ipc_wait_replies(fd, IPC_BATCH);
+    }
+    measure_stop(r);
+    close(fd);
+    destroy();
+    return NUM_IPC_REQUESTS;
+}
+
+static double bench_cache_seek(struct result *r)
+{
+    create((const char *[]){
+        "pause", "yes",
+        "cache", "yes",
+        "demuxer-readahead-secs", "100000",
+        "demuxer-max-bytes", "1GiB",
+        NULL
+    });
+    loadfile(media_path);
+    wait_event(MPV_EVENT_PLAYBACK_RESTART);
+    wait_cached();
+
+    uint32_t rnd = 1;
+    measure_start(r);
+    for (int n = 0; n < NUM_SEEKS; n++) {
+        rnd = rnd * 1664525 + 1013904223;
+        char target[32];
+        snprintf(target, sizeof(target), "%.3f", (rnd >> 8) % (DURATION * 1000) / 1e3);
+        const char *cmd[] = {"seek", target, "absolute", NULL};
+        check_api_error(mpv_command(ctx, cmd));
+        wait_event(MPV_EVENT_PLAYBACK_RESTART);
+    }
+    measure_stop(r);
+    destroy();
+    return NUM_SEEKS;
+}
+
+static const struct scenario {
+    const char *name;
+    const char *unit;
+    double (*run)(struct result *r);
+} scenarios[] = {
+    {"demux", "frames", bench_demux},
+    {"decode", "frames", bench_decode},
+    {"decode-scale-sws", "frames", bench_scale_sws},
+    {"decode-scale-zimg", "frames", bench_scale_zimg},
+    {"audio-filters", "seconds", bench_audio_filters},
+    {"sub-render", "renders", bench_sub_render},
+    {"ipc-poll", "requests", bench_ipc},
+    {"cache-seek", "seeks", bench_cache_seek},
+};
+
+// Print s as JSON string literal.
+static void print_json_string(const char *s)
+{
+    putchar('"');
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+static bool selected(const char *name, int argc, char *argv[])
+{
+    for (int n = 1; n < argc; n++) {
+        if (strcmp(argv[n], name) == 0)
+            return true;
+    }
+    return argc < 2;
+}
+
+int main(int argc, char *argv[])
+{
+    for (int n = 1; n < argc; n++) {
+        bool found = false;
+        for (int i = 0; i < ARRAY_SIZE(scenarios); i++)
+            found |= strcmp(argv[n], scenarios[i].name) == 0;
+        if (!found)
+            fail("unknown scenario: %s\n", argv[n]);
+    }
+
+    atexit(exit_cleanup);
+
+    const char *tmp = getenv("TMPDIR");
+    if (!tmp || !tmp[0])
+        tmp = "/tmp";
+    int len = snprintf(tmp_dir, sizeof(tmp_dir), "%s/mpv-bench.XXXXXX", tmp);
+    if (len < 0 || len >= (int)sizeof(tmp_dir) || !mkdtemp(tmp_dir))
+        fail("could not create temporary directory in %s\n", tmp);
+    snprintf(media_path, sizeof(media_path), "%s/media.mkv", tmp_dir);
+    snprintf(sub_path, sizeof(sub_path), "%s/subs.ass", tmp_dir);
+    snprintf(ipc_path, sizeof(ipc_path), "%s/ipc", tmp_dir);
+    // Unix socket paths are short.
+    if (strlen(ipc_path) >= sizeof(((struct sockaddr_un *)0)->sun_path))
+        fail("TMPDIR path too long: %s\n", tmp);
+
+    fprintf(stderr, "generating test media\n");
+    generate_media();
+
+    create(NULL);
+    char *version = mpv_get_property_string(ctx, "mpv-version");
+    printf("{\n  \"mpv-version\": ");
+    print_json_string(version ? version : "");
+    printf(",\n  \"scenarios\": [");
+    mpv_free(version);
+    destroy();
+
+    const char *sep = "";
+    for (int n = 0; n < ARRAY_SIZE(scenarios); n++) {
+        const struct scenario *s = &scenarios[n];
+        if (!selected(s->name, argc, argv))
+            continue;
+        fprintf(stderr, "running %s\n", s->name);
+
+        static struct result r;
+        r = (struct result){0};
+        reset_peak_rss();
+        double count = s->run(&r);
+
+        printf("%s\n    {\n", sep);
+        printf("      \"name\": \"%s\",\n", s->name);
+        printf("      \"unit\": \"%s\",\n", s->unit);
+        printf("      \"count\": %.6g,\n", count);
+        printf("      \"wall-time\": %.6f,\n", r.wall);
+        printf("      \"per-second\": %.3f,\n", count / r.wall);
+        printf("      \"cpu-time\": %.6f,\n", r.cpu);
+        printf("      \"cpu-time-per-thread\": {");
+        const char *tsep = "";
+        for (int i = 0; i < r.num_stages; i++) {
+            if (r.stages[i].secs <= 0)
+                continue;
+            printf("%s\n        ", tsep);
+            print_json_string(r.stages[i].name);
+            printf(": %.6f", r.stages[i].secs);
+            tsep = ",";
+        }
+        printf("%s},\n", tsep[0] ? "\n      " : "");
+        printf("      \"peak-rss-kib\": %ld\n", r.rss);
+        printf("    }");
+        sep = ",";
+        fflush(stdout);
+    }
+    printf("\n  ]\n}\n");
+
+    return 0;
+}
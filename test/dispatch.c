@@ -0,0 +1,162 @@
+#include <stdatomic.h>
+
+#include "common/common.h"
+#include "misc/dispatch.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
+#include "test_utils.h"
+
+#define MAX_PRODUCERS 8
+#define NUM_ITEMS 100000
+
+struct consumer {
+    struct mp_dispatch_queue *queue;
+    bool use_wakeup_fn;
+    mp_mutex lock;
+    mp_cond wakeup;
+    bool woken;
+    atomic_int wakeups;
+    // --- only accessed by the consumer thread
+    bool done;
+    int next_seq[MAX_PRODUCERS];
+    int64_t items;
+};
+
+struct item {
+    struct consumer *c;
+    int producer;
+    int seq;
+};
+
+struct producer {
+    struct consumer *c;
+    int index;
+    mp_thread thread;
+};
+
+// Like mp_wakeup_core().
+static void wakeup_fn(void *ctx)
+{
+    struct consumer *c = ctx;
+    atomic_fetch_add(&c->wakeups, 1);
+    mp_mutex_lock(&c->lock);
+    c->woken = true;
+    mp_cond_signal(&c->wakeup);
+    mp_mutex_unlock(&c->lock);
+}
+
+static void item_fn(void *ptr)
+{
+    struct item *it = ptr;
+    struct consumer *c = it->c;
+    // Items of each producer must run in submission order.
+    assert_int_equal(it->seq, c->next_seq[it->producer]);
+    c->next_seq[it->producer] += 1;
+    c->items += 1;
+}
+
+static void sync_fn(void *ptr)
+{
+    struct consumer *c = ptr;
+    c->items += 1;
+}
+
+static void stop_fn(void *ptr)
+{
+    struct consumer *c = ptr;
+    c->done = true;
+}
+
+static MP_THREAD_VOID consumer_thread(void *arg)
+{
+    struct consumer *c = arg;
+    while (!c->done) {
+        if (!c->use_wakeup_fn) {
+            mp_dispatch_queue_process(c->queue, 1000);
+            continue;
+        }
+        mp_dispatch_queue_process(c->queue, 0);
+        mp_mutex_lock(&c->lock);
+        while (!c->woken && !c->done)
+            mp_cond_wait(&c->wakeup, &c->lock);
+        c->woken = false;
+        mp_mutex_unlock(&c->lock);
+    }
+    MP_THREAD_RETURN();
+}
+
+static MP_THREAD_VOID producer_thread(void *arg)
+{
+    struct producer *p = arg;
+    struct consumer *c = p->c;
+    for (int n = 0; n < NUM_ITEMS; n++) {
+        struct item *it = talloc_ptrtype(NULL, it);
+        *it = (struct item){c, p->index, n};
+        mp_dispatch_enqueue_autofree(c->queue, item_fn, it);
+        // Mix in the synchronous calls libmpv clients make.
+        if (n % 1000 == 0)
+            mp_dispatch_run(c->queue, sync_fn, c);
+        if (n % 1000 == 500) {
+            mp_dispatch_lock(c->queue);
+            c->items += 1;
+            mp_dispatch_unlock(c->queue);
+        }
+    }
+    MP_THREAD_RETURN();
+}
+
+static void run(int num_producers, bool use_wakeup_fn, bool bench)
+{
+    struct consumer c = {
+        .queue = mp_dispatch_create(NULL),
+        .use_wakeup_fn = use_wakeup_fn,
+    };
+    mp_mutex_init(&c.lock);
+    mp_cond_init(&c.wakeup);
+    if (use_wakeup_fn)
+        mp_dispatch_set_wakeup_fn(c.queue, wakeup_fn, &c);
+
+    mp_thread consumer;
+    struct producer producers[MAX_PRODUCERS];
+    int64_t start = mp_time_ns();
+    assert_false(mp_thread_create(&consumer, consumer_thread, &c));
+    for (int n = 0; n < num_producers; n++) {
+        producers[n] = (struct producer){&c, n};
+        assert_false(mp_thread_create(&producers[n].thread, producer_thread,
+                                      &producers[n]));
+    }
+    for (int n = 0; n < num_producers; n++)
+        mp_thread_join(producers[n].thread);
+    mp_dispatch_run(c.queue, stop_fn, &c);
+    if (use_wakeup_fn)
+        wakeup_fn(&c);
+    mp_thread_join(consumer);
+    double ms = MP_TIME_NS_TO_MS(mp_time_ns() - start);
+
+    int64_t total = (int64_t)num_producers * NUM_ITEMS;
+    if (bench) {
+        printf("%d producers, %s: %.1f ms (%.0f items/s), %d wakeups\n",
+               num_producers, use_wakeup_fn ? "wakeup_fn" : "condition", ms,
+               total / (ms / 1e3), atomic_load(&c.wakeups));
+    }
+
+    for (int n = 0; n < num_producers; n++)
+        assert_int_equal(c.next_seq[n], NUM_ITEMS);
+    assert_int_equal(c.items, total + num_producers * (NUM_ITEMS / 1000) * 2);
+
+    talloc_free(c.queue);
+    mp_mutex_destroy(&c.lock);
+    mp_cond_destroy(&c.wakeup);
+}
+
+int main(int argc, char *argv[])
+{
+    mp_time_init();
+
+    bool bench = test_is_bench(argc, argv);
+    for (int n = 1; n <= MAX_PRODUCERS; n *= 2) {
+        run(n, false, bench);
+        run(n, true, bench);
+    }
+    return 0;
+}
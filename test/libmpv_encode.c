@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <libmpv/client.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -46,15 +47,17 @@
 
 // Global handle
 static mpv_handle *ctx;
-// Temporary output file
-static const char *out_path;
+// Temporary output files
+static char out_paths[3][32];
 
 static void exit_cleanup(void)
 {
     if (ctx)
         mpv_destroy(ctx);
-    if (out_path && *out_path)
-        unlink(out_path);
+    for (int n = 0; n < 3; n++) {
+        if (out_paths[n][0])
+            unlink(out_paths[n]);
+    }
 }
 
 MP_NORETURN PRINTF_ATTRIBUTE(1, 2)
@@ -87,6 +90,56 @@ static void wait_done(void)
     }
 }
 
+static const char *make_tmpfile(int n)
+{
+    snprintf(out_paths[n], sizeof(out_paths[n]), "./testout.XXXXXX");
+
+#ifdef _WIN32
+    if (!_mktemp(out_paths[n]) || !out_paths[n][0])
+        fail("tmpfile failed\n");
+#else
+    int fd = mkstemp(out_paths[n]);
+    if (fd == -1)
+        fail("tmpfile failed\n");
+    close(fd);
+#endif
+
+    return out_paths[n];
+}
+
+// Video only, and video with audio.
+#define SOURCE_V "av://lavfi:testsrc"
+#define SOURCE_AV "av://lavfi:testsrc[out0];sine[out1]"
+
+// Encode 1.5 seconds of a test source. opts is a NULL terminated list of
+// option name/value pairs.
+static void encode(const char *source, const char *out_path,
+                   const char *const *opts)
+{
+    ctx = mpv_create();
+    if (!ctx)
+        exit(1);
+
+    check_api_error(mpv_set_option_string(ctx, "o", out_path));
+    check_api_error(mpv_set_option_string(ctx, "end", "1.5"));
+    check_api_error(mpv_set_option_string(ctx, "terminal", "yes"));
+    check_api_error(mpv_set_option_string(ctx, "msg-level", "all=v"));
+    for (int n = 0; opts[n]; n += 2)
+        check_api_error(mpv_set_option_string(ctx, opts[n], opts[n + 1]));
+
+    if (mpv_initialize(ctx) != 0)
+        exit(1);
+
+    check_api_error(mpv_set_option_string(ctx, "idle", "once"));
+
+    const char *cmd[] = {"loadfile", source, NULL};
+    check_api_error(mpv_command(ctx, cmd));
+
+    wait_done();
+    mpv_destroy(ctx);
+    ctx = NULL;
+}
+
 static void check_output(FILE *fp)
 {
     fseek(fp, 0, SEEK_END);
@@ -104,44 +157,104 @@ static void check_output(FILE *fp)
     puts("output file ok");
 }
 
-int main(int argc, char *argv[])
-{
-    atexit(exit_cleanup);
+#define MAX_PACKETS 1000
+#define MAX_STREAMS 4
 
-    ctx = mpv_create();
-    if (!ctx)
-        return 1;
+// Read the video packet timestamps from a framecrc file, and check that the
+// dts of each stream increase, and that the streams are interleaved by dts.
+// Returns the number of video packets.
+static int read_framecrc(const char *path, int64_t *pts)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        fail("output file doesn't exist\n");
 
-    static char path[] = "./testout.XXXXXX";
+    int tb_num[MAX_STREAMS] = {0}, tb_den[MAX_STREAMS] = {0};
+    bool video[MAX_STREAMS] = {0};
+    int64_t last_dts[MAX_STREAMS];
+    for (int n = 0; n < MAX_STREAMS; n++)
+        last_dts[n] = INT64_MIN;
+    double max_dts = -1e9;
+    int num = 0, num_total = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        int stream, a, b;
+        char type[16];
+        int64_t dts, p;
+        if (sscanf(line, "#tb %d: %d/%d", &stream, &a, &b) == 3) {
+            if (stream < 0 || stream >= MAX_STREAMS || !a || !b)
+                fail("bad stream header '%s'\n", line);
+            tb_num[stream] = a;
+            tb_den[stream] = b;
+            continue;
+        }
+        if (sscanf(line, "#media_type %d: %15s", &stream, type) == 2) {
+            if (stream < 0 || stream >= MAX_STREAMS)
+                fail("bad stream header '%s'\n", line);
+            video[stream] = strcmp(type, "video") == 0;
+            continue;
+        }
+        if (line[0] == '#')
+            continue;
+        if (num_total++ == MAX_PACKETS)
+            fail("too many packets\n");
+        if (sscanf(line, "%d, %"SCNd64", %"SCNd64",", &stream, &dts, &p) != 3)
+            fail("could not parse '%s'\n", line);
+        if (stream < 0 || stream >= MAX_STREAMS || !tb_den[stream])
+            fail("packet for unknown stream in %s\n", path);
+        if (dts <= last_dts[stream])
+            fail("non-monotonic dts in %s\n", path);
+        last_dts[stream] = dts;
+        // lavf interleaves by dts; allow for rounding between time bases.
+        double t = dts * (double)tb_num[stream] / tb_den[stream];
+        if (t < max_dts - 0.1) {
+            fail("stream %d not interleaved in %s: dts %f after %f\n",
+                 stream, path, t, max_dts);
+        }
+        max_dts = t > max_dts ? t : max_dts;
+        if (video[stream])
+            pts[num++] = p;
+    }
+    fclose(fp);
+    return num;
+}
 
-#ifdef _WIN32
-    out_path = _mktemp(path);
-    if (!out_path || !*out_path)
-        fail("tmpfile failed\n");
-#else
-    int fd = mkstemp(path);
-    if (fd == -1)
-        fail("tmpfile failed\n");
-    out_path = path;
-#endif
+static int compare_pts(const void *a, const void *b)
+{
+    int64_t pa = *(const int64_t *)a, pb = *(const int64_t *)b;
+    return pa < pb ? -1 : pa > pb;
+}
 
-    check_api_error(mpv_set_option_string(ctx, "o", out_path));
-    check_api_error(mpv_set_option_string(ctx, "of", "matroska"));
-    check_api_error(mpv_set_option_string(ctx, "end", "1.5"));
-    check_api_error(mpv_set_option_string(ctx, "terminal", "yes"));
-    check_api_error(mpv_set_option_string(ctx, "msg-level", "all=v"));
+// Encoding in parallel segments must produce the same video frames as
+// encoding sequentially.
+static void check_segments(const char *seq_path, const char *seg_path)
+{
+    static int64_t seq_pts[MAX_PACKETS], seg_pts[MAX_PACKETS];
+    int num_seq = read_framecrc(seq_path, seq_pts);
+    int num_seg = read_framecrc(seg_path, seg_pts);
+    if (num_seq < 30)
+        fail("did not encode anything\n");
+    if (num_seq != num_seg)
+        fail("frame count mismatch: %d != %d\n", num_seq, num_seg);
 
-    if (mpv_initialize(ctx) != 0)
-        return 1;
+    qsort(seq_pts, num_seq, sizeof(seq_pts[0]), compare_pts);
+    qsort(seg_pts, num_seg, sizeof(seg_pts[0]), compare_pts);
+    for (int n = 0; n < num_seq; n++) {
+        if (seq_pts[n] != seg_pts[n]) {
+            fail("timestamp mismatch at frame %d: %"PRId64" != %"PRId64"\n",
+                 n, seq_pts[n], seg_pts[n]);
+        }
+    }
 
-    check_api_error(mpv_set_option_string(ctx, "idle", "once"));
+    printf("segmented output ok (%d frames)\n", num_seg);
+}
 
-    const char *cmd[] = {"loadfile", "av://lavfi:testsrc", NULL};
-    check_api_error(mpv_command(ctx, cmd));
+int main(int argc, char *argv[])
+{
+    atexit(exit_cleanup);
 
-    wait_done();
-    mpv_destroy(ctx);
-    ctx = NULL;
+    const char *out_path = make_tmpfile(0);
+    encode(SOURCE_V, out_path, (const char *[]){"of", "matroska", NULL});
 
     FILE *output = fopen(out_path, "rb");
     if (!output)
@@ -149,5 +262,23 @@ int main(int argc, char *argv[])
     check_output(output);
     fclose(output);
 
+    // Use B-frames, so that the segment boundaries involve reordering. With
+    // audio, the audio packets are ready long before the video segments.
+    const char *sources[] = {SOURCE_V, SOURCE_AV};
+    for (int n = 0; n < 2; n++) {
+        const char *seq_path = make_tmpfile(1);
+        encode(sources[n], seq_path,
+               (const char *[]){"of", "framecrc", "ovc", "mpeg4",
+                                "ovcopts", "bf=2", NULL});
+        const char *seg_path = make_tmpfile(2);
+        encode(sources[n], seg_path,
+               (const char *[]){"of", "framecrc", "ovc", "mpeg4",
+                                "ovcopts", "bf=2", "ovsegments", "3",
+                                "ovsegment-length", "10", NULL});
+        check_segments(seq_path, seg_path);
+        unlink(seq_path);
+        unlink(seg_path);
+    }
+
     return 0;
 }
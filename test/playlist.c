@@ -0,0 +1,292 @@
+#include "common/common.h"
+#include "common/playlist.h"
+#include "demux/demux.h"
+#include "misc/random.h"
+#include "osdep/timer.h"
+#include "stream/stream.h"
+#include "test_utils.h"
+
+// Only needed by playlist_parse_file() and playlist_entry_new(), which use
+// the real implementations in the player.
+struct demuxer *demux_open_url(const char *url, struct demuxer_params *params,
+                               struct mp_cancel *cancel,
+                               struct mpv_global *global) { return NULL; }
+void demux_free(struct demuxer *demuxer) {}
+char *mp_file_url_to_filename(void *talloc_ctx, bstr url) { return NULL; }
+
+#define BENCH_ENTRIES 1000000
+#define BENCH_OPS 100000
+
+static int rand_int(int n)
+{
+    return n > 0 ? mp_rand_next() % n : 0;
+}
+
+static void check_model(struct playlist *pl, struct playlist_entry **model,
+                        int num)
+{
+    assert_int_equal(playlist_entry_count(pl), num);
+    struct playlist_entry *e = playlist_get_first(pl);
+    for (int n = 0; n < num; n++) {
+        assert_true(e == model[n]);
+        assert_true(playlist_entry_from_index(pl, n) == e);
+        assert_int_equal(playlist_entry_to_index(pl, e), n);
+        e = playlist_entry_get_rel(e, 1);
+    }
+    assert_true(!e);
+    assert_true(playlist_get_last(pl) == (num ? model[num - 1] : NULL));
+}
+
+// Apply the change records to a list of entry IDs.
+static void apply_changes(uint64_t **ids, int *num_ids,
+                          struct playlist_change **changes, int num_changes)
+{
+    for (int n = 0; n < num_changes; n++) {
+        struct playlist_change *c = changes[n];
+        switch (c->op) {
+        case PLAYLIST_CHANGE_INSERT:
+            for (int i = 0; i < c->count; i++) {
+                MP_TARRAY_INSERT_AT(NULL, *ids, *num_ids, c->index + i,
+                                    c->entries[i].id);
+            }
+            break;
+        case PLAYLIST_CHANGE_REMOVE:
+            for (int i = 0; i < c->count; i++)
+                MP_TARRAY_REMOVE_AT(*ids, *num_ids, c->index);
+            break;
+        case PLAYLIST_CHANGE_MOVE: {
+            uint64_t id = (*ids)[c->index];
+            MP_TARRAY_REMOVE_AT(*ids, *num_ids, c->index);
+            MP_TARRAY_INSERT_AT(NULL, *ids, *num_ids, c->to, id);
+            break;
+        }
+        case PLAYLIST_CHANGE_UPDATE:
+            break;
+        default:
+            abort();
+        }
+    }
+}
+
+static void check_changes(struct playlist *pl, uint64_t **ids, int *num_ids,
+                          uint64_t *generation)
+{
+    struct playlist_change **changes;
+    int num_changes;
+    assert_true(playlist_get_changes(pl, *generation, &changes, &num_changes));
+    apply_changes(ids, num_ids, changes, num_changes);
+    *generation = pl->generation;
+
+    assert_int_equal(*num_ids, playlist_entry_count(pl));
+    struct playlist_entry *e = playlist_get_first(pl);
+    for (int n = 0; n < *num_ids; n++) {
+        assert_int_equal((*ids)[n], e->id);
+        e = playlist_entry_get_rel(e, 1);
+    }
+}
+
+static void random_op(struct playlist *pl, struct playlist_entry ***model,
+                      int *num)
+{
+    switch (rand_int(3)) {
+    case 0: {
+        int index = rand_int(*num + 1);
+        struct playlist_entry *e = playlist_entry_new("file");
+        playlist_insert_at(pl, e, index < *num ? (*model)[index] : NULL);
+        MP_TARRAY_INSERT_AT(NULL, *model, *num, index, e);
+        break;
+    }
+    case 1: {
+        if (!*num)
+            break;
+        int index = rand_int(*num);
+        playlist_remove(pl, (*model)[index]);
+        MP_TARRAY_REMOVE_AT(*model, *num, index);
+        break;
+    }
+    case 2: {
+        if (!*num)
+            break;
+        int from = rand_int(*num);
+        int to = rand_int(*num + 1);
+        struct playlist_entry *e = (*model)[from];
+        struct playlist_entry *at = to < *num ? (*model)[to] : NULL;
+        playlist_move(pl, e, at);
+        if (e != at) {
+            MP_TARRAY_REMOVE_AT(*model, *num, from);
+            if (to > from)
+                to--;
+            MP_TARRAY_INSERT_AT(NULL, *model, *num, to, e);
+        }
+        break;
+    }
+    }
+}
+
+// Depth of the deepest entry in the tree.
+static int tree_depth(struct playlist *pl)
+{
+    int max = 0;
+    for (struct playlist_entry *e = playlist_get_first(pl); e;
+         e = playlist_entry_get_rel(e, 1))
+    {
+        int depth = 1;
+        for (struct playlist_entry *p = e; p->tree_parent; p = p->tree_parent)
+            depth++;
+        max = MPMAX(max, depth);
+    }
+    return max;
+}
+
+static double elapsed_ms(int64_t start)
+{
+    return MP_TIME_NS_TO_MS(mp_time_ns() - start);
+}
+
+// Timings with a large playlist. Run with "bench".
+static void bench(void)
+{
+    struct playlist *pl = talloc_zero(NULL, struct playlist);
+    int64_t start = mp_time_ns();
+    for (int n = 0; n < BENCH_ENTRIES; n++)
+        playlist_append_file(pl, "file");
+    printf("append %d entries: %.1f ms\n", BENCH_ENTRIES, elapsed_ms(start));
+
+    start = mp_time_ns();
+    playlist_shuffle(pl);
+    playlist_unshuffle(pl);
+    printf("shuffle + unshuffle: %.1f ms\n", elapsed_ms(start));
+
+    start = mp_time_ns();
+    for (int n = 0; n < BENCH_OPS; n++) {
+        int count = playlist_entry_count(pl);
+        struct playlist_entry *e = playlist_entry_from_index(pl, rand_int(count));
+        struct playlist_entry *at = playlist_entry_from_index(pl, rand_int(count));
+        switch (n % 3) {
+        case 0:
+            playlist_insert_at(pl, playlist_entry_new("file"), at);
+            break;
+        case 1:
+            playlist_remove(pl, e);
+            break;
+        case 2:
+            playlist_move(pl, e, at);
+            break;
+        }
+    }
+    printf("%d random inserts/removes/moves: %.1f ms\n", BENCH_OPS,
+           elapsed_ms(start));
+
+    start = mp_time_ns();
+    int64_t sum = 0;
+    for (struct playlist_entry *e = playlist_get_first(pl); e;
+         e = playlist_entry_get_rel(e, 1))
+        sum += playlist_entry_to_index(pl, e);
+    printf("iterate + index lookups: %.1f ms\n", elapsed_ms(start));
+    int64_t count = playlist_entry_count(pl);
+    assert_int_equal(sum, count * (count - 1) / 2);
+
+    start = mp_time_ns();
+    playlist_clear(pl);
+    printf("clear: %.1f ms\n", elapsed_ms(start));
+
+    talloc_free(pl);
+}
+
+int main(int argc, char *argv[])
+{
+    mp_time_init();
+    mp_rand_seed(1);
+
+    if (test_is_bench(argc, argv)) {
+        bench();
+        return 0;
+    }
+
+    /* random operations compared against an array */
+    {
+        struct playlist *pl = talloc_zero(NULL, struct playlist);
+        struct playlist_entry **model = NULL;
+        int num = 0;
+        uint64_t *ids = NULL;
+        int num_ids = 0;
+        uint64_t generation = 0;
+
+        // Enable change tracking.
+        struct playlist_change **changes;
+        int num_changes;
+        playlist_get_changes(pl, 0, &changes, &num_changes);
+
+        for (int n = 0; n < 20000; n++) {
+            random_op(pl, &model, &num);
+            if (n % 32 == 0) {
+                check_model(pl, model, num);
+                check_changes(pl, &ids, &num_ids, &generation);
+            }
+        }
+        check_model(pl, model, num);
+        check_changes(pl, &ids, &num_ids, &generation);
+
+        // Unshuffling restores the order, and the change feed asks for a reset.
+        playlist_shuffle(pl);
+        assert_false(playlist_get_changes(pl, generation, &changes, &num_changes));
+        playlist_unshuffle(pl);
+        check_model(pl, model, num);
+
+        playlist_clear(pl);
+        check_model(pl, model, 0);
+
+        talloc_free(ids);
+        talloc_free(model);
+        talloc_free(pl);
+    }
+
+    /* transferring entries from other playlists, mostly appending */
+    {
+        struct playlist *pl = talloc_zero(NULL, struct playlist);
+        struct playlist_entry **model = NULL;
+        int num = 0;
+        uint64_t *ids = NULL;
+        int num_ids = 0;
+        uint64_t generation = 0;
+
+        struct playlist_change **changes;
+        int num_changes;
+        playlist_get_changes(pl, 0, &changes, &num_changes);
+
+        for (int n = 0; n < 20000; n++) {
+            struct playlist *src = talloc_zero(NULL, struct playlist);
+            int count = n % 10 == 0 ? 3 : 1;
+            for (int i = 0; i < count; i++)
+                playlist_append_file(src, "file");
+            struct playlist_entry *first = playlist_get_first(src);
+
+            int index = n % 7 == 0 ? rand_int(num + 1) : num;
+            uint64_t id = index == num ? playlist_append_entries(pl, src)
+                                       : playlist_transfer_entries_to(pl, index, src);
+            assert_int_equal(id, first->id);
+            assert_int_equal(playlist_entry_count(src), 0);
+            struct playlist_entry *e = first;
+            for (int i = 0; i < count; i++) {
+                assert_true(e->pl == pl);
+                assert_int_equal(e->id, id + i);
+                MP_TARRAY_INSERT_AT(NULL, model, num, index + i, e);
+                e = playlist_entry_get_rel(e, 1);
+            }
+            talloc_free(src);
+
+            if (n % 32 == 0)
+                check_changes(pl, &ids, &num_ids, &generation);
+        }
+        check_model(pl, model, num);
+        check_changes(pl, &ids, &num_ids, &generation);
+        // The tree stays balanced (expected depth is about 3 * log2(num)).
+        assert_true(tree_depth(pl) < 100);
+
+        talloc_free(ids);
+        talloc_free(model);
+        talloc_free(pl);
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "common/global.h"
+#include "common/stats.h"
+#include "misc/node.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
+#include "test_utils.h"
+
+#define NUM_THREADS 4
+#define NUM_EVENTS 10000
+#define BENCH_EVENTS 10000000
+
+static struct mpv_node *find_stat(struct mpv_node *list, const char *name)
+{
+    for (int n = 0; n < list->u.list->num; n++) {
+        struct mpv_node *e = &list->u.list->values[n];
+        struct mpv_node *ne = node_map_get(e, "name");
+        if (ne && strcmp(ne->u.string, name) == 0)
+            return node_map_get(e, "value");
+    }
+    return NULL;
+}
+
+static double get_stat(struct mpv_node *list, const char *name)
+{
+    struct mpv_node *v = find_stat(list, name);
+    if (!v) {
+        printf("missing stat '%s'\n", name);
+        abort();
+    }
+    return v->u.double_;
+}
+
+static struct stats_handle *event_handle;
+
+static MP_THREAD_VOID event_thread(void *arg)
+{
+    for (int n = 0; n < NUM_EVENTS; n++)
+        stats_handle_event(event_handle);
+    MP_THREAD_RETURN();
+}
+
+// Record a timer sample of the given duration without actually waiting.
+static void add_time(struct stats_handle *h, int64_t ns)
+{
+    struct stats_timer t;
+    stats_handle_time_start(h, &t);
+    t.time_start_ns -= ns;
+    stats_handle_time_end(h, &t);
+}
+
+// Compare the cost of named events and handles. Run with "bench".
+static void bench(struct mpv_global *global, struct stats_ctx *ctx)
+{
+    struct stats_handle *h = stats_handle_create(ctx, "bench");
+    struct mpv_node res;
+    stats_global_query(global, &res);
+    talloc_free(res.u.list);
+
+    int64_t start = mp_time_ns();
+    for (int n = 0; n < BENCH_EVENTS; n++)
+        stats_event(ctx, "bench-named");
+    double named = MP_TIME_NS_TO_MS(mp_time_ns() - start);
+
+    start = mp_time_ns();
+    for (int n = 0; n < BENCH_EVENTS; n++)
+        stats_handle_event(h);
+    double handle = MP_TIME_NS_TO_MS(mp_time_ns() - start);
+
+    printf("%d events: named %.1f ms, handle %.1f ms\n", BENCH_EVENTS,
+           named, handle);
+}
+
+int main(int argc, char *argv[])
+{
+    mp_time_init();
+
+    struct mpv_global *global = talloc_zero(NULL, struct mpv_global);
+    stats_global_init(global);
+    struct stats_ctx *ctx = stats_ctx_create(global, global, "test");
+    event_handle = stats_handle_create(ctx, "events");
+    struct stats_handle *timer = stats_handle_create(ctx, "timer");
+
+    if (test_is_bench(argc, argv)) {
+        bench(global, ctx);
+        talloc_free(ctx);
+        talloc_free(global);
+        return 0;
+    }
+
+    // Collection starts with the first query.
+    struct mpv_node res;
+    stats_global_query(global, &res);
+    talloc_free(res.u.list);
+
+    /* concurrent events */
+    {
+        mp_thread threads[NUM_THREADS];
+        for (int n = 0; n < NUM_THREADS; n++)
+            assert_false(mp_thread_create(&threads[n], event_thread, NULL));
+        for (int n = 0; n < NUM_THREADS; n++)
+            mp_thread_join(threads[n]);
+
+        stats_global_query(global, &res);
+        assert_int_equal(get_stat(&res, "test/events"), NUM_THREADS * NUM_EVENTS);
+        talloc_free(res.u.list);
+
+        // Values are reset after each query.
+        stats_global_query(global, &res);
+        assert_int_equal(get_stat(&res, "test/events"), 0);
+        talloc_free(res.u.list);
+    }
+
+    /* timer percentiles */
+    {
+        for (int n = 0; n < 20; n++)
+            add_time(timer, MP_TIME_MS_TO_NS(n == 19 ? 20 : 1));
+
+        stats_global_query(global, &res);
+        double p50 = get_stat(&res, "test/timer/p50");
+        double p99 = get_stat(&res, "test/timer/p99");
+        double max = get_stat(&res, "test/timer/max");
+        // 1 ms falls into the bucket [983040, 1048576) ns.
+        assert_float_equal(p50, 1.015808, 1e-9);
+        assert_true(p99 >= p50 && p99 <= max);
+        assert_true(max >= 20);
+        assert_true(get_stat(&res, "test/timer/time") >= 39);
+        talloc_free(res.u.list);
+    }
+
+    /* everything is reset if the previous query was long ago */
+    {
+        for (int n = 0; n < 10; n++) {
+            stats_handle_event(event_handle);
+            stats_event(ctx, "named-events");
+            add_time(timer, MP_TIME_MS_TO_NS(20));
+            stats_time_start(ctx, "named-timer");
+            stats_time_end(ctx, "named-timer");
+        }
+
+        mp_sleep_ns(MP_TIME_MS_TO_NS(2100));
+        stats_global_query(global, &res);
+        assert_int_equal(get_stat(&res, "test/events"), 0);
+        assert_int_equal(get_stat(&res, "test/timer/time"), 0);
+        assert_false(find_stat(&res, "test/timer/p50"));
+        assert_false(find_stat(&res, "test/named-events"));
+        assert_false(find_stat(&res, "test/named-timer/time"));
+        talloc_free(res.u.list);
+
+        // Nothing of the old data shows up again.
+        stats_event(ctx, "named-events");
+        add_time(timer, MP_TIME_MS_TO_NS(1));
+        stats_time_start(ctx, "named-timer");
+        stats_time_end(ctx, "named-timer");
+        stats_global_query(global, &res);
+        assert_int_equal(get_stat(&res, "test/named-events"), 1);
+        assert_float_equal(get_stat(&res, "test/timer/max"), 1, 0.1);
+        assert_true(get_stat(&res, "test/named-timer/max") < 20);
+        talloc_free(res.u.list);
+    }
+
+    talloc_free(ctx);
+    talloc_free(global);
+    return 0;
+}
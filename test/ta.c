@@ -0,0 +1,173 @@
+#include "common/common.h"
+#include "misc/node.h"
+#include "osdep/timer.h"
+#include "test_utils.h"
+
+#define NUM_STRINGS 20000
+#define NUM_TRACKS 30
+#define NUM_READS 20000
+
+static int destroyed;
+
+static void destructor(void *ptr)
+{
+    destroyed++;
+}
+
+static void check_arena(void)
+{
+    void *arena = talloc_new_arena(NULL);
+    char **strs = NULL;
+    int num = 0;
+    int destructors = 0;
+    for (int n = 0; n < NUM_STRINGS; n++) {
+        char *s = talloc_asprintf(arena, "string %d", n);
+        MP_TARRAY_APPEND(arena, strs, num, s);
+        if (n % 7 == 0) {
+            talloc_set_destructor(s, destructor);
+            destructors++;
+        }
+        if (n % 3 == 0) {
+            talloc_set_destructor(talloc_size(s, 100), destructor);
+            destructors++;
+        }
+    }
+    for (int n = 0; n < num; n++) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "string %d", n);
+        assert_string_equal(strs[n], buf);
+    }
+
+    // Growing and shrinking arena allocations.
+    char *s = talloc_strdup(arena, "");
+    for (int n = 0; n < 1000; n++)
+        s = talloc_asprintf_append(s, "%d", n % 10);
+    assert_int_equal(strlen(s), 1000);
+    s = talloc_realloc_size(arena, s, 10);
+    assert_int_equal(talloc_get_size(s), 10);
+    char *big = talloc_size(arena, 1000000);
+    memset(big, 1, 1000000);
+    big = talloc_realloc_size(arena, big, 100);
+    assert_int_equal(big[99], 1);
+
+    // Freeing single allocations.
+    destroyed = 0;
+    talloc_free(strs[0]);
+    talloc_free(strs[3]);
+    assert_int_equal(destroyed, 3);
+    destructors -= 3;
+
+    // Allocations moved out of the arena outlive it, and their children are
+    // allocated normally.
+    char *out = talloc_steal(NULL, strs[1]);
+    talloc_set_destructor(talloc_strdup(out, "child"), destructor);
+
+    // Nested arenas.
+    void *nested = talloc_new_arena(arena);
+    talloc_set_destructor(talloc_strdup(nested, "nested"), destructor);
+    destructors++;
+
+    destroyed = 0;
+    talloc_free(arena);
+    assert_int_equal(destroyed, destructors);
+    assert_string_equal(out, "string 1");
+
+    destroyed = 0;
+    talloc_free(out);
+    assert_int_equal(destroyed, 1);
+}
+
+static void add_strings(struct mpv_node *node)
+{
+    for (int n = 0; n < NUM_STRINGS; n++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key %d", n);
+        node_map_add_string(node, key, "some value");
+    }
+}
+
+// Freeing a large arena-backed node must give all arena chunks back. Nodes
+// without parent don't use an arena, unless requested.
+static void check_node_arena(void)
+{
+    size_t chunks = ta_dbg_arena_chunks();
+    struct mpv_node node;
+    node_init_arena(&node, MPV_FORMAT_NODE_MAP);
+    add_strings(&node);
+    assert_true(ta_dbg_arena_chunks() > chunks + 1);
+    talloc_free(node.u.list);
+    assert_int_equal(ta_dbg_arena_chunks(), chunks);
+
+    node_init(&node, MPV_FORMAT_NODE_MAP, NULL);
+    add_strings(&node);
+    assert_int_equal(ta_dbg_arena_chunks(), chunks);
+    talloc_free(node.u.list);
+}
+
+// Roughly what reading the track-list property returns.
+static void build_track_list(struct mpv_node *root, bool arena)
+{
+    if (arena) {
+        node_init_arena(root, MPV_FORMAT_NODE_ARRAY);
+    } else {
+        node_init(root, MPV_FORMAT_NODE_ARRAY, NULL);
+    }
+    for (int n = 0; n < NUM_TRACKS; n++) {
+        struct mpv_node *t = node_array_add(root, MPV_FORMAT_NODE_MAP);
+        node_map_add_int64(t, "id", n + 1);
+        node_map_add_string(t, "type", n % 2 ? "audio" : "sub");
+        node_map_add_string(t, "title", "Some track title");
+        node_map_add_string(t, "lang", "eng");
+        node_map_add_flag(t, "default", n == 0);
+        node_map_add_flag(t, "forced", false);
+        node_map_add_flag(t, "external", false);
+        node_map_add_flag(t, "selected", n < 2);
+        node_map_add_int64(t, "ff-index", n);
+        node_map_add_string(t, "codec", "aac");
+        node_map_add_string(t, "codec-desc", "AAC (Advanced Audio Coding)");
+        node_map_add_int64(t, "demux-samplerate", 48000);
+        node_map_add_int64(t, "demux-channel-count", 2);
+        node_map_add_string(t, "demux-channels", "stereo");
+        struct mpv_node *m = node_map_add(t, "metadata", MPV_FORMAT_NODE_MAP);
+        node_map_add_string(m, "HANDLER_NAME", "SoundHandler");
+        node_map_add_string(m, "VENDOR_ID", "[0][0][0][0]");
+    }
+}
+
+static double bench_reads(bool arena)
+{
+    int64_t start = mp_time_ns();
+    for (int n = 0; n < NUM_READS; n++) {
+        struct mpv_node node;
+        build_track_list(&node, arena);
+        talloc_free(node.u.list);
+    }
+    return MP_TIME_NS_TO_US(mp_time_ns() - start) / NUM_READS;
+}
+
+static void bench(void)
+{
+    printf("track-list read, malloc: %.2f us\n", bench_reads(false));
+    printf("track-list read, arena: %.2f us\n", bench_reads(true));
+}
+
+int main(int argc, char *argv[])
+{
+    mp_time_init();
+
+    if (test_is_bench(argc, argv)) {
+        bench();
+        return 0;
+    }
+
+    check_arena();
+    check_node_arena();
+
+    struct mpv_node a, b;
+    build_track_list(&a, false);
+    build_track_list(&b, true);
+    assert_true(equal_mpv_node(&a, &b));
+    talloc_free(a.u.list);
+    talloc_free(b.u.list);
+    return 0;
+}
@@ -0,0 +1,354 @@
+#include <stdatomic.h>
+
+#include "common/common.h"
+#include "misc/task_pool.h"
+#include "misc/thread_pool.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
+#include "test_utils.h"
+
+#define NUM_TASKS 200000
+#define NUM_SLICES 64
+#define SLICE_WORK 20000
+#define NUM_USERS 4
+#define NUM_FRAMES 200
+#define NUM_CHILDREN 16
+
+static atomic_int counter;
+
+static void count_fn(void *ctx)
+{
+    atomic_fetch_add(&counter, 1);
+}
+
+static void wait_counter(int value)
+{
+    while (atomic_load(&counter) < value)
+        mp_sleep_ns(MP_TIME_US_TO_NS(100));
+}
+
+// Some CPU work, so that slices take a measurable time.
+static uint32_t slice_work(int index)
+{
+    uint32_t x = index + 1;
+    for (int n = 0; n < SLICE_WORK; n++)
+        x = x * 1664525 + 1013904223;
+    return x;
+}
+
+struct slices {
+    uint32_t results[NUM_SLICES];
+};
+
+static void slice_fn(void *ctx, int index)
+{
+    struct slices *s = ctx;
+    s->results[index] = slice_work(index);
+}
+
+static void check_slices(struct slices *s)
+{
+    for (int n = 0; n < NUM_SLICES; n++)
+        assert_int_equal(s->results[n], slice_work(n));
+}
+
+static void nested_fn(void *ctx, int index)
+{
+    struct slices *s = ctx;
+    mp_task_parallel_for(MP_TASK_NORMAL, NUM_SLICES, 0, slice_fn, &s[index]);
+}
+
+// Emulates the old zimg behavior: every user has its own pool with one thread
+// per core, and runs all slices but the first on it.
+struct pool_user {
+    struct mp_thread_pool *pool;
+    struct slices slices;
+    mp_mutex lock;
+    mp_cond wakeup;
+    int pending;
+};
+
+struct pool_slice {
+    struct pool_user *user;
+    int index;
+};
+
+static void pool_slice_fn(void *ctx)
+{
+    struct pool_slice *ps = ctx;
+    struct pool_user *u = ps->user;
+    slice_fn(&u->slices, ps->index);
+    mp_mutex_lock(&u->lock);
+    if (--u->pending == 0)
+        mp_cond_signal(&u->wakeup);
+    mp_mutex_unlock(&u->lock);
+}
+
+static MP_THREAD_VOID pool_user_thread(void *arg)
+{
+    struct pool_user *u = arg;
+    struct pool_slice ps[NUM_SLICES];
+    for (int f = 0; f < NUM_FRAMES / NUM_USERS; f++) {
+        u->pending = NUM_SLICES - 1;
+        for (int n = 1; n < NUM_SLICES; n++) {
+            ps[n] = (struct pool_slice){u, n};
+            mp_thread_pool_queue(u->pool, pool_slice_fn, &ps[n]);
+        }
+        slice_fn(&u->slices, 0);
+        mp_mutex_lock(&u->lock);
+        while (u->pending)
+            mp_cond_wait(&u->wakeup, &u->lock);
+        mp_mutex_unlock(&u->lock);
+    }
+    MP_THREAD_RETURN();
+}
+
+static MP_THREAD_VOID task_user_thread(void *arg)
+{
+    struct slices *s = arg;
+    for (int f = 0; f < NUM_FRAMES / NUM_USERS; f++)
+        mp_task_parallel_for(MP_TASK_REALTIME, NUM_SLICES, 0, slice_fn, s);
+    MP_THREAD_RETURN();
+}
+
+// Keeps a worker busy until released.
+static atomic_int num_blocked;
+static atomic_bool release_blocked;
+
+static void block_fn(void *ctx)
+{
+    atomic_fetch_add(&num_blocked, 1);
+    while (!atomic_load(&release_blocked))
+        mp_sleep_ns(MP_TIME_US_TO_NS(100));
+    atomic_fetch_add(&num_blocked, -1);
+}
+
+static void block_workers(int threads)
+{
+    atomic_store(&release_blocked, false);
+    for (int n = 0; n < threads; n++)
+        mp_task_queue(MP_TASK_NORMAL, block_fn, NULL);
+    while (atomic_load(&num_blocked) < threads)
+        mp_sleep_ns(MP_TIME_US_TO_NS(100));
+}
+
+static void release_workers(void)
+{
+    atomic_store(&release_blocked, true);
+    while (atomic_load(&num_blocked))
+        mp_sleep_ns(MP_TIME_US_TO_NS(100));
+}
+
+// Records the order in which the tasks started.
+static atomic_int next_order;
+
+static void order_fn(void *ctx)
+{
+    *(int *)ctx = atomic_fetch_add(&next_order, 1);
+    atomic_fetch_add(&counter, 1);
+}
+
+static void thread_id_fn(void *ctx, int index)
+{
+    mp_thread_id *ids = ctx;
+    ids[index] = mp_thread_current_id();
+}
+
+struct parent {
+    mp_thread_id thread;
+    atomic_int children_done;
+    mp_thread_id children[NUM_CHILDREN];
+};
+
+static void child_fn(void *ctx)
+{
+    struct parent *p = ctx;
+    int n = atomic_fetch_add(&counter, 1);
+    p->children[n] = mp_thread_current_id();
+    atomic_fetch_add(&p->children_done, 1);
+}
+
+// Queue tasks to our own deque, and wait for them without running them.
+// Only other workers stealing them can finish this.
+static void parent_fn(void *ctx)
+{
+    struct parent *p = ctx;
+    p->thread = mp_thread_current_id();
+    for (int n = 0; n < NUM_CHILDREN; n++)
+        mp_task_queue(MP_TASK_NORMAL, child_fn, p);
+    while (atomic_load(&p->children_done) < NUM_CHILDREN)
+        mp_sleep_ns(MP_TIME_US_TO_NS(100));
+    atomic_fetch_add(&counter, 1);
+}
+
+static double elapsed_ms(int64_t start)
+{
+    return MP_TIME_NS_TO_MS(mp_time_ns() - start);
+}
+
+// Compare the old per-user thread pools with the task pool. Run with "bench".
+static void bench(int threads)
+{
+    printf("worker threads: %d\n", threads);
+
+    /* queue many small tasks */
+    {
+        struct mp_thread_pool *pool =
+            mp_thread_pool_create(NULL, threads, threads, threads);
+        atomic_store(&counter, 0);
+        int64_t start = mp_time_ns();
+        for (int n = 0; n < NUM_TASKS; n++)
+            mp_thread_pool_queue(pool, count_fn, NULL);
+        wait_counter(NUM_TASKS);
+        printf("mp_thread_pool: %d tasks: %.1f ms\n", NUM_TASKS, elapsed_ms(start));
+        talloc_free(pool);
+
+        atomic_store(&counter, 0);
+        start = mp_time_ns();
+        for (int n = 0; n < NUM_TASKS; n++)
+            mp_task_queue(n % MP_TASK_PRIORITY_COUNT, count_fn, NULL);
+        wait_counter(NUM_TASKS);
+        printf("mp_task_queue: %d tasks: %.1f ms\n", NUM_TASKS, elapsed_ms(start));
+    }
+
+    /* parallel_for */
+    {
+        struct slices s = {0};
+        int64_t start = mp_time_ns();
+        for (int n = 0; n < NUM_SLICES; n++)
+            slice_fn(&s, n);
+        printf("%d slices serial: %.1f ms\n", NUM_SLICES, elapsed_ms(start));
+        check_slices(&s);
+
+        memset(&s, 0, sizeof(s));
+        start = mp_time_ns();
+        mp_task_parallel_for(MP_TASK_NORMAL, NUM_SLICES, 0, slice_fn, &s);
+        printf("%d slices parallel: %.1f ms\n", NUM_SLICES, elapsed_ms(start));
+        check_slices(&s);
+    }
+
+    /* several scalers running at the same time */
+    {
+        struct pool_user users[NUM_USERS];
+        mp_thread t[NUM_USERS];
+        int64_t start = mp_time_ns();
+        for (int n = 0; n < NUM_USERS; n++) {
+            users[n] = (struct pool_user){
+                .pool = mp_thread_pool_create(NULL, threads, threads, threads),
+            };
+            mp_mutex_init(&users[n].lock);
+            mp_cond_init(&users[n].wakeup);
+            assert_false(mp_thread_create(&t[n], pool_user_thread, &users[n]));
+        }
+        for (int n = 0; n < NUM_USERS; n++) {
+            mp_thread_join(t[n]);
+            check_slices(&users[n].slices);
+            talloc_free(users[n].pool);
+            mp_mutex_destroy(&users[n].lock);
+            mp_cond_destroy(&users[n].wakeup);
+        }
+        printf("%d users, %d frames, one pool each: %.1f ms\n", NUM_USERS,
+               NUM_FRAMES, elapsed_ms(start));
+
+        struct slices s[NUM_USERS] = {0};
+        start = mp_time_ns();
+        for (int n = 0; n < NUM_USERS; n++)
+            assert_false(mp_thread_create(&t[n], task_user_thread, &s[n]));
+        for (int n = 0; n < NUM_USERS; n++) {
+            mp_thread_join(t[n]);
+            check_slices(&s[n]);
+        }
+        printf("%d users, %d frames, shared pool: %.1f ms\n", NUM_USERS,
+               NUM_FRAMES, elapsed_ms(start));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    mp_time_init();
+    mp_task_pool_ref();
+
+    int threads = mp_task_pool_max_threads();
+
+    if (test_is_bench(argc, argv)) {
+        bench(threads);
+        mp_task_pool_unref();
+        return 0;
+    }
+
+    /* queued tasks all run */
+    {
+        atomic_store(&counter, 0);
+        for (int n = 0; n < 1000; n++)
+            mp_task_queue(n % MP_TASK_PRIORITY_COUNT, count_fn, NULL);
+        wait_counter(1000);
+    }
+
+    /* higher priority tasks overtake queued ones */
+    {
+        int num = threads * 4;
+        int order[64 * 4 + 1];
+        block_workers(threads);
+        atomic_store(&counter, 0);
+        atomic_store(&next_order, 0);
+        for (int n = 0; n < num; n++)
+            mp_task_queue(MP_TASK_BACKGROUND, order_fn, &order[n]);
+        mp_task_queue(MP_TASK_REALTIME, order_fn, &order[num]);
+        release_workers();
+        wait_counter(num + 1);
+        // Released workers may grab other tasks at the same time.
+        assert_true(order[num] < threads);
+    }
+
+    /* the caller of parallel_for runs the slices if all workers are busy */
+    {
+        mp_thread_id ids[NUM_SLICES];
+        block_workers(threads);
+        mp_task_parallel_for(MP_TASK_REALTIME, NUM_SLICES, 0, thread_id_fn, ids);
+        for (int n = 0; n < NUM_SLICES; n++)
+            assert_true(mp_thread_id_equal(ids[n], mp_thread_current_id()));
+        release_workers();
+    }
+
+    /* idle workers steal tasks queued by a busy worker */
+    if (threads > 1) {
+        struct parent p = {0};
+        atomic_store(&counter, 0);
+        mp_task_queue(MP_TASK_NORMAL, parent_fn, &p);
+        wait_counter(NUM_CHILDREN + 1);
+        for (int n = 0; n < NUM_CHILDREN; n++)
+            assert_false(mp_thread_id_equal(p.children[n], p.thread));
+    }
+
+    /* parallel_for, plain, single job, and nested */
+    {
+        struct slices s[4] = {0};
+        mp_task_parallel_for(MP_TASK_NORMAL, NUM_SLICES, 0, slice_fn, &s[0]);
+        check_slices(&s[0]);
+
+        memset(s, 0, sizeof(s));
+        mp_task_parallel_for(MP_TASK_NORMAL, NUM_SLICES, 1, slice_fn, &s[0]);
+        check_slices(&s[0]);
+
+        // The nested calls wait while other nested calls occupy the workers.
+        memset(s, 0, sizeof(s));
+        mp_task_parallel_for(MP_TASK_NORMAL, 4, 0, nested_fn, s);
+        for (int n = 0; n < 4; n++)
+            check_slices(&s[n]);
+    }
+
+    /* several users running at the same time */
+    {
+        struct slices s[NUM_USERS] = {0};
+        mp_thread t[NUM_USERS];
+        for (int n = 0; n < NUM_USERS; n++)
+            assert_false(mp_thread_create(&t[n], task_user_thread, &s[n]));
+        for (int n = 0; n < NUM_USERS; n++) {
+            mp_thread_join(t[n]);
+            check_slices(&s[n]);
+        }
+    }
+
+    mp_task_pool_unref();
+    return 0;
+}
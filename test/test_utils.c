@@ -55,6 +55,11 @@ FILE *test_open_out(const char *outdir, const char *name)
     return f;
 }
 
+bool test_is_bench(int argc, char *argv[])
+{
+    return argc > 1 && strcmp(argv[1], "bench") == 0;
+}
+
 void assert_text_files_equal_impl(const char *file, int line,
                                   const char *refdir, const char *outdir,
                                   const char *ref, const char *new,
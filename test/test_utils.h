@@ -41,6 +41,10 @@ void assert_memcmp_impl(const char *file, int line,
 // Open a new file in the build dir path. Always succeeds.
 FILE *test_open_out(const char *outdir, const char *name);
 
+// Whether the test was started by a benchmark() entry in meson.build (with
+// "bench" as argument). It should then print timings instead of testing.
+bool test_is_bench(int argc, char *argv[]);
+
 /* Stubs */
 
 // Files commonly import common/msg.h which requires these to be
@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+
+# Run TOOLS/thumbnails.py on a generated file.
+# Usage: thumbnails.py <mpv binary> <path to TOOLS/thumbnails.py>
+
+import os
+import subprocess
+import sys
+import tempfile
+
+mpv, script = sys.argv[1:3]
+env = dict(os.environ, MPV=mpv)
+
+def run(*args):
+    subprocess.run([sys.executable, script, *args], check=True, env=env)
+
+def images(path):
+    return [f for f in os.listdir(path) if f.endswith(".png")]
+
+with tempfile.TemporaryDirectory() as tmp:
+    test_file = os.path.join(tmp, "test.mkv")
+    subprocess.run([mpv, "--no-config", "--no-terminal", "--of=matroska",
+                    "--ovc=mpeg4", "--ovcopts=g=10", "--o=" + test_file, "--",
+                    "av://lavfi:testsrc=size=320x240:rate=10:duration=6"],
+                   check=True)
+
+    # Interval mode needs the file duration.
+    out = os.path.join(tmp, "interval")
+    run("--interval", "2", "--jobs", "2", "--format", "png", "--outdir", out,
+        test_file)
+    num = len(images(out))
+    if not 1 <= num <= 3:
+        sys.exit("interval mode: expected 1-3 images, got %d" % num)
+
+    out = os.path.join(tmp, "times")
+    run("--times", "0.5,2.5,4.5", "--format", "png", "--outdir", out, test_file)
+    num = len(images(out))
+    if num != 3:
+        sys.exit("times mode: expected 3 images, got %d" % num)
+
+    out = os.path.join(tmp, "sprite")
+    run("--interval", "1", "--sprite", "2x2", "--width", "80", "--format", "png",
+        "--outdir", out, test_file)
+    if not images(out):
+        sys.exit("sprite mode: no sprite sheet written")
+
+print("thumbnails ok")
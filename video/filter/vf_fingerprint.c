@@ -16,6 +16,9 @@
  */
 
 #include <math.h>
+#include <string.h>
+
+#include "config.h"
 
 #include "common/common.h"
 #include "common/tags.h"
@@ -29,12 +32,12 @@
 
 #include "osdep/timer.h"
 
-#define PRINT_ENTRY_NUM 10
-
 struct f_opts {
     int type;
     bool clear;
     bool print;
+    bool fast;
+    int queue_size;
 };
 
 const struct m_opt_choice_alternatives type_names[] = {
@@ -48,12 +51,15 @@ static const struct m_option f_opts_list[] = {
     {"type", OPT_CHOICE_C(type, type_names)},
     {"clear-on-query", OPT_BOOL(clear)},
     {"print", OPT_BOOL(print)},
+    {"fast", OPT_BOOL(fast)},
+    {"queue-size", OPT_INT(queue_size), M_RANGE(1, 10000)},
     {0}
 };
 
 static const struct f_opts f_opts_def = {
     .type = 16,
     .clear = true,
+    .queue_size = 10,
 };
 
 struct print_entry {
@@ -66,8 +72,13 @@ struct priv {
     struct mp_image *scaled;
     struct mp_sws_context *sws;
     struct mp_zimg_context *zimg;
-    struct print_entry entries[PRINT_ENTRY_NUM];
+    // Ring buffer of opts->queue_size entries; the print strings are
+    // preallocated, so adding a fingerprint does not allocate.
+    struct print_entry *entries;
+    int first_entry;
     int num_entries;
+    uint32_t *colsum; // for the fast path, one accumulator per source column
+    int colsum_size;
     bool fallback_warning;
 };
 
@@ -76,11 +87,80 @@ static void f_reset(struct mp_filter *f)
 {
     struct priv *p = f->priv;
 
-    for (int n = 0; n < p->num_entries; n++)
-        talloc_free(p->entries[n].print);
+    p->first_entry = 0;
     p->num_entries = 0;
 }
 
+static bool fast_path_supported(struct mp_image *mpi, int size)
+{
+    struct mp_imgfmt_desc desc = mp_imgfmt_get_desc(mpi->imgfmt);
+    return (desc.flags & (MP_IMGFLAG_YUV_P | MP_IMGFLAG_YUV_NV)) &&
+           (desc.flags & MP_IMGFLAG_HAS_COMPS) &&
+           desc.comps[0].plane == 0 && desc.comps[0].size == 8 &&
+           desc.bpp[0] == 8 && mpi->w >= size && mpi->h >= size;
+}
+
+#if HAVE_VECTOR
+
+typedef uint8_t v16u8 __attribute__ ((vector_size (16), aligned (1)));
+typedef uint32_t v16u32 __attribute__ ((vector_size (64), aligned (4)));
+
+// Add w bytes of src to the accumulators in dst.
+static void add_row(uint32_t *dst, const uint8_t *src, int w)
+{
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        v16u32 *acc = (v16u32 *)(dst + x);
+        *acc += __builtin_convertvector(*(const v16u8 *)(src + x), v16u32);
+    }
+    for (; x < w; x++)
+        dst[x] += src[x];
+}
+
+#else // !HAVE_VECTOR
+
+static void add_row(uint32_t *dst, const uint8_t *src, int w)
+{
+    for (int x = 0; x < w; x++)
+        dst[x] += src[x];
+}
+
+#endif // HAVE_VECTOR
+
+// Box downscale of the 8 bit luma plane to size x size pixels, with expansion
+// to full range. This is not the same filter as the zimg path, so fingerprints
+// are different.
+static void fast_downscale(struct priv *p, struct mp_image *mpi, int size)
+{
+    int w = mpi->w, h = mpi->h;
+    if (p->colsum_size < w) {
+        p->colsum = talloc_realloc(p, p->colsum, uint32_t, w);
+        p->colsum_size = w;
+    }
+
+    bool limited = mpi->params.repr.levels != PL_COLOR_LEVELS_FULL;
+
+    for (int oy = 0; oy < size; oy++) {
+        int y0 = oy * h / size, y1 = (oy + 1) * h / size;
+        memset(p->colsum, 0, w * sizeof(p->colsum[0]));
+        for (int y = y0; y < y1; y++)
+            add_row(p->colsum, mpi->planes[0] + y * (ptrdiff_t)mpi->stride[0], w);
+
+        uint8_t *dst = p->scaled->planes[0] + oy * p->scaled->stride[0];
+        for (int ox = 0; ox < size; ox++) {
+            int x0 = ox * w / size, x1 = (ox + 1) * w / size;
+            uint64_t sum = 0;
+            for (int x = x0; x < x1; x++)
+                sum += p->colsum[x];
+            uint64_t count = (uint64_t)(x1 - x0) * (y1 - y0);
+            int v = (sum + count / 2) / count;
+            if (limited)
+                v = MPCLAMP(((v - 16) * 255 + 219 / 2) / 219, 0, 255);
+            dst[ox] = v;
+        }
+    }
+}
+
 static void f_process(struct mp_filter *f)
 {
     struct priv *p = f->priv;
@@ -99,6 +179,12 @@ static void f_process(struct mp_filter *f)
         goto error;
 
     struct mp_image *mpi = frame.data;
+    int size = p->scaled->w;
+
+    if (p->opts->fast && fast_path_supported(mpi, size)) {
+        fast_downscale(p, mpi, size);
+        goto scaled;
+    }
 
     // Try to achieve minimum conversion, even if it makes the fingerprints less
     // "portable" across source video.
@@ -116,24 +202,27 @@ static void f_process(struct mp_filter *f)
             goto error;
     }
 
-    if (p->num_entries >= PRINT_ENTRY_NUM) {
-        talloc_free(p->entries[0].print);
-        MP_TARRAY_REMOVE_AT(p->entries, p->num_entries, 0);
+scaled:;
+    int queue_size = p->opts->queue_size;
+    if (p->num_entries >= queue_size) {
+        p->first_entry = (p->first_entry + 1) % queue_size;
+        p->num_entries--;
     }
 
-    int size = p->scaled->w;
-
-    struct print_entry *e = &p->entries[p->num_entries++];
+    int idx = (p->first_entry + p->num_entries++) % queue_size;
+    struct print_entry *e = &p->entries[idx];
     e->pts = mpi->pts;
-    e->print = talloc_array(p, char, size * size * 2 + 1);
 
+    static const char hex[] = "0123456789abcdef";
+    char *out = e->print;
     for (int y = 0; y < size; y++) {
+        uint8_t *line = p->scaled->planes[0] + y * p->scaled->stride[0];
         for (int x = 0; x < size; x++) {
-            char *offs = &e->print[(y * size + x) * 2];
-            uint8_t v = p->scaled->planes[0][y * p->scaled->stride[0] + x];
-            snprintf(offs, 3, "%02x", v);
+            *out++ = hex[line[x] >> 4];
+            *out++ = hex[line[x] & 15];
         }
     }
+    *out = '\0';
 
     if (p->opts->print)
         MP_INFO(f, "%f: %s\n", e->pts, e->print);
@@ -156,7 +245,8 @@ static bool f_command(struct mp_filter *f, struct mp_filter_command *cmd)
         struct mp_tags *t = talloc_zero(NULL, struct mp_tags);
 
         for (int n = 0; n < p->num_entries; n++) {
-            struct print_entry *e = &p->entries[n];
+            int idx = (p->first_entry + n) % p->opts->queue_size;
+            struct print_entry *e = &p->entries[idx];
 
             if (e->pts != MP_NOPTS_VALUE) {
                 mp_tags_set_str(t, mp_tprintf(80, "fp%d.pts", n),
@@ -203,6 +293,9 @@ static struct mp_filter *f_create(struct mp_filter *parent, void *options)
     p->scaled = mp_image_alloc(IMGFMT_Y8, size, size);
     MP_HANDLE_OOM(p->scaled);
     talloc_steal(p, p->scaled);
+    p->entries = talloc_zero_array(p, struct print_entry, p->opts->queue_size);
+    for (int n = 0; n < p->opts->queue_size; n++)
+        p->entries[n].print = talloc_array(p, char, size * size * 2 + 1);
     p->sws = mp_sws_alloc(p);
     MP_HANDLE_OOM(p->sws);
     p->zimg = mp_zimg_alloc();
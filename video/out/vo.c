@@ -173,6 +173,7 @@ struct vo_internal {
     double reported_display_fps;
 
     struct stats_ctx *stats;
+    struct stats_handle *stats_draw, *stats_flip, *stats_iterations;
 };
 
 extern const struct m_sub_options gl_video_conf;
@@ -295,6 +296,9 @@ static struct vo *vo_create(bool probing, struct mpv_global *global,
         .estimated_vsync_jitter = -1,
         .stats = stats_ctx_create(vo, global, "vo"),
     };
+    vo->in->stats_draw = stats_handle_create(vo->in->stats, "video-draw");
+    vo->in->stats_flip = stats_handle_create(vo->in->stats, "video-flip");
+    vo->in->stats_iterations = stats_handle_create(vo->in->stats, "iterations");
     mp_dispatch_set_wakeup_fn(vo->in->dispatch, dispatch_wakeup_cb, vo);
     mp_mutex_init(&vo->in->lock);
     mp_cond_init(&vo->in->wakeup);
@@ -989,8 +993,11 @@ static bool render_frame(struct vo *vo)
     // Store the initial value before we unlock.
     bool request_redraw = in->request_redraw;
 
+    double frame_pts = frame->current ? frame->current->pts : MP_NOPTS_VALUE;
+
     if (in->dropped_frame) {
         in->drop_count += 1;
+        stats_trace_event(in->stats, "video", "vo-drop", frame_pts);
         wakeup_core(vo);
     } else {
         in->rendering = true;
@@ -1005,15 +1012,16 @@ static bool render_frame(struct vo *vo)
         if (can_queue)
             wakeup_core(vo);
 
-        stats_time_start(in->stats, "video-draw");
+        struct stats_timer timer;
+        stats_handle_time_start(in->stats_draw, &timer);
 
         in->visible = vo->driver->draw_frame(vo, frame);
 
-        stats_time_end(in->stats, "video-draw");
+        stats_handle_time_end(in->stats_draw, &timer);
 
         wait_until(vo, target);
 
-        stats_time_start(in->stats, "video-flip");
+        stats_handle_time_start(in->stats_flip, &timer);
 
         vo->driver->flip_page(vo);
 
@@ -1028,7 +1036,10 @@ static bool render_frame(struct vo *vo)
         if (vsync.last_queue_display_time <= 0)
             vsync.last_queue_display_time = mp_time_ns();
 
-        stats_time_end(in->stats, "video-flip");
+        stats_handle_time_end(in->stats_flip, &timer);
+
+        if (!frame->repeat)
+            stats_trace_event(in->stats, "video", "present", frame_pts);
 
         mp_mutex_lock(&in->lock);
         in->dropped_frame = prev_drop_count < vo->in->drop_count;
@@ -1137,7 +1148,7 @@ static MP_THREAD_VOID vo_thread(void *ptr)
         mp_dispatch_queue_process(vo->in->dispatch, 0);
         if (in->terminate)
             break;
-        stats_event(in->stats, "iterations");
+        stats_handle_event(in->stats_iterations);
         vo->driver->control(vo, VOCTRL_CHECK_EVENTS, NULL);
         bool working = render_frame(vo);
         int64_t now = mp_time_ns();
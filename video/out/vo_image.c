@@ -49,6 +49,9 @@ static const struct m_sub_options image_writer_conf = {
 struct vo_image_opts {
     struct image_writer_opts *opts;
     char *outdir;
+    int sprite_cols;
+    int sprite_rows;
+    int sprite_tile_w;
 };
 
 #define OPT_BASE_STRUCT struct vo_image_opts
@@ -57,6 +60,9 @@ static const struct m_sub_options vo_image_conf = {
     .opts = (const struct m_option[]) {
         {"vo-image", OPT_SUBSTRUCT(opts, image_writer_conf)},
         {"vo-image-outdir", OPT_STRING(outdir), .flags = M_OPT_FILE},
+        {"vo-image-sprite-cols", OPT_INT(sprite_cols), M_RANGE(0, 256)},
+        {"vo-image-sprite-rows", OPT_INT(sprite_rows), M_RANGE(0, 256)},
+        {"vo-image-sprite-tile-width", OPT_INT(sprite_tile_w), M_RANGE(0, 8192)},
         {0},
     },
     .size = sizeof(struct vo_image_opts),
@@ -67,6 +73,12 @@ struct priv {
 
     struct mp_image *current;
     int frame;
+
+    // Sprite sheet mode (--vo-image-sprite-cols/rows)
+    struct mp_sws_context *sws;
+    struct mp_image *sprite;
+    int tile_w, tile_h;
+    int num_tiles;
 };
 
 static bool checked_mkdir(struct vo *vo, const char *buf)
@@ -105,11 +117,9 @@ done:
     return VO_TRUE;
 }
 
-static void flip_page(struct vo *vo)
+static void save_image(struct vo *vo, struct mp_image *img)
 {
     struct priv *p = vo->priv;
-    if (!p->current)
-        return;
 
     (p->frame)++;
 
@@ -121,11 +131,98 @@ static void flip_page(struct vo *vo)
         filename = mp_path_join(t, p->opts->outdir, filename);
 
     MP_INFO(vo, "Saving %s\n", filename);
-    write_image(p->current, p->opts->opts, filename, vo->global, vo->log, true);
+    write_image(img, p->opts->opts, filename, vo->global, vo->log, true);
 
     talloc_free(t);
 }
 
+static bool sprite_enabled(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+    return p->opts->sprite_cols > 0 && p->opts->sprite_rows > 0;
+}
+
+static void flush_sprite(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+    if (!p->sprite || !p->num_tiles)
+        return;
+
+    // Crop away unused rows if the sheet was not filled completely.
+    int cols = p->opts->sprite_cols;
+    int rows = (p->num_tiles + cols - 1) / cols;
+    struct mp_image *img = mp_image_new_ref(p->sprite);
+    if (img) {
+        mp_image_crop(img, 0, 0, img->w, rows * p->tile_h);
+        save_image(vo, img);
+        talloc_free(img);
+    }
+
+    mp_image_clear(p->sprite, 0, 0, p->sprite->w, p->sprite->h);
+    p->num_tiles = 0;
+}
+
+static void add_sprite_tile(struct vo *vo, struct mp_image *src)
+{
+    struct priv *p = vo->priv;
+    int cols = p->opts->sprite_cols;
+    int rows = p->opts->sprite_rows;
+
+    if (!p->sprite) {
+        // Tiles use the decoded size unless a tile width was requested, in
+        // which case the display aspect ratio is preserved.
+        int w = src->w, h = src->h;
+        if (p->opts->sprite_tile_w) {
+            int d_w, d_h;
+            mp_image_params_get_dsize(&src->params, &d_w, &d_h);
+            w = p->opts->sprite_tile_w;
+            h = MPMAX(1, (int)((double)w * d_h / MPMAX(d_w, 1) + 0.5));
+        }
+        p->tile_w = MP_ALIGN_DOWN(w, 2);
+        p->tile_h = MP_ALIGN_DOWN(h, 2);
+        if (p->tile_w < 2 || p->tile_h < 2)
+            return;
+        p->sprite = mp_image_alloc(IMGFMT_RGB0, p->tile_w * cols,
+                                   p->tile_h * rows);
+        if (!p->sprite) {
+            MP_ERR(vo, "Could not allocate sprite sheet.\n");
+            return;
+        }
+        talloc_steal(p, p->sprite);
+        mp_image_params_guess_csp(&p->sprite->params);
+        mp_image_clear(p->sprite, 0, 0, p->sprite->w, p->sprite->h);
+        MP_VERBOSE(vo, "Sprite sheet: %dx%d tiles of %dx%d\n", cols, rows,
+                   p->tile_w, p->tile_h);
+    }
+
+    struct mp_image *tile = mp_image_new_ref(p->sprite);
+    if (!tile)
+        return;
+    int x = (p->num_tiles % cols) * p->tile_w;
+    int y = (p->num_tiles / cols) * p->tile_h;
+    mp_image_crop(tile, x, y, x + p->tile_w, y + p->tile_h);
+    if (mp_sws_scale(p->sws, tile, src) < 0)
+        MP_ERR(vo, "Could not scale frame into sprite tile.\n");
+    talloc_free(tile);
+
+    p->num_tiles++;
+    if (p->num_tiles >= cols * rows)
+        flush_sprite(vo);
+}
+
+static void flip_page(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+    if (!p->current)
+        return;
+
+    if (sprite_enabled(vo)) {
+        add_sprite_tile(vo, p->current);
+    } else {
+        save_image(vo, p->current);
+    }
+}
+
 static int query_format(struct vo *vo, int fmt)
 {
     if (mp_sws_supported_format(fmt))
@@ -135,6 +232,7 @@ static int query_format(struct vo *vo, int fmt)
 
 static void uninit(struct vo *vo)
 {
+    flush_sprite(vo);
 }
 
 static int preinit(struct vo *vo)
@@ -143,6 +241,9 @@ static int preinit(struct vo *vo)
     p->opts = mp_get_config_group(vo, vo->global, &vo_image_conf);
     if (p->opts->outdir && !checked_mkdir(vo, p->opts->outdir))
         return -1;
+    p->sws = mp_sws_alloc(p);
+    p->sws->log = vo->log;
+    mp_sws_enable_cmdline_opts(p->sws, vo->global);
     return 0;
 }
 
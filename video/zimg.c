@@ -22,8 +22,7 @@
 #include "common/common.h"
 #include "common/msg.h"
 #include "csputils.h"
-#include "misc/thread_pool.h"
-#include "misc/thread_tools.h"
+#include "misc/task_pool.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
 #include "repack.h"
@@ -87,7 +86,6 @@ struct mp_zimg_state {
     struct mp_zimg_repack *dst;
     int slice_y, slice_h; // y start position, height of target slice
     double scale_y;
-    struct mp_waiter thread_waiter;
 };
 
 struct mp_zimg_repack {
@@ -216,7 +214,6 @@ static void free_mp_zimg(void *p)
     struct mp_zimg_context *ctx = p;
 
     destroy_zimg(ctx);
-    TA_FREEP(&ctx->tp);
 }
 
 struct mp_zimg_context *mp_zimg_alloc(void)
@@ -600,20 +597,6 @@ bool mp_zimg_config(struct mp_zimg_context *ctx)
     slice_h = MP_ALIGN_UP(slice_h, 64); // for dithering and minimum slice size
     slices = (full_h + slice_h - 1) / slice_h;
 
-    int threads = slices - 1;
-    if (threads != ctx->current_thread_count) {
-        // Just destroy and recreate all - dumb and costly, but rarely happens.
-        TA_FREEP(&ctx->tp);
-        ctx->current_thread_count = 0;
-        if (threads) {
-            MP_VERBOSE(ctx, "using %d threads for scaling\n", threads);
-            ctx->tp = mp_thread_pool_create(NULL, threads, threads, threads);
-            if (!ctx->tp)
-                goto fail;
-            ctx->current_thread_count = threads;
-        }
-    }
-
     for (int n = 0; n < slices; n++) {
         struct mp_zimg_state *st = talloc_zero(NULL, struct mp_zimg_state);
         MP_TARRAY_APPEND(ctx, ctx->states, ctx->num_states, st);
@@ -665,12 +648,11 @@ static void do_convert(struct mp_zimg_state *st)
                               repack_entrypoint, st->dst);
 }
 
-static void do_convert_thread(void *ptr)
+static void do_convert_slice(void *ptr, int index)
 {
-    struct mp_zimg_state *st = ptr;
+    struct mp_zimg_context *ctx = ptr;
 
-    do_convert(st);
-    mp_waiter_wakeup(&st->thread_waiter, 0);
+    do_convert(ctx->states[index]);
 }
 
 bool mp_zimg_convert(struct mp_zimg_context *ctx, struct mp_image *dst,
@@ -693,23 +675,8 @@ bool mp_zimg_convert(struct mp_zimg_context *ctx, struct mp_image *dst,
         }
     }
 
-    for (int n = 1; n < ctx->num_states; n++) {
-        struct mp_zimg_state *st = ctx->states[n];
-
-        st->thread_waiter = (struct mp_waiter)MP_WAITER_INITIALIZER;
-
-        bool r = mp_thread_pool_run(ctx->tp, do_convert_thread, st);
-        // This is guaranteed by the API; and unrolling would be inconvenient.
-        assert(r);
-    }
-
-    do_convert(ctx->states[0]);
-
-    for (int n = 1; n < ctx->num_states; n++) {
-        struct mp_zimg_state *st = ctx->states[n];
-
-        mp_waiter_wait(&st->thread_waiter);
-    }
+    mp_task_parallel_for(MP_TASK_REALTIME, ctx->num_states, 0,
+                         do_convert_slice, ctx);
 
     return true;
 }
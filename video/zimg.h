@@ -43,8 +43,6 @@ struct mp_zimg_context {
     struct m_config_cache *opts_cache;
     struct mp_zimg_state **states;
     int num_states;
-    struct mp_thread_pool *tp;
-    int current_thread_count;
 };
 
 // Allocate a zimg context. Always succeeds. Returns a talloc pointer (use